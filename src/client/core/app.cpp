@@ -266,108 +266,184 @@ void App::OnPacketReceived(const NetworkPacket& packet)
             resources_.MarkAsReadyToDownload();
             break;
         }
-        case PacketType::FileData:
+        case PacketType::FileTransferBegin:
         {
-            resources_.OnFileData(std::get<FileDataPacket>(packet.payload));
+            resources_.OnFileTransferBegin(std::get<FileTransferBeginPacket>(packet.payload));
+            break;
+        }
+        case PacketType::FileChunk:
+        {
+            resources_.OnFileChunk(std::get<FileChunkPacket>(packet.payload));
+            break;
+        }
+        case PacketType::FileTransferEnd:
+        {
+            resources_.OnFileTransferEnd(std::get<FileTransferEndPacket>(packet.payload));
+            break;
+        }
+        case PacketType::ManifestUpdate:
+        {
+            resources_.OnManifestUpdate(std::get<ManifestUpdatePacket>(packet.payload).manifest_json);
             break;
         }
         case PacketType::EmitEvent:
         {
             const auto& event = std::get<EmitEventPacket>(packet.payload);
 
-            if (event.name == CefEvent::Server::CreateBrowser && event.args.size() >= 4) {
-                int id = event.args[0].intValue;
-                const std::string& url = event.args[1].stringValue;
-                bool focused = event.args[2].boolValue;
-                bool controls_chat = event.args[3].boolValue;
+            switch (event.eventId)
+            {
+                case CefEvent::Server::CreateBrowser.id:
+                {
+                    if (event.args.size() < 4)
+                        break;
 
-                QueueOrCreateOverlay(id, url, focused, controls_chat, -1.f, -1.f);
-            }
-            else if (event.name == CefEvent::Server::CreateWorldBrowser && event.args.size() >= 5) {
-                int id = event.args[0].intValue;
-                const std::string& url = event.args[1].stringValue;
-                const std::string& textureName = event.args[2].stringValue;
-                float width = event.args[3].floatValue;
-                float height = event.args[4].floatValue;
-
-                QueueOrCreateWorld(id, url, textureName, width, height);
-            }
-            else if (event.name == CefEvent::Server::DestroyBrowser && event.args.size() >= 1) {
-                const int id = event.args[0].intValue;
+                    int id = event.args[0].intValue;
+                    const std::string& url = event.args[1].stringValue;
+                    bool focused = event.args[2].boolValue;
+                    bool controls_chat = event.args[3].boolValue;
 
-                RemovePendingCreate(id);
+                    QueueOrCreateOverlay(id, url, focused, controls_chat, -1.f, -1.f);
+                    break;
+                }
+                case CefEvent::Server::CreateWorldBrowser.id:
+                {
+                    if (event.args.size() < 5)
+                        break;
 
-                browser_.DestroyBrowser(id);
-            }
-            else if (event.name == CefEvent::Server::ReloadBrowser && event.args.size() >= 2)
-            {
-                int browserId = event.args[0].intValue;
-                bool ignoreCache = event.args[1].boolValue;
+                    int id = event.args[0].intValue;
+                    const std::string& url = event.args[1].stringValue;
+                    const std::string& textureName = event.args[2].stringValue;
+                    float width = event.args[3].floatValue;
+                    float height = event.args[4].floatValue;
 
-                browser_.ReloadBrowser(browserId, ignoreCache);
-            }
-            else if (event.name == CefEvent::Server::FocusBrowser && event.args.size() >= 2) {
-                int browserId = event.args[0].intValue;
-                bool toggle = event.args[1].boolValue;
+                    QueueOrCreateWorld(id, url, textureName, width, height);
+                    break;
+                }
+                case CefEvent::Server::DestroyBrowser.id:
+                {
+                    if (event.args.size() < 1)
+                        break;
 
-                browser_.FocusBrowser(browserId, toggle);
-            }
-            else if (event.name == CefEvent::Server::AttachBrowserToObject && event.args.size() >= 2)
-            {
-                int browserId = event.args[0].intValue;
-                int objectId = event.args[1].intValue;
+                    const int id = event.args[0].intValue;
 
-                browser_.AttachBrowserToObject(browserId, objectId);
-            }
-            else if (event.name == CefEvent::Server::DetachBrowserFromObject && event.args.size() >= 2)
-            {
-                int browserId = event.args[0].intValue;
-                int objectId = event.args[1].intValue;
+                    RemovePendingCreate(id);
 
-                browser_.DetachBrowserFromObject(browserId, objectId);
-            }
-            else if (event.name == CefEvent::Server::MuteBrowser && event.args.size() >= 2)
-            {
-                int browserId = event.args[0].intValue;
-                bool muted = event.args[1].boolValue;
+                    browser_.DestroyBrowser(id);
+                    break;
+                }
+                case CefEvent::Server::ReloadBrowser.id:
+                {
+                    if (event.args.size() < 2)
+                        break;
 
-                audio_.SetStreamMuted(browserId, muted);
-            }
-            else if (event.name == CefEvent::Server::EnableDevTools && event.args.size() >= 2)
-            {
-                int browserId = event.args[0].intValue;
-                bool enabled  = event.args[1].boolValue;
+                    int browserId = event.args[0].intValue;
+                    bool ignoreCache = event.args[1].boolValue;
 
-                browser_.SetDevToolsEnabled(browserId, enabled);
-            }
-            else if (event.name == CefEvent::Server::SetAudioMode && event.args.size() >= 2)
-            {
-                int browserId = event.args[0].intValue;
-                int modeValue = event.args[1].intValue;
+                    browser_.ReloadBrowser(browserId, ignoreCache);
+                    break;
+                }
+                case CefEvent::Server::FocusBrowser.id:
+                {
+                    if (event.args.size() < 2)
+                        break;
 
-                AudioMode mode = static_cast<AudioMode>(modeValue);
-                audio_.SetStreamAudioMode(browserId, mode);
-            }
-            else if (event.name == CefEvent::Server::SetAudioSettings && event.args.size() >= 3)
-            {
-                int browserId = event.args[0].intValue;
-                float maxDistance = event.args[1].floatValue;
-                float refDistance = event.args[2].floatValue;
+                    int browserId = event.args[0].intValue;
+                    bool toggle = event.args[1].boolValue;
 
-                audio_.SetStreamAudioSettings(browserId, maxDistance, refDistance);
-            }
-            else if (event.name == CefEvent::Server::ToggleHudComponent && event.args.size() >= 2)
-            {
-                int componentId = event.args[0].intValue;
-                bool toggle = event.args[1].boolValue;
+                    browser_.FocusBrowser(browserId, toggle);
+                    break;
+                }
+                case CefEvent::Server::AttachBrowserToObject.id:
+                {
+                    if (event.args.size() < 2)
+                        break;
 
-                hud_.ToggleComponent(static_cast<EHudComponent>(componentId), toggle);
-            }
-            else if (event.name == CefEvent::Server::ToggleSpawnScreen && event.args.size() >= 1)
-            {
-                bool toggle = event.args[0].boolValue;
+                    int browserId = event.args[0].intValue;
+                    int objectId = event.args[1].intValue;
+
+                    browser_.AttachBrowserToObject(browserId, objectId);
+                    break;
+                }
+                case CefEvent::Server::DetachBrowserFromObject.id:
+                {
+                    if (event.args.size() < 2)
+                        break;
+
+                    int browserId = event.args[0].intValue;
+                    int objectId = event.args[1].intValue;
+
+                    browser_.DetachBrowserFromObject(browserId, objectId);
+                    break;
+                }
+                case CefEvent::Server::MuteBrowser.id:
+                {
+                    if (event.args.size() < 2)
+                        break;
+
+                    int browserId = event.args[0].intValue;
+                    bool muted = event.args[1].boolValue;
+
+                    audio_.SetStreamMuted(browserId, muted);
+                    break;
+                }
+                case CefEvent::Server::EnableDevTools.id:
+                {
+                    if (event.args.size() < 2)
+                        break;
+
+                    int browserId = event.args[0].intValue;
+                    bool enabled  = event.args[1].boolValue;
 
-                hud_.SetClassSelectionVisible(toggle);
+                    browser_.SetDevToolsEnabled(browserId, enabled);
+                    break;
+                }
+                case CefEvent::Server::SetAudioMode.id:
+                {
+                    if (event.args.size() < 2)
+                        break;
+
+                    int browserId = event.args[0].intValue;
+                    int modeValue = event.args[1].intValue;
+
+                    AudioMode mode = static_cast<AudioMode>(modeValue);
+                    audio_.SetStreamAudioMode(browserId, mode);
+                    break;
+                }
+                case CefEvent::Server::SetAudioSettings.id:
+                {
+                    if (event.args.size() < 3)
+                        break;
+
+                    int browserId = event.args[0].intValue;
+                    float maxDistance = event.args[1].floatValue;
+                    float refDistance = event.args[2].floatValue;
+
+                    audio_.SetStreamAudioSettings(browserId, maxDistance, refDistance);
+                    break;
+                }
+                case CefEvent::Server::ToggleHudComponent.id:
+                {
+                    if (event.args.size() < 2)
+                        break;
+
+                    int componentId = event.args[0].intValue;
+                    bool toggle = event.args[1].boolValue;
+
+                    hud_.ToggleComponent(static_cast<EHudComponent>(componentId), toggle);
+                    break;
+                }
+                case CefEvent::Server::ToggleSpawnScreen.id:
+                {
+                    if (event.args.size() < 1)
+                        break;
+
+                    bool toggle = event.args[0].boolValue;
+
+                    hud_.SetClassSelectionVisible(toggle);
+                    break;
+                }
+                default:
+                    break;
             }
 
             break;
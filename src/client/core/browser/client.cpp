@@ -166,6 +166,7 @@ bool BrowserClient::OnProcessMessageReceived(CefRefPtr<CefBrowser> /*browser*/,
 
         ClientEmitEventPacket event_packet;
         event_packet.browserId = browserId_;
+        event_packet.eventId = network_.FindEventId(event_name);
         event_packet.name = event_name;
 
         for (size_t i = 1; i < args->GetSize(); ++i) {
@@ -1,9 +1,12 @@
 ﻿#include "scheme_handler.hpp"
 #include "system/resource_manager.hpp"
+#include "shared/byte-range.hpp"
+#include "shared/pak-format.hpp"
 #include "include/wrapper/cef_helpers.h"
 #include "include/cef_parser.h"
 #include <algorithm>
 #include <cctype>
+#include <string_view>
 #include <unordered_map>
 #include <cstring>
 
@@ -351,11 +354,89 @@ std::string GetMimeType(const std::string& path)
     return "application/octet-stream";
 }
 
+// Built once, every request for an internal page shares it.
+static std::shared_ptr<const Blob> MakeInternalPage(const std::string& html)
+{
+    return std::make_shared<const Blob>(html.begin(), html.end());
+}
+
+static std::string_view TrimSpaces(std::string_view str)
+{
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+        str.remove_prefix(1);
+
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+        str.remove_suffix(1);
+
+    return str;
+}
+
+// Calls `fn` with every trimmed element of a comma separated header value.
+template <typename Fn>
+static bool AnyHeaderElement(std::string_view value, Fn&& fn)
+{
+    while (!value.empty()) {
+        const size_t comma = value.find(',');
+        if (fn(TrimSpaces(value.substr(0, comma))))
+            return true;
+
+        if (comma == std::string_view::npos)
+            break;
+
+        value.remove_prefix(comma + 1);
+    }
+
+    return false;
+}
+
+// If-None-Match uses the weak comparison, a W/ prefix does not matter.
+static bool MatchesETag(const std::string& if_none_match, const std::string& etag)
+{
+    return AnyHeaderElement(if_none_match, [&](std::string_view tag) {
+        if (tag.substr(0, 2) == "W/")
+            tag.remove_prefix(2);
+
+        return tag == "*" || tag == etag;
+    });
+}
+
+static bool AcceptsDeflate(const std::string& accept_encoding)
+{
+    return AnyHeaderElement(accept_encoding, [](std::string_view coding) {
+        const size_t params = coding.find(';');
+        std::string name(TrimSpaces(coding.substr(0, params)));
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        if (name != "deflate")
+            return false;
+
+        // "q=0" (or 0.0, 0.00...) turns the coding off.
+        if (params != std::string_view::npos) {
+            std::string_view q = TrimSpaces(coding.substr(params + 1));
+            if (q.substr(0, 2) == "q=" && q.substr(2).find_first_not_of("0.") == std::string_view::npos)
+                return false;
+        }
+
+        return true;
+    });
+}
+
 LocalResourceHandler::LocalResourceHandler(ResourceManager& resource_manager)
     : resource_manager_(resource_manager), read_offset_(0)
 {
 }
 
+void LocalResourceHandler::SetBody(std::shared_ptr<const Blob> data)
+{
+    data_ = std::move(data);
+    body_ = *data_;
+    status_ = 200;
+    total_size_ = body_.size();
+    range_begin_ = 0;
+    range_length_ = total_size_;
+    read_offset_ = 0;
+}
+
 bool LocalResourceHandler::ProcessRequest(
     CefRefPtr<CefRequest> request,
     CefRefPtr<CefCallback> callback)
@@ -404,30 +485,27 @@ bool LocalResourceHandler::ProcessRequest(
     {
         if (internal_path == "loading.html")
         {
-            const std::string html = GetInternalLoadingHtml();
-            data_.assign(html.begin(), html.end());
+            static const auto page = MakeInternalPage(GetInternalLoadingHtml());
+            SetBody(page);
             mime_type_ = "text/html";
-            read_offset_ = 0;
             callback->Continue();
             return true;
         }
 
         if (internal_path == "youtube.html")
         {
-            const std::string html = GetInternalYouTubeHtml();
-            data_.assign(html.begin(), html.end());
+            static const auto page = MakeInternalPage(GetInternalYouTubeHtml());
+            SetBody(page);
             mime_type_ = "text/html";
-            read_offset_ = 0;
             callback->Continue();
             return true;
         }
 
         if (internal_path == "twitch.html")
         {
-            const std::string html = GetInternalTwitchHtml();
-            data_.assign(html.begin(), html.end());
+            static const auto page = MakeInternalPage(GetInternalTwitchHtml());
+            SetBody(page);
             mime_type_ = "text/html";
-            read_offset_ = 0;
             callback->Continue();
             return true;
         }
@@ -469,18 +547,96 @@ bool LocalResourceHandler::ProcessRequest(
         return false;
     }
 
-    // Attempt to load file content from ResourceManager
-    if (resource_manager_.GetFileContent(resource_name, internal_path, data_)) {
-        mime_type_ = GetMimeType(internal_path);
+    ResourceFileInfo info;
+    if (!resource_manager_.GetFileInfo(resource_name, internal_path, info)) {
+        LOG_DEBUG("[CEF] Resource not found: {}/{}", resource_name, internal_path);
+        return false;
+    }
+
+    etag_ = info.etag;
+    // Always revalidated, a file name says nothing about whether the next pak changes the
+    // file. The ETag turns an unchanged one into a 304.
+    cache_control_ = "no-cache";
+    mime_type_ = GetMimeType(internal_path);
+
+    const std::string range = request->GetHeaderByName("Range").ToString();
+
+    // A deflated file can go out as stored, with Chromium inflating it (vfs_serve_deflate).
+    // That is another representation: it has its own ETag, and both carry Vary. Range
+    // requests are answered from the decoded file.
+    bool deflate = false;
+    if (info.deflated && resource_manager_.ServesDeflated()) {
+        vary_ = "Accept-Encoding";
+        deflate = range.empty() && AcceptsDeflate(request->GetHeaderByName("Accept-Encoding").ToString());
+    }
+
+    const std::string identity_etag = etag_;
+    if (deflate && !etag_.empty())
+        etag_.insert(etag_.size() - 1, "-deflate");
+
+    if (!etag_.empty() && MatchesETag(request->GetHeaderByName("If-None-Match").ToString(), etag_)) {
+        status_ = 304;
+        total_size_ = 0;
+        range_begin_ = 0;
+        range_length_ = 0;
         read_offset_ = 0;
 
-        LOG_DEBUG("[CEF] Successfully loaded: {} from resource '{}'", internal_path, resource_name);
         callback->Continue();
         return true;
     }
 
-    LOG_DEBUG("[CEF] Resource not found: {}/{}", resource_name, internal_path);
-    return false;
+    std::shared_ptr<const Blob> encoded;
+    if (deflate) {
+        if (resource_manager_.GetEncodedFileContent(resource_name, internal_path, encoded)) {
+            SetBody(std::move(encoded));
+            content_encoding_ = "deflate";
+
+            LOG_DEBUG("[CEF] Successfully loaded: {} from resource '{}' (deflate, {} bytes)", internal_path, resource_name, range_length_);
+            callback->Continue();
+            return true;
+        }
+
+        // Served decoded after all, under the decoded file's tag.
+        etag_ = identity_etag;
+    }
+
+    // Segmented media is streamed from the pak, anything else is loaded whole (and cached)
+    if (resource_manager_.OpenFileStream(resource_name, internal_path, stream_)) {
+        total_size_ = stream_.Size();
+    }
+    else if (resource_manager_.GetFileContent(resource_name, internal_path, data_)) {
+        total_size_ = data_->size();
+    }
+    else {
+        LOG_DEBUG("[CEF] Resource not found: {}/{}", resource_name, internal_path);
+        return false;
+    }
+
+    read_offset_ = 0;
+
+    switch (ParseByteRange(range, total_size_, range_begin_, range_length_)) {
+    case ByteRange::None:
+        status_ = 200;
+        range_begin_ = 0;
+        range_length_ = total_size_;
+        break;
+    case ByteRange::Satisfiable:
+        status_ = 206;
+        break;
+    case ByteRange::Unsatisfiable:
+        status_ = 416;
+        range_begin_ = 0;
+        range_length_ = 0;
+        break;
+    }
+
+    if (data_) {
+        body_ = std::span<const uint8_t>(*data_).subspan(static_cast<size_t>(range_begin_), static_cast<size_t>(range_length_));
+    }
+
+    LOG_DEBUG("[CEF] Successfully loaded: {} from resource '{}' ({} bytes from {})", internal_path, resource_name, range_length_, range_begin_);
+    callback->Continue();
+    return true;
 }
 
 void LocalResourceHandler::GetResponseHeaders(
@@ -491,8 +647,32 @@ void LocalResourceHandler::GetResponseHeaders(
     CEF_REQUIRE_IO_THREAD();
 
     response->SetMimeType(mime_type_);
-    response->SetStatus(200);
-    response_length = static_cast<int64_t>(data_.size());
+    response->SetStatus(status_);
+
+    if (!etag_.empty())
+        response->SetHeaderByName("ETag", etag_, true);
+
+    if (!cache_control_.empty())
+        response->SetHeaderByName("Cache-Control", cache_control_, true);
+
+    if (!vary_.empty())
+        response->SetHeaderByName("Vary", vary_, true);
+
+    if (!content_encoding_.empty())
+        response->SetHeaderByName("Content-Encoding", content_encoding_, true);
+    else
+        response->SetHeaderByName("Accept-Ranges", "bytes", true);
+
+    if (status_ == 206) {
+        const uint64_t range_end = range_begin_ + range_length_ - 1;
+        response->SetHeaderByName("Content-Range",
+            "bytes " + std::to_string(range_begin_) + "-" + std::to_string(range_end) + "/" + std::to_string(total_size_), true);
+    }
+    else if (status_ == 416) {
+        response->SetHeaderByName("Content-Range", "bytes */" + std::to_string(total_size_), true);
+    }
+
+    response_length = static_cast<int64_t>(range_length_);
 }
 
 bool LocalResourceHandler::ReadResponse(
@@ -503,14 +683,38 @@ bool LocalResourceHandler::ReadResponse(
 {
     CEF_REQUIRE_IO_THREAD();
 
-    size_t remaining_bytes = data_.size() - read_offset_;
-    if (remaining_bytes == 0) {
+    uint64_t remaining_bytes = range_length_ - read_offset_;
+    if (remaining_bytes == 0 || bytes_to_read <= 0) {
         bytes_read = 0;
         return false;
     }
 
-    size_t bytes_to_copy = std::min(static_cast<size_t>(bytes_to_read), remaining_bytes);
-    std::memcpy(data_out, data_.data() + read_offset_, bytes_to_copy);
+    size_t bytes_to_copy = static_cast<size_t>(std::min<uint64_t>(bytes_to_read, remaining_bytes));
+
+    if (stream_.pak) {
+        // Decrypt the segment holding the next byte once, then serve reads from it.
+        const uint64_t position = range_begin_ + read_offset_;
+        if (position < stream_window_offset_ || position >= stream_window_offset_ + stream_window_.size()) {
+            const uint64_t window_begin = position - position % PAK_SEGMENT_SIZE;
+            const uint64_t window_length = std::min<uint64_t>(PAK_SEGMENT_SIZE, total_size_ - window_begin);
+
+            if (!stream_.Read(window_begin, window_length, stream_window_)) {
+                LOG_WARN("[CEF] Failed to decrypt stream at offset {}", window_begin);
+                stream_window_.clear();
+                bytes_read = 0;
+                return false;
+            }
+
+            stream_window_offset_ = window_begin;
+        }
+
+        const size_t window_offset = static_cast<size_t>(position - stream_window_offset_);
+        bytes_to_copy = std::min(bytes_to_copy, stream_window_.size() - window_offset);
+        std::memcpy(data_out, stream_window_.data() + window_offset, bytes_to_copy);
+    }
+    else {
+        std::memcpy(data_out, body_.data() + read_offset_, bytes_to_copy);
+    }
 
     read_offset_ += bytes_to_copy;
     bytes_read = static_cast<int>(bytes_to_copy);
@@ -522,7 +726,10 @@ void LocalResourceHandler::Cancel()
 {
     CEF_REQUIRE_IO_THREAD();
 
-    data_.clear();
-    data_.shrink_to_fit();
+    body_ = {};
+    data_.reset();
+    stream_ = {};
+    stream_window_.clear();
+    stream_window_.shrink_to_fit();
     read_offset_ = 0;
 }
\ No newline at end of file
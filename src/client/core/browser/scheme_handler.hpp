@@ -4,10 +4,12 @@
 #include "include/cef_scheme.h"
 
 #include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
-class ResourceManager;
+#include "system/resource_manager.hpp"
 
 // Handles individual resource requests for the custom "cef://" scheme
 // Fetches file data from ResourceManager and serves it to the browser
@@ -21,11 +23,29 @@ public:
     void Cancel() override;
 
 private:
+    void SetBody(std::shared_ptr<const Blob> data);
+
     ResourceManager& resource_manager_;
 
-    std::vector<uint8_t> data_;
+    // Keeps the shared file alive while `body_` is streamed from it.
+    std::shared_ptr<const Blob> data_;
+    std::span<const uint8_t> body_;
+
+    // Set instead of data_ for segmented media, decrypted one segment ahead of the reads.
+    ResourceStream stream_;
+    std::vector<uint8_t> stream_window_;
+    uint64_t stream_window_offset_ = 0;
+
     std::string mime_type_;
-    size_t read_offset_ = 0;
+    std::string etag_;
+    std::string cache_control_;
+    std::string content_encoding_;
+    std::string vary_;
+    int status_ = 200;
+    uint64_t total_size_ = 0;   // whole file
+    uint64_t range_begin_ = 0;  // first byte served
+    uint64_t range_length_ = 0; // bytes served
+    size_t read_offset_ = 0;    // within the range
 
     IMPLEMENT_REFCOUNTING(LocalResourceHandler);
 };
@@ -120,6 +120,11 @@ void NetworkManager::Disconnect()
 	state_ = ConnectionState::DISCONNECTED;
 	FireSessionActive(false);
 
+	{
+		std::lock_guard<std::mutex> lock(events_mutex_);
+		event_table_.Clear();
+	}
+
 	asio::post(io_context_, [this]() {
 		connect_timer_.cancel();
 		kcp_update_timer_.cancel();
@@ -129,6 +134,8 @@ void NetworkManager::Disconnect()
 			kcp_instance_ = nullptr;
 		}
 
+		cipher_.Clear();
+
 		if (socket_.is_open()) socket_.close();
 	});
 }
@@ -219,17 +226,32 @@ void NetworkManager::HandleRawMessage(const char* data, size_t len)
 			auto session_keys = SecurityManager::GenerateClientSessionKeys(
 				client_public_key_, client_private_key_, challenge.server_public_key);
 			if (session_keys.rx.empty()) { Disconnect(); return; }
-			rx_key_ = std::move(session_keys.rx);
-			tx_key_ = std::move(session_keys.tx);
+			{
+				std::lock_guard<std::mutex> lock(kcp_mutex_);
+				cipher_.Init(session_keys.tx, session_keys.rx);
+			}
+			sodium_memzero(session_keys.rx.data(), session_keys.rx.size());
+			sodium_memzero(session_keys.tx.data(), session_keys.tx.size());
 			sodium_memzero(client_private_key_.data(), client_private_key_.size());
 			break;
 		}
 		case PacketType::JoinResponse:
 		{
-			if (state_ != ConnectionState::AWAITING_ACCEPTANCE)
+			// A version mismatch is answered right away, before the handshake.
+			if (state_ != ConnectionState::AWAITING_ACCEPTANCE && state_ != ConnectionState::SENDING_JOIN)
 				return;
 
 			const auto& response = std::get<JoinResponsePacket>(packet.payload);
+			if (response.protocol_version != PROTOCOL_VERSION) {
+				LOG_ERROR("[CLIENT] Server speaks CEF protocol {}, this client {}. Client and server must be updated together.",
+					response.protocol_version, PROTOCOL_VERSION);
+				Disconnect();
+				return;
+			}
+
+			if (state_ != ConnectionState::AWAITING_ACCEPTANCE)
+				return;
+
 			if (!response.accepted) {
 				LOG_ERROR("[CLIENT] Join rejected by server.");
 				Disconnect();
@@ -238,6 +260,11 @@ void NetworkManager::HandleRawMessage(const char* data, size_t len)
 
 			LOG_INFO("[CLIENT] Join accepted! Initializing KCP with conv id {}.", response.kcp_conv_id);
 
+			{
+				std::lock_guard<std::mutex> lock(events_mutex_);
+				event_table_.Clear();
+			}
+
 			non_cef_server_.store(false);
 			FireSessionActive(true);
 
@@ -246,7 +273,7 @@ void NetworkManager::HandleRawMessage(const char* data, size_t len)
 			ikcp_nodelay(kcp_instance_, 1, 10, 2, 1);
 			ikcp_wndsize(kcp_instance_, 128, 128);
 
-			if (rx_key_.empty() || tx_key_.empty()) {
+			if (!cipher_.IsReady()) {
 				LOG_ERROR("[CLIENT] Session keys not initialized!");
 				Disconnect();
 				return;
@@ -263,14 +290,14 @@ void NetworkManager::HandleRawMessage(const char* data, size_t len)
 
 			DoKcpUpdate();
 
-			PacketHandler handler;
+			std::shared_ptr<const PacketHandler> handler;
 			{
 				std::lock_guard lock(handler_mutex_);
 				handler = packet_handler_;
 			}
 
 			if (handler)
-				handler(packet);
+				(*handler)(packet);
 
 			break;
 		}
@@ -282,29 +309,85 @@ void NetworkManager::HandleRawMessage(const char* data, size_t len)
 
 void NetworkManager::HandleKcpInput()
 {
-	std::vector<char> kcp_buffer(65535);
+	std::shared_ptr<const PacketHandler> handler;
+	{ std::lock_guard lock(handler_mutex_); handler = packet_handler_; }
+
 	int msg_size;
 
-	while ((msg_size = ikcp_recv(kcp_instance_, kcp_buffer.data(), static_cast<int>(kcp_buffer.size()))) > 0)
+	while ((msg_size = ikcp_peeksize(kcp_instance_)) > 0)
 	{
-		std::vector<uint8_t> decrypted = DecryptPacket({ kcp_buffer.begin(), kcp_buffer.begin() + msg_size }, rx_key_);
-		if (decrypted.empty()) {
+		char* message = receive_.MessageBuffer(static_cast<size_t>(msg_size));
+		if (ikcp_recv(kcp_instance_, message, msg_size) != msg_size)
+			break;
+
+		size_t plaintext_size = 0;
+		if (!cipher_.Open(reinterpret_cast<uint8_t*>(message), static_cast<size_t>(msg_size), plaintext_size)) {
 			LOG_WARN("[CLIENT] Failed to decrypt KCP packet.");
 			continue;
 		}
 
-		NetworkPacket packet;
-		if (!DeserializePacket(reinterpret_cast<const char*>(decrypted.data()), decrypted.size(), packet)) {
-			LOG_WARN("[CLIENT] Failed to deserialize decrypted KCP packet.");
-			continue;
-		}
+		const char* plaintext = message + SESSION_COUNTER_BYTES;
+
+		const bool framed = ForEachFramedPacket(plaintext, plaintext_size,
+			[this, &handler](const char* data, size_t size) {
+				// Handled before the next one is decoded, a single slot is enough.
+				receive_.Reset();
+
+				NetworkPacket* packet = receive_.Decode(data, size);
+				if (!packet) {
+					LOG_WARN("[CLIENT] Failed to deserialize decrypted KCP packet.");
+					return;
+				}
+
+				if (packet->type == PacketType::EventTable) {
+					ApplyEventTable(std::get<EventTablePacket>(packet->payload));
+					return;
+				}
+
+				if (packet->type == PacketType::EmitBrowserEvent && !ResolveEventName(std::get<EmitEventPacket>(packet->payload)))
+					return;
 
-		PacketHandler handler;
-		{ std::lock_guard lock(handler_mutex_); handler = packet_handler_; }
-		if (handler) handler(packet);
+				if (handler) (*handler)(*packet);
+			});
+
+		if (!framed)
+			LOG_WARN("[CLIENT] Truncated packet batch of {} bytes.", plaintext_size);
 	}
 }
 
+void NetworkManager::ApplyEventTable(const EventTablePacket& table)
+{
+	std::lock_guard<std::mutex> lock(events_mutex_);
+
+	for (const auto& [id, name] : table.entries)
+		event_table_.Assign(id, name);
+
+	LOG_DEBUG("[CLIENT] Event table updated, {} entries ({} new).", event_table_.Size(), table.entries.size());
+}
+
+bool NetworkManager::ResolveEventName(EmitEventPacket& event)
+{
+	if (event.eventId == CefEvent::InvalidId)
+		return true;
+
+	std::lock_guard<std::mutex> lock(events_mutex_);
+
+	const std::string* name = event_table_.Name(event.eventId);
+	if (!name) {
+		LOG_WARN("[CLIENT] Dropping event with unknown id {}.", event.eventId);
+		return false;
+	}
+
+	event.name = *name;
+	return true;
+}
+
+CefEvent::Id NetworkManager::FindEventId(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(events_mutex_);
+	return event_table_.Find(name);
+}
+
 void NetworkManager::FireSessionActive(bool active)
 {
     SessionActiveHandler handler;
@@ -322,7 +405,8 @@ void NetworkManager::SendPacket(PacketType type, const PacketPayload& payload)
 	LOG_DEBUG("[CLIENT] SendPacket called, type={}", static_cast<int>(type));
 
 	NetworkPacket packet{ type, payload };
-	std::string raw;
+	thread_local std::vector<uint8_t> raw;
+	thread_local std::vector<uint8_t> sealed;
 
 	if (!SerializePacket(packet, raw)) {
 		LOG_ERROR("[CLIENT] Failed to serialize packet type {}", static_cast<int>(type));
@@ -333,23 +417,9 @@ void NetworkManager::SendPacket(PacketType type, const PacketPayload& payload)
 
 
 	if (kcp_instance_ && state_ == ConnectionState::CONNECTED) {
-		if (tx_key_.empty()) {
-			LOG_ERROR("[CLIENT] tx_key_ is empty!");
-			return;
-		}
-
-		if (tx_key_.size() != 32) {
-			LOG_ERROR("[CLIENT] tx_key_ has invalid size: {}", tx_key_.size());
-			return;
-		}
-
-		LOG_DEBUG("[CLIENT] About to encrypt...");
-
-		std::vector<uint8_t> encrypted = EncryptPacket({ raw.begin(), raw.end() }, tx_key_);
-
-		LOG_DEBUG("[CLIENT] Encryption returned, size: {}", encrypted.size());
+		sealed.resize(raw.size() + SESSION_OVERHEAD);
 
-		if (encrypted.empty()) {
+		if (!cipher_.Seal(raw.data(), raw.size(), sealed.data())) {
 			LOG_ERROR("[CLIENT] Failed to encrypt packet");
 			return;
 		}
@@ -357,8 +427,8 @@ void NetworkManager::SendPacket(PacketType type, const PacketPayload& payload)
 		LOG_DEBUG("[CLIENT] About to ikcp_send...");
 
 		int sent = ikcp_send(kcp_instance_,
-			reinterpret_cast<const char*>(encrypted.data()),
-			static_cast<int>(encrypted.size()));
+			reinterpret_cast<const char*>(sealed.data()),
+			static_cast<int>(sealed.size()));
 
 		LOG_DEBUG("[CLIENT] ikcp_send returned: {}", sent);
 
@@ -372,7 +442,7 @@ void NetworkManager::SendPacket(PacketType type, const PacketPayload& payload)
 		LOG_DEBUG("[CLIENT] KCP packet sent successfully");
 	}
 	else {
-		SendRaw(raw.data(), static_cast<int>(raw.size()));
+		SendRaw(reinterpret_cast<const char*>(raw.data()), static_cast<int>(raw.size()));
 	}
 }
 
@@ -407,13 +477,13 @@ void NetworkManager::SendRaw(const char* data, int size) {
 void NetworkManager::SetPacketHandler(PacketHandler handler) 
 {
 	std::lock_guard lock(handler_mutex_);
-	packet_handler_ = std::move(handler);
+	packet_handler_ = handler ? std::make_shared<const PacketHandler>(std::move(handler)) : nullptr;
 }
 
 void NetworkManager::SendBrowserCreateResult(int browserId, bool success, int code, const std::string& reason)
 {
 	ClientEmitEventPacket event;
-    event.name = CefEvent::Client::BrowserCreateResult;
+    event.eventId = CefEvent::Client::BrowserCreateResult.id;
     event.browserId = browserId;
     event.args.emplace_back(success);
     event.args.emplace_back(code);
@@ -3,6 +3,7 @@
 #include <thread>
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <vector>
 #include <string>
 #include <array>
@@ -11,7 +12,10 @@
 #include <asio.hpp>
 #include <asio/steady_timer.hpp>
 #include <ikcp.h>
+#include "shared/crypto.hpp"
+#include "shared/events.hpp"
 #include "shared/packet.hpp"
+#include "shared/packet-serializer.hpp"
 
 class ResourceManager;
 
@@ -45,6 +49,9 @@ public:
 	void SendRaw(const char* data, int size);
 	void SendBrowserCreateResult(int browserId, bool success, int code, const std::string& reason);
 
+	// Id the server assigned to `name`, or CefEvent::InvalidId to send it by name.
+	CefEvent::Id FindEventId(const std::string& name);
+
 	bool IsNonCefServer() const { return non_cef_server_.load(); }
 
 	using SessionActiveHandler = std::function<void(bool)>;
@@ -59,6 +66,8 @@ private:
 
 	void HandleRawMessage(const char* data, size_t len);
 	void HandleKcpInput();
+	void ApplyEventTable(const EventTablePacket& table);
+	bool ResolveEventName(EmitEventPacket& event);
 
 	void FireSessionActive(bool active);
 
@@ -75,6 +84,7 @@ private:
 	asio::ip::udp::endpoint remote_endpoint_;
 	std::thread network_thread_;
 	std::array<char, 65535> recv_buffer_{};
+	ReceiveContext receive_; // network thread only, see HandleKcpInput
 
 	asio::steady_timer connect_timer_{ io_context_ };
 	asio::steady_timer kcp_update_timer_{ io_context_ };
@@ -82,12 +92,18 @@ private:
 	std::mutex kcp_mutex_;
 	ikcpcb* kcp_instance_ = nullptr;
 
-	std::vector<uint8_t> rx_key_;
-	std::vector<uint8_t> tx_key_;
+	// Seal under kcp_mutex_, Open on the network thread.
+	SessionCipher cipher_;
 	std::vector<uint8_t> client_public_key_;
 	std::vector<uint8_t> client_private_key_;
 
-	PacketHandler packet_handler_;
+	// Per-session, filled by EventTable packets. Cleared on disconnect and when a join is
+	// accepted, the server then sends its whole table again.
+	CefEvent::EventTable event_table_;
+	std::mutex events_mutex_;
+
+	// Shared so the receive path takes a reference instead of copying the function.
+	std::shared_ptr<const PacketHandler> packet_handler_;
 	std::mutex handler_mutex_;
 
 	int join_attempts_ = 0;
@@ -1,4 +1,5 @@
 ﻿#include "runtime.hpp"
+#include <algorithm>
 
 #include <windows.h>
 
@@ -64,6 +65,8 @@ bool Runtime::Start()
 	}
 
 	resources_ = std::make_unique<ResourceManager>(*gta_);
+	resources_->SetCacheBudget(static_cast<size_t>(std::max(0, config_->Get<int>("vfs_cache_mb", 64))) * 1024 * 1024);
+	resources_->SetServeDeflated(config_->Get<bool>("vfs_serve_deflate", false));
 	network_ = std::make_unique<NetworkManager>(*resources_);
 	resources_->SetNetworkManager(*network_);
 
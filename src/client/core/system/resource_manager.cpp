@@ -2,14 +2,14 @@
 
 #include <filesystem>
 #include <fstream>
-
-#include <miniz.h>
+#include <utility>
 
 #include "gta.hpp"
 #include "network/network_manager.hpp"
 #include "system/logger.hpp"
-#include "shared/crypto.hpp"
+#include "shared/pak-format.hpp"
 #include "shared/utils.hpp"
+#include "shared/zip-pak.hpp"
 #include "ui/download_dialog.hpp"
 
 ResourceManager::ResourceManager(Gta& gta) : gta_(gta) {}
@@ -47,8 +47,15 @@ void ResourceManager::OnDisconnect()
 
 	state_ = DownloadState::IDLE;
 	server_manifest_ = nlohmann::json{};
+	pending_manifest_update_ = nlohmann::json{};
 	download_progress_.clear();
-	assembling_files_.clear();
+
+	for (auto& transfer : transfers_)
+		transfer = FileAssemblyData{};
+
+	const FileCacheStats cache = file_cache_.GetStats();
+	LOG_INFO("[ResourceManager] VFS cache: {} hits, {} misses, {} evictions, {} files ({} / {} bytes)",
+		cache.hits, cache.misses, cache.evictions, cache.entries, cache.bytes, cache.budget);
 }
 
 void ResourceManager::SetMasterKey(const std::vector<uint8_t>& key)
@@ -56,17 +63,78 @@ void ResourceManager::SetMasterKey(const std::vector<uint8_t>& key)
 	master_key_ = key;
 }
 
+void ResourceManager::SetCacheBudget(size_t bytes)
+{
+	file_cache_.SetBudget(bytes);
+}
+
 void ResourceManager::OnManifestReceived(const std::string& manifestJson)
 {
 	try {
-		server_manifest_ = nlohmann::json::parse(manifestJson);
-		LOG_DEBUG("[ResourceManager] Manifest received with {} resources", server_manifest_.size());
+		nlohmann::json manifest = nlohmann::json::parse(manifestJson);
+		LOG_DEBUG("[ResourceManager] Manifest received with {} resources", manifest.size());
+
+		std::lock_guard<std::mutex> lock(download_mutex_);
+		server_manifest_ = std::move(manifest);
 	}
 	catch (const std::exception& e) {
 		LOG_ERROR("[ResourceManager] Failed to parse manifest: {}", e.what());
 	}
 }
 
+void ResourceManager::OnManifestUpdate(const std::string& manifestJson)
+{
+	nlohmann::json update;
+	try {
+		update = nlohmann::json::parse(manifestJson);
+	}
+	catch (const std::exception& e) {
+		LOG_ERROR("[ResourceManager] Failed to parse manifest update: {}", e.what());
+		return;
+	}
+
+	if (!update.is_object() || update.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(download_mutex_);
+
+		for (auto& [resourceName, files] : update.items())
+			server_manifest_[resourceName] = files;
+
+		// Not verified yet, TriggerDownload takes it from server_manifest_.
+		const DownloadState state = state_.load();
+		if (state == DownloadState::IDLE || state == DownloadState::AWAITING_TRIGGER)
+			return;
+
+		if (!pending_manifest_update_.is_object())
+			pending_manifest_update_ = nlohmann::json::object();
+
+		for (auto& [resourceName, files] : update.items())
+			pending_manifest_update_[resourceName] = files;
+	}
+
+	// Waits for the current download otherwise, which runs it when it completes.
+	RunPendingManifestUpdate();
+}
+
+void ResourceManager::RunPendingManifestUpdate()
+{
+	nlohmann::json update;
+	{
+		std::lock_guard<std::mutex> lock(download_mutex_);
+
+		DownloadState expected = DownloadState::COMPLETED;
+		if (pending_manifest_update_.is_null() || !state_.compare_exchange_strong(expected, DownloadState::VERIFYING_CACHE))
+			return;
+
+		update = std::exchange(pending_manifest_update_, nlohmann::json{});
+	}
+
+	LOG_INFO("[ResourceManager] Server published {} new resource(s).", update.size());
+	DownloadMissingFiles(update);
+}
+
 void ResourceManager::MarkAsReadyToDownload()
 {
 	DownloadState expected = DownloadState::IDLE;
@@ -101,10 +169,21 @@ void ResourceManager::TriggerDownload()
 	state_ = DownloadState::VERIFYING_CACHE;
 	LOG_INFO("[ResourceManager] Verifying cache...");
 
-		std::vector<std::pair<std::string, std::string>> files_to_request;
+	nlohmann::json manifest;
+	{
+		std::lock_guard<std::mutex> lock(download_mutex_);
+		manifest = server_manifest_;
+	}
+
+	DownloadMissingFiles(manifest);
+}
+
+void ResourceManager::DownloadMissingFiles(const nlohmann::json& manifest)
+{
+	std::vector<std::pair<std::string, std::string>> files_to_request;
 	std::vector<FileProgressData> progress_list;
 
-	for (auto& [resourceName, files] : server_manifest_.items()) {
+	for (auto& [resourceName, files] : manifest.items()) {
         LOG_INFO("[Cache Check] Checking resource: {}", resourceName);
         
         for (auto& file_entry : files) {
@@ -180,13 +259,19 @@ void ResourceManager::TriggerDownload()
 	else {
 		LOG_INFO("[ResourceManager] All local resources are up-to-date.");
 		state_ = DownloadState::COMPLETED;
+		RunPendingManifestUpdate();
 	}
 }
 
-void ResourceManager::OnFileData(const FileDataPacket& packet)
+void ResourceManager::OnFileTransferBegin(const FileTransferBeginPacket& packet)
 {
 	if (state_ != DownloadState::DOWNLOADING) {
-		LOG_WARN("[ResourceManager] Received FileData in wrong state: {}", static_cast<int>(state_.load()));
+		LOG_WARN("[ResourceManager] Received FileTransferBegin in wrong state: {}", static_cast<int>(state_.load()));
+		return;
+	}
+
+	if (packet.id >= MAX_FILE_TRANSFERS) {
+		LOG_ERROR("[ResourceManager] Invalid transfer id {} for '{}'", packet.id, packet.relativePath);
 		return;
 	}
 
@@ -194,130 +279,211 @@ void ResourceManager::OnFileData(const FileDataPacket& packet)
 
 	std::lock_guard<std::mutex> lock(download_mutex_);
 
-	std::string fileKey = packet.resourceName + "/" + packet.relativePath;
+	auto& transfer = transfers_[packet.id];
+	if (transfer.active)
+		LOG_WARN("[ResourceManager] Transfer {} reused before '{}' ended", packet.id, transfer.relativePath);
+
+	transfer.active = true;
+	transfer.failed = false;
+	transfer.resourceName = packet.resourceName;
+	transfer.relativePath = packet.relativePath;
+	transfer.fileHash = packet.fileHash;
+	transfer.size = packet.size;
+	transfer.data.clear();
+	transfer.hasher.Reset();
+
+	transfer.progressIndex = download_progress_.size();
+	for (size_t i = 0; i < download_progress_.size(); ++i) {
+		if (download_progress_[i].fileName == packet.relativePath) {
+			transfer.progressIndex = i;
+			download_progress_[i].bytesReceived = 0;
+			break;
+		}
+	}
 
-	auto& assembly = assembling_files_[fileKey];
+	// The announced size decides what is reserved, so only files requested from the manifest
+	// are taken, at the size it lists. A refused transfer drops its chunks and ends incomplete.
+	if (transfer.progressIndex == download_progress_.size()) {
+		LOG_ERROR("[ResourceManager] Refusing transfer of '{}': not requested", packet.relativePath);
+		transfer.failed = true;
+		return;
+	}
 
-	if (assembly.totalChunks == 0)
-	{
-		assembly.totalChunks = packet.totalChunks;
-		assembly.chunks.resize(packet.totalChunks);
+	if (packet.size != download_progress_[transfer.progressIndex].totalSize) {
+		LOG_ERROR("[ResourceManager] Refusing transfer of '{}': {} bytes, the manifest lists {}",
+			packet.relativePath, packet.size, download_progress_[transfer.progressIndex].totalSize);
+		transfer.failed = true;
+		return;
+	}
+
+	transfer.data.reserve(packet.size);
 
-		//LOG_INFO("[Download] Starting assembly for '{}' ({} chunks)", packet.relativePath, packet.totalChunks);
+	//LOG_INFO("[Download] Starting transfer {} for '{}' ({} bytes)", packet.id, packet.relativePath, packet.size);
+}
+
+void ResourceManager::OnFileChunk(const FileChunkPacket& packet)
+{
+	if (state_ != DownloadState::DOWNLOADING) {
+		LOG_WARN("[ResourceManager] Received FileChunk in wrong state: {}", static_cast<int>(state_.load()));
+		return;
 	}
 
-	if (packet.totalChunks != assembly.totalChunks)
+	if (packet.id >= MAX_FILE_TRANSFERS)
+		return;
+
+	last_packet_time_ = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(download_mutex_);
+
+	auto& transfer = transfers_[packet.id];
+	if (!transfer.active || transfer.failed)
+		return;
+
+	if (packet.offset != transfer.data.size() || packet.data.size() > transfer.size - transfer.data.size())
 	{
-		LOG_ERROR("[ResourceManager] Chunk count mismatch for '{}': expected {}, got {}", packet.relativePath, assembly.totalChunks, packet.totalChunks);
+		LOG_ERROR("[ResourceManager] Unexpected chunk of {} bytes at {} for '{}' ({} of {} bytes received)",
+			packet.data.size(), packet.offset, transfer.relativePath, transfer.data.size(), transfer.size);
+
+		transfer.failed = true;
 		return;
 	}
 
-	if (packet.chunkIndex >= assembly.totalChunks)
-	{
-		LOG_ERROR("[ResourceManager] Invalid chunk index {} for '{}'", packet.chunkIndex, packet.relativePath);
+	transfer.data.insert(transfer.data.end(), packet.data.begin(), packet.data.end());
+	transfer.hasher.Update(packet.data.data(), packet.data.size());
+
+	if (transfer.progressIndex < download_progress_.size()) {
+		auto& progress = download_progress_[transfer.progressIndex];
+		progress.bytesReceived += packet.data.size();
+
+		download_dialog_->Update(static_cast<uint32_t>(transfer.progressIndex), progress.bytesReceived);
+	}
+}
+
+void ResourceManager::OnFileTransferEnd(const FileTransferEndPacket& packet)
+{
+	if (state_ != DownloadState::DOWNLOADING) {
+		LOG_WARN("[ResourceManager] Received FileTransferEnd in wrong state: {}", static_cast<int>(state_.load()));
 		return;
 	}
 
-	if (assembly.chunks[packet.chunkIndex].empty())
-	{
-		assembly.chunks[packet.chunkIndex] = packet.data;
-		assembly.receivedChunks++;
-
-		for (size_t i = 0; i < download_progress_.size(); ++i) {
-			if (download_progress_[i].fileHash == packet.fileHash) {
-				auto& progress = download_progress_[i];
-				download_progress_[i].bytesReceived += packet.data.size();
-
-				int percentage = (progress.totalSize > 0)
-					? static_cast<int>((static_cast<double>(progress.bytesReceived) / progress.totalSize) * 100.0)
-					: 100;
-				
-				download_dialog_->Update(static_cast<uint32_t>(i), download_progress_[i].bytesReceived);
-			}
-		}
+	if (packet.id >= MAX_FILE_TRANSFERS)
+		return;
+
+	last_packet_time_ = std::chrono::steady_clock::now();
+
+	std::unique_lock<std::mutex> lock(download_mutex_);
+
+	auto& transfer = transfers_[packet.id];
+	if (!transfer.active) {
+		LOG_WARN("[ResourceManager] End of unknown transfer {}", packet.id);
+		return;
 	}
 
-	if (assembly.receivedChunks == assembly.totalChunks)
-	{
-		LOG_INFO("[ResourceManager] All chunks received for '{}', assembling...", packet.relativePath);
+	transfer.active = false;
 
-		std::vector<uint8_t> completeFile;
-		size_t totalSize = 0;
-		for (const auto& chunk : assembly.chunks) {
-			totalSize += chunk.size();
-		}
+	// Assembled files can be large, none is kept once the transfer is over.
+	std::vector<uint8_t> completeFile = std::move(transfer.data);
+	transfer.data = {};
 
-		completeFile.reserve(totalSize);
+	FileProgressData* progress = transfer.progressIndex < download_progress_.size()
+		? &download_progress_[transfer.progressIndex]
+		: nullptr;
 
-		for (const auto& chunk : assembly.chunks) {
-			completeFile.insert(completeFile.end(), chunk.begin(), chunk.end());
-		}
+	if (transfer.failed || completeFile.size() != transfer.size)
+	{
+		LOG_ERROR("[ResourceManager] Transfer of '{}' ended incomplete: {} of {} bytes", transfer.relativePath, completeFile.size(), transfer.size);
 
-		std::string receivedHash = CalculateSHA256FromData(completeFile);
-		if (receivedHash != packet.fileHash)
-		{
-			LOG_ERROR("[ResourceManager] Hash mismatch for '{}': expected {}, got {}", packet.relativePath, packet.fileHash, receivedHash);
+		if (progress)
+			progress->isComplete = false;
+		return;
+	}
 
-			assembling_files_.erase(fileKey);
+	LOG_INFO("[ResourceManager] All chunks received for '{}', saving...", transfer.relativePath);
 
-			for (auto& progress : download_progress_)
-			{
-				if (progress.fileName == packet.relativePath) {
-					progress.isComplete = false;
-					break;
-				}
-			}
-			return;
-		}
+	std::string receivedHash = transfer.hasher.FinalHex();
+	if (receivedHash != transfer.fileHash)
+	{
+		LOG_ERROR("[ResourceManager] Hash mismatch for '{}': expected {}, got {}", transfer.relativePath, transfer.fileHash, receivedHash);
 
-		std::string savePath = server_cache_path_ + "/" + packet.relativePath;
-		std::filesystem::create_directories(std::filesystem::path(savePath).parent_path());
+		if (progress)
+			progress->isComplete = false;
+		return;
+	}
 
-		try {
-			std::ofstream outFile(savePath, std::ios::binary);
+	std::string savePath = server_cache_path_ + "/" + transfer.relativePath;
+	std::string tempPath = savePath + ".tmp";
+	std::filesystem::create_directories(std::filesystem::path(savePath).parent_path());
+
+	try {
+		// The old pak may still be mapped (MappedFile), so the new one is written next to
+		// it and renamed over it, never truncated in place.
+		{
+			std::ofstream outFile(tempPath, std::ios::binary | std::ios::trunc);
 			outFile.write(reinterpret_cast<const char*>(completeFile.data()), completeFile.size());
 			outFile.close();
 
-			LOG_INFO("[ResourceManager] File '{}' saved successfully ({} bytes)", packet.relativePath, completeFile.size());
+			if (!outFile) {
+				LOG_ERROR("[ResourceManager] Failed to write '{}'", tempPath);
 
-			if (LoadPakIntoVFS(packet.resourceName, savePath))
-			{
-				LOG_INFO("[ResourceManager] Loaded '{}' into VFS", packet.resourceName);
-			}
+				std::error_code ec;
+				std::filesystem::remove(tempPath, ec);
 
-			for (auto& progress : download_progress_)
-			{
-				if (progress.fileName == packet.relativePath) {
-					progress.isComplete = true;
-					progress.fileHash = receivedHash;
-					break;
-				}
+				if (progress)
+					progress->isComplete = false;
+				return;
 			}
+		}
 
-			assembling_files_.erase(fileKey);
+		UnloadResource(transfer.resourceName);
 
-			bool allComplete = true;
+		std::error_code ec;
+		std::filesystem::rename(tempPath, savePath, ec);
+		if (ec) {
+			LOG_ERROR("[ResourceManager] Failed to replace '{}': {}", savePath, ec.message());
 
-			for (const auto& progress : download_progress_)
-			{
-				if (!progress.isComplete) {
-					allComplete = false;
-					break;
-				}
-			}
+			std::filesystem::remove(tempPath, ec);
+
+			if (progress)
+				progress->isComplete = false;
+			return;
+		}
 
-			if (allComplete)
-			{
-				LOG_INFO("[ResourceManager] All downloads complete!");
+		LOG_INFO("[ResourceManager] File '{}' saved successfully ({} bytes)", transfer.relativePath, completeFile.size());
 
-				state_ = DownloadState::COMPLETED;
-				download_dialog_->Finish();
+		if (LoadPakIntoVFS(transfer.resourceName, savePath))
+		{
+			LOG_INFO("[ResourceManager] Loaded '{}' into VFS", transfer.resourceName);
+		}
+
+		if (progress) {
+			progress->isComplete = true;
+			progress->fileHash = receivedHash;
+		}
+
+		bool allComplete = true;
+
+		for (const auto& entry : download_progress_)
+		{
+			if (!entry.isComplete) {
+				allComplete = false;
+				break;
 			}
 		}
-		catch (const std::exception& e) {
-			LOG_ERROR("[ResourceManager] Failed to save file '{}': {}", packet.relativePath, e.what());
+
+		if (allComplete)
+		{
+			LOG_INFO("[ResourceManager] All downloads complete!");
+
+			state_ = DownloadState::COMPLETED;
+			download_dialog_->Finish();
+
+			lock.unlock();
+			RunPendingManifestUpdate();
 		}
 	}
+	catch (const std::exception& e) {
+		LOG_ERROR("[ResourceManager] Failed to save file '{}': {}", transfer.relativePath, e.what());
+	}
 }
 
 bool ResourceManager::LoadPakIntoVFS(const std::string& resourceName, const std::string& pakPath)
@@ -328,89 +494,216 @@ bool ResourceManager::LoadPakIntoVFS(const std::string& resourceName, const std:
 		return false;
 	}
 
-	mz_zip_archive zip{};
-	if (!mz_zip_reader_init_file(&zip, pakPath.c_str(), 0))
+	auto mapping = MappedFile::Open(pakPath);
+	if (!mapping)
 	{
 		LOG_ERROR("[ResourceManager] Failed to open PAK file: {}", pakPath);
 		return false;
 	}
 
-	const mz_uint num_files = mz_zip_reader_get_num_files(&zip);
-	LOG_DEBUG("[ResourceManager] Loading PAK with {} files", num_files);
+	LoadedResource resource;
+	size_t file_count = 0;
 
-	VirtualFileSystem vfs;
+	if (IsIndexedPak(mapping->Data(), mapping->Size()))
+	{
+		resource.pak = PakReader::Open(std::move(mapping), master_key_);
+		if (resource.pak)
+			file_count = resource.pak->Entries().size();
+	}
+	else
+	{
+		resource.zip = ZipPakReader::Open(std::move(mapping), master_key_);
+		if (resource.zip)
+			file_count = resource.zip->Count();
+	}
 
-	for (mz_uint i = 0; i < num_files; ++i)
+	if (!resource.pak && !resource.zip)
 	{
-		mz_zip_archive_file_stat file_stat;
-		if (!mz_zip_reader_file_stat(&zip, i, &file_stat))
-			continue;
+		LOG_ERROR("[ResourceManager] Failed to read PAK file: {} (corrupted or wrong key)", pakPath);
+		return false;
+	}
 
-		size_t uncomp_size = 0;
-		void* p = mz_zip_reader_extract_to_heap(&zip, i, &uncomp_size, 0);
-		if (!p)
-		{
-			LOG_WARN("[ResourceManager] Failed to extract file '{}' from PAK", file_stat.m_filename);
-			continue;
-		}
+	{
+		std::unique_lock<std::shared_mutex> lock(vfs_mutex_);
+		loaded_resources_vfs_[resourceName] = std::move(resource);
+	}
 
-		std::vector<uint8_t> encrypted_data(static_cast<uint8_t*>(p), static_cast<uint8_t*>(p) + uncomp_size);
-		mz_free(p);
+	// Content cached from a previous version of the pak.
+	file_cache_.ErasePrefixed(resourceName + "/");
 
-		if (encrypted_data.size() < 16)
-		{
-			LOG_WARN("[ResourceManager] File '{}' too small to contain IV", file_stat.m_filename);
-			continue;
-		}
+	LOG_INFO("[ResourceManager] Loaded resource '{}' into VFS ({} files)", resourceName, file_count);
+	return true;
+}
 
-		std::array<uint8_t, 16> iv;
-		std::copy_n(encrypted_data.begin(), 16, iv.begin());
+bool ResourceManager::FindResource(const std::string& resourceName, LoadedResource& outResource)
+{
+	std::shared_lock<std::shared_mutex> lock(vfs_mutex_);
 
-		std::vector<uint8_t> ciphertext(encrypted_data.begin() + 16, encrypted_data.end());
+	auto it = loaded_resources_vfs_.find(resourceName);
+	if (it == loaded_resources_vfs_.end())
+		return false;
 
-		std::vector<uint8_t> decrypted = DecryptFile(ciphertext, master_key_, iv);
-		if (decrypted.empty())
-		{
-			LOG_WARN("[ResourceManager] Failed to decrypt file '{}'", file_stat.m_filename);
-			continue;
-		}
+	outResource = it->second;
+	return true;
+}
 
-		vfs[file_stat.m_filename] = std::move(decrypted);
-		LOG_DEBUG("[ResourceManager] Decrypted file: {} ({} bytes)", file_stat.m_filename, decrypted.size());
-	}
+void ResourceManager::CacheIfCurrent(const std::string& resourceName, const LoadedResource& resource,
+	const std::string& cacheKey, std::shared_ptr<const Blob> content)
+{
+	// Inserted under the lock: a reload swaps the reader under the exclusive lock and erases
+	// the cache after, so content of the old pak is either erased or never inserted.
+	std::shared_lock<std::shared_mutex> lock(vfs_mutex_);
+
+	auto it = loaded_resources_vfs_.find(resourceName);
+	if (it == loaded_resources_vfs_.end() || it->second.pak != resource.pak || it->second.zip != resource.zip)
+		return;
 
-	mz_zip_reader_end(&zip);
+	file_cache_.Insert(cacheKey, std::move(content));
+}
 
+void ResourceManager::UnloadResource(const std::string& resourceName)
+{
 	{
-		std::lock_guard<std::mutex> lock(vfs_mutex_);
-		loaded_resources_vfs_[resourceName] = std::move(vfs);
+		std::unique_lock<std::shared_mutex> lock(vfs_mutex_);
+		loaded_resources_vfs_.erase(resourceName);
 	}
 
-	LOG_INFO("[ResourceManager] Loaded resource '{}' into VFS ({} files)", resourceName, num_files);
-	return true;
+	file_cache_.ErasePrefixed(resourceName + "/");
 }
 
 bool ResourceManager::GetFileContent(const std::string& resourceName,
 	const std::string& internalPath,
-	std::vector<uint8_t>& outContent)
+	std::shared_ptr<const Blob>& outContent)
 {
-	std::lock_guard<std::mutex> lock(vfs_mutex_);
+	const std::string cache_key = resourceName + "/" + internalPath;
 
-	auto it = loaded_resources_vfs_.find(resourceName);
-	if (it == loaded_resources_vfs_.end())
+	if (auto cached = file_cache_.Find(cache_key))
+	{
+		outContent = std::move(cached);
+		return true;
+	}
+
+	LoadedResource resource;
+	if (!FindResource(resourceName, resource))
 	{
 		LOG_WARN("[ResourceManager] Resource '{}' not found in VFS", resourceName);
 		return false;
 	}
 
-	auto& vfs = it->second;
-	auto file_it = vfs.find(internalPath);
-	if (file_it == vfs.end())
+	// Decrypted outside the lock, the readers keep their mapping alive.
+	auto content = std::make_shared<Blob>();
+	bool found = false;
+	bool read = false;
+
+	if (resource.pak)
+	{
+		if (const PakTocEntry* entry = resource.pak->Find(internalPath))
+		{
+			found = true;
+			read = resource.pak->Read(*entry, *content);
+		}
+	}
+	else if (resource.zip && resource.zip->Contains(internalPath))
+	{
+		found = true;
+		read = resource.zip->Read(internalPath, *content);
+	}
+
+	if (!found)
 	{
 		LOG_WARN("[ResourceManager] File '{}' not found in resource '{}'", internalPath, resourceName);
 		return false;
 	}
 
-	outContent = file_it->second;
+	if (!read)
+	{
+		LOG_WARN("[ResourceManager] Failed to decrypt file '{}' from resource '{}'", internalPath, resourceName);
+		return false;
+	}
+
+	outContent = content;
+	CacheIfCurrent(resourceName, resource, cache_key, std::move(content));
+	return true;
+}
+
+bool ResourceManager::GetFileInfo(const std::string& resourceName,
+	const std::string& internalPath,
+	ResourceFileInfo& outInfo)
+{
+	outInfo = {};
+
+	LoadedResource resource;
+	if (!FindResource(resourceName, resource))
+		return false;
+
+	if (resource.zip)
+		return resource.zip->Contains(internalPath);
+
+	const PakTocEntry* entry = resource.pak->Find(internalPath);
+	if (!entry)
+		return false;
+
+	outInfo.etag = "\"" + ToHexString(entry->hash, PAK_HASH_BYTES) + "\"";
+	outInfo.deflated = entry->codec == static_cast<uint8_t>(PakCodec::Deflate);
+	return true;
+}
+
+bool ResourceManager::GetEncodedFileContent(const std::string& resourceName,
+	const std::string& internalPath,
+	std::shared_ptr<const Blob>& outContent)
+{
+	// '#' never reaches a path, fragments are stripped from the URL.
+	const std::string cache_key = resourceName + "/" + internalPath + "#deflate";
+
+	if (auto cached = file_cache_.Find(cache_key))
+	{
+		outContent = std::move(cached);
+		return true;
+	}
+
+	LoadedResource resource;
+	if (!FindResource(resourceName, resource) || !resource.pak)
+		return false;
+
+	const PakTocEntry* entry = resource.pak->Find(internalPath);
+	if (!entry || entry->codec != static_cast<uint8_t>(PakCodec::Deflate))
+		return false;
+
+	auto content = std::make_shared<Blob>();
+	if (!resource.pak->ReadStored(*entry, *content))
+	{
+		LOG_WARN("[ResourceManager] Failed to decrypt file '{}' from resource '{}'", internalPath, resourceName);
+		return false;
+	}
+
+	outContent = content;
+	CacheIfCurrent(resourceName, resource, cache_key, std::move(content));
+	return true;
+}
+
+bool ResourceManager::OpenFileStream(const std::string& resourceName,
+	const std::string& internalPath,
+	ResourceStream& outStream)
+{
+	LoadedResource resource;
+	if (!FindResource(resourceName, resource) || !resource.pak)
+		return false;
+
+	const PakTocEntry* entry = resource.pak->Find(internalPath);
+	if (!entry || !IsSegmented(*entry))
+		return false;
+
+	outStream.pak = std::move(resource.pak);
+	outStream.entry = entry;
 	return true;
-}
\ No newline at end of file
+}
+
+uint64_t ResourceStream::Size() const
+{
+	return entry ? entry->size : 0;
+}
+
+bool ResourceStream::Read(uint64_t offset, uint64_t length, Blob& out) const
+{
+	return pak && entry && pak->ReadRange(*entry, offset, length, out);
+}
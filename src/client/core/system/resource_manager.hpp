@@ -1,22 +1,57 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <vector>
 #include <nlohmann/json.hpp>
+#include "shared/file-cache.hpp"
 #include "shared/packet.hpp"
+#include "shared/sha256.hpp"
+
+class PakReader;
+class ZipPakReader;
+struct PakTocEntry;
 
 class Gta;
 class NetworkManager;
 class DownloadDialog;
 
-// In-memory Virtual File System: maps an internal file path to its decrypted content
-using VirtualFileSystem = std::map<std::string, std::vector<uint8_t>>;
+// A loaded resource only holds the index of its mapped pak, one of the two is set.
+// Files are decrypted when first requested and kept in the ResourceManager FileCache.
+struct LoadedResource
+{
+	std::shared_ptr<const PakReader> pak;
+	std::shared_ptr<const ZipPakReader> zip;
+};
+
+// Large media sealed in segments (see shared/pak-format.hpp), read a range at a time
+// straight from the mapped pak instead of being decrypted whole and cached.
+struct ResourceStream
+{
+	std::shared_ptr<const PakReader> pak;
+	const PakTocEntry* entry = nullptr; // owned by pak
+
+	uint64_t Size() const;
+	bool Read(uint64_t offset, uint64_t length, Blob& out) const;
+};
+
+// What the scheme handler needs for conditional and encoded responses.
+struct ResourceFileInfo
+{
+	std::string etag;      // strong and quoted, from the file hash; empty for zip paks
+	bool deflated = false; // stored as a zlib stream, see GetEncodedFileContent
+};
+
+// Decrypted files kept in memory by default, see SetCacheBudget.
+constexpr size_t DEFAULT_VFS_CACHE_BYTES = 64 * 1024 * 1024;
 
 enum class DownloadState
 {
@@ -45,21 +80,58 @@ public:
 	void OnDisconnect();
 
 	void SetMasterKey(const std::vector<uint8_t>& key);
+	void SetCacheBudget(size_t bytes);
+	// Off by default: deflated files are inflated in-process and served as stored only
+	// when this is on, see GetEncodedFileContent.
+	void SetServeDeflated(bool enabled) { serve_deflated_.store(enabled, std::memory_order_relaxed); }
+	bool ServesDeflated() const { return serve_deflated_.load(std::memory_order_relaxed); }
 
 	void OnManifestReceived(const std::string& manifestJson);
+	// Resources the server published after we joined. Downloaded right away once the
+	// initial download is done, with it otherwise.
+	void OnManifestUpdate(const std::string& manifestJson);
 	void MarkAsReadyToDownload();
 	void TriggerDownload();
 
-	void OnFileData(const FileDataPacket& packet);
+	void OnFileTransferBegin(const FileTransferBeginPacket& packet);
+	void OnFileChunk(const FileChunkPacket& packet);
+	void OnFileTransferEnd(const FileTransferEndPacket& packet);
 
+	// Shared with the cache and other requests for the same file, never copied.
 	bool GetFileContent(const std::string& resourceName,
 		const std::string& internalPath,
-		std::vector<uint8_t>& outContent);
+		std::shared_ptr<const Blob>& outContent);
+
+	bool GetFileInfo(const std::string& resourceName,
+		const std::string& internalPath,
+		ResourceFileInfo& outInfo);
+
+	// The stored zlib stream of a deflated file, served with Content-Encoding: deflate
+	// so Chromium inflates it. Cached like GetFileContent.
+	bool GetEncodedFileContent(const std::string& resourceName,
+		const std::string& internalPath,
+		std::shared_ptr<const Blob>& outContent);
+
+	// False when the file is not a segmented pak entry, GetFileContent serves it then.
+	bool OpenFileStream(const std::string& resourceName,
+		const std::string& internalPath,
+		ResourceStream& outStream);
 
 	DownloadState GetState() const { return state_; }
+	FileCacheStats GetCacheStats() const { return file_cache_.GetStats(); }
 
 private:
 	bool LoadPakIntoVFS(const std::string& resourceName, const std::string& pakPath);
+	void UnloadResource(const std::string& resourceName);
+	bool FindResource(const std::string& resourceName, LoadedResource& outResource);
+	// Caches content read from `resource` unless the resource was reloaded or unloaded since.
+	void CacheIfCurrent(const std::string& resourceName, const LoadedResource& resource,
+		const std::string& cacheKey, std::shared_ptr<const Blob> content);
+
+	// Expects VERIFYING_CACHE. Loads the cached paks of `manifest` and requests the
+	// others, leaving the state at DOWNLOADING or COMPLETED.
+	void DownloadMissingFiles(const nlohmann::json& manifest);
+	void RunPendingManifestUpdate();
 
 	struct FileProgressData
 	{
@@ -67,16 +139,23 @@ private:
 		std::string fileHash;
 		size_t totalSize = 0;
 		size_t bytesReceived = 0;
-		uint32_t totalChunks = 0;
-		uint32_t receivedChunks = 0;
 		bool isComplete = false;
 	};
 
+	// One per transfer id, see FileTransferBeginPacket. Chunks arrive in order (KCP is
+	// ordered and the server sends each file front to back), so they are appended and
+	// hashed as they come and the file is verified without a second pass.
 	struct FileAssemblyData
 	{
-		uint32_t totalChunks = 0;
-		uint32_t receivedChunks = 0;
-		std::vector<std::vector<uint8_t>> chunks;
+		bool active = false;
+		bool failed = false; // a chunk did not fit, the rest is dropped until the end
+		std::string resourceName;
+		std::string relativePath;
+		std::string fileHash;
+		uint32_t size = 0;
+		size_t progressIndex = 0; // into download_progress_, its size when not listed
+		std::vector<uint8_t> data;
+		Sha256 hasher;
 	};
 
 private:
@@ -93,12 +172,15 @@ private:
 	std::atomic<DownloadState> state_{ DownloadState::IDLE };
 	nlohmann::json server_manifest_;
 
-	std::map<std::string, VirtualFileSystem> loaded_resources_vfs_;
-	std::mutex vfs_mutex_;
+	std::map<std::string, LoadedResource> loaded_resources_vfs_;
+	std::shared_mutex vfs_mutex_;
+	FileCache file_cache_{ DEFAULT_VFS_CACHE_BYTES };
+	std::atomic<bool> serve_deflated_{ false };
 
 	std::mutex download_mutex_;
+	nlohmann::json pending_manifest_update_; // guarded by download_mutex_, like server_manifest_
 	std::vector<FileProgressData> download_progress_;
-	std::map<std::string, FileAssemblyData> assembling_files_;
+	std::array<FileAssemblyData, MAX_FILE_TRANSFERS> transfers_; // indexed by transfer id
 
 	std::chrono::steady_clock::time_point last_packet_time_;
 };
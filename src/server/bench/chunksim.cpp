@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "common/chunk_sizer.hpp"
+#include "common/session.hpp"
+
+// cef-chunksim: in-process simulation of the file transfer path, comparing fixed 1200 byte
+// chunks with ChunkSizer. It models KCP at segment level with the server's settings (nodelay
+// 1, interval 10, resend 2, nc 1, 128 segment client window) on a link with a given rate, RTT
+// and loss. ProcessFileTransfers runs on the 10 ms tick with its segment budget and in-flight
+// cap, acks flush right away like ScheduleKcpUpdate. Every segment sent goes through the
+// server's RetransmitCounter as a KCP header, which is all the sizer learns about loss.
+// Local drops stand for datagrams the server loses before the socket (send pool
+// exhausted): KCP retransmits them like path loss, but the sizer is told and does not
+// count them.
+
+namespace
+{
+    constexpr uint32_t MSS = 1376;
+    constexpr uint32_t CHUNK_OVERHEAD = static_cast<uint32_t>(FILE_CHUNK_MESSAGE_OVERHEAD);
+    constexpr uint32_t DATAGRAM_OVERHEAD = 24 + 28; // KCP and UDP/IP headers
+    constexpr uint32_t FIXED_CHUNK = 1200;
+
+    constexpr int MAX_SEGMENTS_PER_TICK = 256;
+    constexpr size_t MAX_IN_FLIGHT_SEGMENTS = 220;
+    constexpr uint32_t RECEIVE_WINDOW = 128;
+    constexpr uint32_t TIME_LIMIT_MS = 600000;
+
+    struct Link
+    {
+        const char* name;
+        uint32_t rtt_ms;
+        double mbit;
+    };
+
+    struct Scenario
+    {
+        double path_loss;
+        double local_drops;
+    };
+
+    struct Segment
+    {
+        uint32_t payload = 0;
+        uint32_t resend_at = 0;
+        uint32_t rto = 0;
+        int fast_acks = 0;
+        bool sent = false;
+    };
+
+    struct Frame
+    {
+        uint32_t arrive;
+        uint32_t sn;
+        bool ack;
+        uint32_t una;
+    };
+
+    struct Result
+    {
+        double megabytes_per_second = 0;
+        uint64_t messages = 0;
+        uint32_t final_segments = 0;
+    };
+
+    Result Run(bool adaptive, const Link& link, const Scenario& scenario, uint64_t total, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> uniform(0, 1);
+
+        ChunkSizer sizer;
+        sizer.Reset(MSS, CHUNK_OVERHEAD);
+
+        // Sender: queued (not yet numbered) and sent-but-unacked segments.
+        std::deque<Segment> queue;
+        std::map<uint32_t, Segment> unacked;
+        uint32_t snd_nxt = 0, snd_una = 0;
+        RetransmitCounter counter;
+        uint64_t local_drops = 0;
+
+        // Receiver.
+        std::vector<bool> received;
+        std::vector<uint32_t> payloads;
+        uint32_t rcv_nxt = 0;
+        uint64_t delivered = 0;
+
+        std::vector<Frame> wire;
+        double link_free = 0;
+        const double bytes_per_ms = link.mbit * 1e6 / 8 / 1000;
+        const uint32_t one_way = std::max(1u, link.rtt_ms / 2);
+
+        uint64_t offset = 0, messages = 0;
+
+        const auto transmit = [&](uint32_t now, uint32_t sn) {
+            // One segment per datagram: PUSH, sn and an empty payload is all the counter reads.
+            char header[RetransmitCounter::SEGMENT_HEADER_SIZE] = {};
+            header[4] = static_cast<char>(RetransmitCounter::CMD_PUSH);
+            std::memcpy(header + 12, &sn, sizeof(sn));
+            counter.OnOutput(header, sizeof(header));
+
+            if (uniform(rng) < scenario.local_drops)
+            {
+                ++local_drops;
+                return;
+            }
+
+            link_free = std::max<double>(link_free, now) + (MSS + DATAGRAM_OVERHEAD) / bytes_per_ms;
+
+            if (uniform(rng) >= scenario.path_loss)
+                wire.push_back({ static_cast<uint32_t>(link_free + one_way), sn, false, 0 });
+        };
+
+        for (uint32_t now = 0; now < TIME_LIMIT_MS; ++now)
+        {
+            bool acked = false;
+
+            for (size_t i = 0; i < wire.size();)
+            {
+                const Frame frame = wire[i];
+                if (frame.arrive > now)
+                {
+                    ++i;
+                    continue;
+                }
+
+                wire[i] = wire.back();
+                wire.pop_back();
+
+                if (!frame.ack)
+                {
+                    if (received.size() <= frame.sn)
+                        received.resize(frame.sn + 1);
+
+                    received[frame.sn] = true;
+
+                    while (rcv_nxt < received.size() && received[rcv_nxt])
+                        delivered += payloads[rcv_nxt++];
+
+                    if (uniform(rng) >= scenario.path_loss)
+                        wire.push_back({ now + one_way, frame.sn, true, rcv_nxt });
+
+                    continue;
+                }
+
+                acked = true;
+
+                unacked.erase(unacked.begin(), unacked.lower_bound(frame.una));
+                unacked.erase(frame.sn);
+
+                for (auto& [sn, segment] : unacked)
+                {
+                    if (sn < frame.sn)
+                        ++segment.fast_acks;
+                }
+
+                snd_una = unacked.empty() ? snd_nxt : unacked.begin()->first;
+            }
+
+            if (delivered >= total)
+                return { static_cast<double>(total) / 1e6 / (now / 1000.0), messages, sizer.Segments() };
+
+            // ProcessFileTransfers, on the network tick.
+            if (now % 10 == 0)
+            {
+                int budget = MAX_SEGMENTS_PER_TICK;
+
+                while (offset < total && budget > 0 && queue.size() + unacked.size() < MAX_IN_FLIGHT_SEGMENTS)
+                {
+                    if (adaptive)
+                        sizer.Observe(snd_nxt, counter.Retransmits(), local_drops);
+
+                    const uint64_t chunk = std::min<uint64_t>(adaptive ? sizer.ChunkBytes() : FIXED_CHUNK, total - offset);
+                    const uint32_t segments = static_cast<uint32_t>((chunk + CHUNK_OVERHEAD + MSS - 1) / MSS);
+
+                    for (uint32_t k = 0; k < segments; ++k)
+                    {
+                        Segment segment;
+                        segment.payload = static_cast<uint32_t>(chunk / segments + (k == 0 ? chunk % segments : 0));
+                        queue.push_back(segment);
+                    }
+
+                    offset += chunk;
+                    budget -= static_cast<int>(segments);
+                    ++messages;
+                }
+            }
+            else if (!acked)
+            {
+                continue;
+            }
+
+            // ikcp_flush.
+            while (!queue.empty() && snd_nxt < snd_una + RECEIVE_WINDOW)
+            {
+                payloads.push_back(queue.front().payload);
+                unacked[snd_nxt++] = queue.front();
+                queue.pop_front();
+            }
+
+            const uint32_t rto = link.rtt_ms + 30;
+
+            for (auto& [sn, segment] : unacked)
+            {
+                if (!segment.sent)
+                {
+                    segment.sent = true;
+                    segment.rto = rto;
+                }
+                else if (now >= segment.resend_at)
+                {
+                    segment.rto += segment.rto / 2;
+                }
+                else if (segment.fast_acks >= 2)
+                {
+                    segment.fast_acks = 0;
+                }
+                else
+                {
+                    continue;
+                }
+
+                segment.resend_at = now + segment.rto;
+                transmit(now, sn);
+            }
+        }
+
+        return { 0, messages, sizer.Segments() };
+    }
+}
+
+int main()
+{
+    constexpr uint64_t PAK_SIZE = 32ull << 20;
+
+    const Link links[] = {
+        { "LAN 2 ms, 1 Gbit/s", 2, 1000 },
+        { "broadband 40 ms, 100 Mbit/s", 40, 100 },
+    };
+
+    const Scenario scenarios[] = {
+        { 0.0, 0.0 }, { 0.005, 0.0 }, { 0.01, 0.0 }, { 0.02, 0.0 }, { 0.05, 0.0 }, { 0.10, 0.0 },
+        { 0.0, 0.05 }, { 0.0, 0.20 },
+    };
+
+    for (const auto& link : links)
+    {
+        std::printf("%s, 32 MB pak\n", link.name);
+        std::printf("  path loss  local drops   fixed %u B              adaptive\n", FIXED_CHUNK);
+
+        for (const auto& scenario : scenarios)
+        {
+            const Result fixed = Run(false, link, scenario, PAK_SIZE, 1);
+            const Result adaptive = Run(true, link, scenario, PAK_SIZE, 1);
+
+            std::printf("  %8.1f%%  %10.1f%%   %6.2f MB/s %7llu msgs   %6.2f MB/s %7llu msgs (%u segments per chunk at the end)\n",
+                scenario.path_loss * 100, scenario.local_drops * 100,
+                fixed.megabytes_per_second, static_cast<unsigned long long>(fixed.messages),
+                adaptive.megabytes_per_second, static_cast<unsigned long long>(adaptive.messages), adaptive.final_segments);
+        }
+    }
+
+    return 0;
+}
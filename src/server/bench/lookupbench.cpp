@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/session.hpp"
+
+// cef-lookupbench: endpoint -> session lookups per second with MAX_SESSIONS (1000) players
+// connected, the work done for every received datagram. Compares GetSessionFromAddress,
+// a bare EndpointTable::Find, and the string-keyed maps under one mutex it replaced, on 1
+// thread and on several reading at once (the network thread and the callers of GetSession).
+
+namespace
+{
+    // The lookup before EndpointTable, kept here for comparison only.
+    class LegacySessionMap
+    {
+    public:
+        void Map(int playerid, const asio::ip::udp::endpoint& addr, std::shared_ptr<NetworkSession> session)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            addr_str_to_playerid_[EndpointToStr(addr)] = playerid;
+            player_sessions_[playerid] = std::move(session);
+        }
+
+        std::shared_ptr<NetworkSession> GetSessionFromAddress(const asio::ip::udp::endpoint& addr)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            auto it_pid = addr_str_to_playerid_.find(EndpointToStr(addr));
+            if (it_pid != addr_str_to_playerid_.end())
+            {
+                auto it_session = player_sessions_.find(it_pid->second);
+                if (it_session != player_sessions_.end())
+                    return it_session->second;
+            }
+
+            return nullptr;
+        }
+
+    private:
+        static std::string EndpointToStr(const asio::ip::udp::endpoint& addr)
+        {
+            return addr.address().to_string() + ":" + std::to_string(addr.port());
+        }
+
+        std::mutex mutex_;
+        std::unordered_map<int, std::shared_ptr<NetworkSession>> player_sessions_;
+        std::unordered_map<std::string, int> addr_str_to_playerid_;
+    };
+
+    // Runs `lookup(endpoint)` `per_thread` times on each of `threads` threads over the
+    // shuffled endpoints. Returns lookups per second overall, or 0 if one missed.
+    template <typename Lookup>
+    double Run(int threads, size_t per_thread, const std::vector<asio::ip::udp::endpoint>& endpoints, Lookup lookup)
+    {
+        std::vector<std::thread> workers;
+        std::vector<size_t> misses(static_cast<size_t>(threads), 0);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]() {
+                size_t index = static_cast<size_t>(t) * 97;
+                for (size_t i = 0; i < per_thread; ++i)
+                {
+                    if (!lookup(endpoints[index]))
+                        ++misses[static_cast<size_t>(t)];
+
+                    if (++index == endpoints.size())
+                        index = 0;
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+            worker.join();
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (const size_t missed : misses)
+        {
+            if (missed != 0)
+                return 0;
+        }
+
+        return static_cast<double>(per_thread) * threads / seconds;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t per_thread = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+
+    if (per_thread == 0)
+    {
+        std::fprintf(stderr, "Usage: cef-lookupbench [lookups per thread, default 5000000]\n");
+        return 2;
+    }
+
+    NetworkSessionManager sessions;
+    LegacySessionMap legacy;
+    EndpointTable table;
+    std::vector<asio::ip::udp::endpoint> endpoints;
+
+    // Players behind NATs and a few IPv6 clients, each on its own port.
+    std::mt19937 rng(1);
+
+    for (int playerid = 0; playerid < MAX_SESSIONS; ++playerid)
+    {
+        const unsigned short port = static_cast<unsigned short>(1024 + rng() % 60000);
+        asio::ip::udp::endpoint endpoint;
+
+        if (playerid % 10 == 9)
+        {
+            asio::ip::address_v6::bytes_type bytes{};
+            bytes[0] = 0x20;
+            bytes[1] = 0x01;
+            for (size_t i = 8; i < bytes.size(); ++i)
+                bytes[i] = static_cast<unsigned char>(rng());
+
+            endpoint = asio::ip::udp::endpoint(asio::ip::address_v6(bytes), port);
+        }
+        else
+        {
+            endpoint = asio::ip::udp::endpoint(asio::ip::address_v4(static_cast<uint32_t>(rng())), port);
+        }
+
+        sessions.RegisterPlayer(playerid);
+        sessions.MapAddressToPlayer(playerid, endpoint);
+        legacy.Map(playerid, endpoint, sessions.GetSession(playerid));
+        table.Insert(EndpointKey::From(endpoint), playerid);
+        endpoints.push_back(endpoint);
+    }
+
+    std::shuffle(endpoints.begin(), endpoints.end(), rng);
+
+    const int cores = static_cast<int>(std::clamp(std::thread::hardware_concurrency(), 2u, 8u));
+
+    std::printf("%d sessions, %zu lookups per thread\n", MAX_SESSIONS, per_thread);
+    std::printf("  %-28s %16s %16s\n", "", "1 thread", (std::to_string(cores) + " threads").c_str());
+
+    const auto print = [&](const char* name, auto lookup) {
+        const double one = Run(1, per_thread, endpoints, lookup);
+        const double many = Run(cores, per_thread, endpoints, lookup);
+
+        if (one == 0 || many == 0)
+        {
+            std::printf("  %-28s lookup missed\n", name);
+            return false;
+        }
+
+        std::printf("  %-28s %9.1f M/s %12.1f M/s\n", name, one / 1e6, many / 1e6);
+        return true;
+    };
+
+    bool ok = true;
+
+    ok &= print("GetSessionFromAddress", [&](const asio::ip::udp::endpoint& endpoint) {
+        return sessions.GetSessionFromAddress(endpoint) != nullptr;
+    });
+
+    ok &= print("EndpointTable::Find", [&](const asio::ip::udp::endpoint& endpoint) {
+        return table.Find(EndpointKey::From(endpoint)) >= 0;
+    });
+
+    ok &= print("string maps under a mutex", [&](const asio::ip::udp::endpoint& endpoint) {
+        return legacy.GetSessionFromAddress(endpoint) != nullptr;
+    });
+
+    return ok ? 0 : 1;
+}
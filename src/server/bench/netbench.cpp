@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/network.hpp"
+
+// cef-netbench: loopback packets/sec and CPU per packet of NetworkServer, recvmmsg/sendmmsg
+// backend against the plain asio path. The send run pushes datagrams through SendTo (backing
+// off on IsSendBacklogged, like the file transfers) into a local sink, the receive run floods
+// the server port from another thread. CPU is the thread time of the network thread, plus the
+// producing thread for sends.
+
+namespace
+{
+    struct Options
+    {
+        size_t packets = 1000000;
+        size_t size = 1400;
+        unsigned short port = 47100;
+        bool send = true;
+        bool receive = true;
+        bool batched = true;
+        bool asio = true;
+    };
+
+    struct Result
+    {
+        size_t packets = 0;   // handed to SendTo, or sent to the server
+        size_t delivered = 0; // reached the sink, or the server's handler
+        double seconds = 0;
+        double cpu_seconds = 0;
+        SendPoolStats pool;
+    };
+
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage: cef-netbench [options]\n"
+            "\n"
+            "Options:\n"
+            "  -n, --packets <n>      Datagrams per run (default: 1000000)\n"
+            "  -s, --size <bytes>     Datagram size (default: 1400, the KCP mtu)\n"
+            "  -p, --port <port>      Server port, the send sink uses port + 1 (default: 47100)\n"
+            "      --send             Only run the send benchmark\n"
+            "      --receive          Only run the receive benchmark\n"
+            "      --batched          Only the recvmmsg/sendmmsg backend\n"
+            "      --asio             Only the asio backend\n"
+            "  -h, --help             Show this help\n");
+    }
+
+    double ThreadCpuSeconds()
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+    }
+
+    double Seconds(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    int OpenLoopbackSocket(unsigned short port)
+    {
+        const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0)
+            return -1;
+
+        int buffer = 8 * 1024 * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+
+        timeval timeout{ 0, 100 * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    // Runs `context` on its own thread until Finish, recording that thread's CPU time.
+    class NetworkThread
+    {
+    public:
+        explicit NetworkThread(asio::io_context& context)
+            : context_(context), work_(asio::make_work_guard(context))
+        {
+            thread_ = std::thread([this]() {
+                context_.run();
+                cpu_seconds_ = ThreadCpuSeconds();
+            });
+        }
+
+        double Finish(NetworkServer& server)
+        {
+            asio::post(context_, [&server]() { server.Stop(); });
+            work_.reset();
+            thread_.join();
+            return cpu_seconds_;
+        }
+
+    private:
+        asio::io_context& context_;
+        asio::executor_work_guard<asio::io_context::executor_type> work_;
+        std::thread thread_;
+        double cpu_seconds_ = 0;
+    };
+
+    bool RunSend(const Options& options, bool batched, Result& result)
+    {
+        const int sink = OpenLoopbackSocket(static_cast<unsigned short>(options.port + 1));
+        if (sink < 0)
+        {
+            std::fprintf(stderr, "Cannot bind the sink to port %u: %s\n", options.port + 1, std::strerror(errno));
+            return false;
+        }
+
+        std::atomic<bool> draining{ true };
+        std::atomic<size_t> delivered{ 0 };
+
+        std::thread receiver([&]() {
+            std::vector<char> buffer(65536);
+            while (draining.load(std::memory_order_relaxed))
+            {
+                if (recv(sink, buffer.data(), buffer.size(), 0) > 0)
+                    delivered.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+
+        asio::io_context context;
+        NetworkServer server(options.port, context, nullptr, nullptr, batched);
+        server.Start();
+
+        NetworkThread network(context);
+
+        const asio::ip::udp::endpoint to(asio::ip::address_v4::loopback(), static_cast<unsigned short>(options.port + 1));
+        const std::vector<char> payload(options.size, 'x');
+
+        const auto start = std::chrono::steady_clock::now();
+        const double cpu_start = ThreadCpuSeconds();
+
+        for (size_t i = 0; i < options.packets; ++i)
+        {
+            while (server.IsSendBacklogged())
+                std::this_thread::yield();
+
+            server.SendTo(to, payload.data(), static_cast<int>(payload.size()));
+        }
+
+        const double producer_cpu = ThreadCpuSeconds() - cpu_start;
+
+        // Every buffer back in the pool means everything was written (or refused).
+        while (server.GetSendPoolStats().in_use > 0)
+            std::this_thread::yield();
+
+        result.seconds = Seconds(start);
+        result.packets = options.packets;
+        result.pool = server.GetSendPoolStats();
+        result.cpu_seconds = producer_cpu + network.Finish(server);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        draining = false;
+        receiver.join();
+        close(sink);
+
+        result.delivered = delivered.load();
+        return true;
+    }
+
+    bool RunReceive(const Options& options, bool batched, Result& result)
+    {
+        asio::io_context context;
+        size_t handled = 0; // network thread only, read after it is joined
+
+        NetworkServer server(options.port, context,
+            [&handled](const asio::ip::udp::endpoint&, const char*, int) { ++handled; },
+            nullptr, batched);
+        server.Start();
+
+        const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0)
+        {
+            std::fprintf(stderr, "Cannot open the sending socket: %s\n", std::strerror(errno));
+            return false;
+        }
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(options.port);
+        connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+
+        NetworkThread network(context);
+
+        // Batches of 64 keep the flood cheap enough to outrun the receiving side.
+        constexpr size_t BATCH = 64;
+        const std::vector<char> payload(options.size, 'x');
+        iovec iov{ const_cast<char*>(payload.data()), payload.size() };
+        std::vector<mmsghdr> messages(BATCH);
+
+        for (auto& message : messages)
+        {
+            std::memset(&message, 0, sizeof(message));
+            message.msg_hdr.msg_iov = &iov;
+            message.msg_hdr.msg_iovlen = 1;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        size_t sent = 0;
+        while (sent < options.packets)
+        {
+            const unsigned int batch = static_cast<unsigned int>(std::min(BATCH, options.packets - sent));
+            const int count = sendmmsg(fd, messages.data(), batch, 0);
+
+            if (count > 0)
+                sent += static_cast<size_t>(count);
+            else if (errno != EAGAIN && errno != ENOBUFS && errno != EINTR)
+                break;
+        }
+
+        // Let the server drain its socket buffer.
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        result.seconds = Seconds(start) - 0.2;
+        result.packets = sent;
+        result.cpu_seconds = network.Finish(server);
+        result.delivered = handled;
+
+        close(fd);
+        return true;
+    }
+
+    void Print(const char* direction, const char* backend, const Options& options, const Result& result)
+    {
+        const double pps = result.seconds > 0 ? static_cast<double>(result.delivered) / result.seconds : 0;
+        const double cpu_ns = result.delivered > 0 ? result.cpu_seconds * 1e9 / static_cast<double>(result.delivered) : 0;
+        const double delivered = result.packets > 0 ? 100.0 * static_cast<double>(result.delivered) / static_cast<double>(result.packets) : 0;
+
+        std::printf("%-7s %-7s %zu x %zu B: %.3f s, %.0f packets/s, %.0f ns CPU per packet, %.1f%% delivered",
+            direction, backend, result.packets, options.size, result.seconds, pps, cpu_ns, delivered);
+
+        if (std::strcmp(direction, "send") == 0)
+        {
+            std::printf(", send buffers high-water %zu, %llu refused by the socket",
+                result.pool.high_water, static_cast<unsigned long long>(result.pool.dropped));
+        }
+
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    bool only_send = false, only_receive = false, only_batched = false, only_asio = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> const char* {
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-n" || arg == "--packets")
+            options.packets = std::strtoull(value(), nullptr, 10);
+        else if (arg == "-s" || arg == "--size")
+            options.size = std::strtoull(value(), nullptr, 10);
+        else if (arg == "-p" || arg == "--port")
+            options.port = static_cast<unsigned short>(std::strtoul(value(), nullptr, 10));
+        else if (arg == "--send")
+            only_send = true;
+        else if (arg == "--receive")
+            only_receive = true;
+        else if (arg == "--batched")
+            only_batched = true;
+        else if (arg == "--asio")
+            only_asio = true;
+        else if (arg == "-h" || arg == "--help")
+        {
+            PrintUsage();
+            return 0;
+        }
+        else
+        {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    if (only_send || only_receive)
+    {
+        options.send = only_send;
+        options.receive = only_receive;
+    }
+
+    if (only_batched || only_asio)
+    {
+        options.batched = only_batched;
+        options.asio = only_asio;
+    }
+
+    if (options.packets == 0 || options.size == 0 || options.size > SendBufferPool::BUFFER_SIZE)
+    {
+        std::fprintf(stderr, "Packets must be positive and the size within 1..%zu bytes.\n", SendBufferPool::BUFFER_SIZE);
+        return 2;
+    }
+
+    int rc = 0;
+
+    for (const bool batched : { true, false })
+    {
+        if (batched ? !options.batched : !options.asio)
+            continue;
+
+        const char* backend = batched ? "batched" : "asio";
+        Result result;
+
+        if (options.send)
+        {
+            if (RunSend(options, batched, result))
+                Print("send", backend, options, result);
+            else
+                rc = 1;
+        }
+
+        result = Result{};
+
+        if (options.receive)
+        {
+            if (RunReceive(options, batched, result))
+                Print("receive", backend, options, result);
+            else
+                rc = 1;
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <shared/crypto.hpp>
+
+// cef-sessionbench: KCP messages sealed and opened per second on one core, SessionCipher
+// (counter nonce, ChaCha20-Poly1305-IETF, in place) against the EncryptPacket and
+// DecryptPacket it replaced (random nonce, secretbox, a vector per call). Sizes are a small
+// event, a typical batch and a full batch (batch_max_bytes).
+
+namespace
+{
+    // EncryptPacket and DecryptPacket as they were, kept here for comparison only.
+    std::vector<uint8_t> LegacyEncryptPacket(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key)
+    {
+        std::vector<uint8_t> nonce(crypto_secretbox_NONCEBYTES);
+        randombytes_buf(nonce.data(), nonce.size());
+
+        std::vector<uint8_t> ciphertext(plaintext.size() + crypto_secretbox_MACBYTES);
+
+        crypto_secretbox_easy(ciphertext.data(), plaintext.data(), plaintext.size(), nonce.data(), key.data());
+
+        std::vector<uint8_t> result;
+        result.reserve(nonce.size() + ciphertext.size());
+        result.insert(result.end(), nonce.begin(), nonce.end());
+        result.insert(result.end(), ciphertext.begin(), ciphertext.end());
+
+        return result;
+    }
+
+    std::vector<uint8_t> LegacyDecryptPacket(const std::vector<uint8_t>& ciphertext_with_nonce, const std::vector<uint8_t>& key)
+    {
+        if (ciphertext_with_nonce.size() < crypto_secretbox_NONCEBYTES + crypto_secretbox_MACBYTES)
+            return {};
+
+        const uint8_t* nonce = ciphertext_with_nonce.data();
+        const uint8_t* ciphertext = ciphertext_with_nonce.data() + crypto_secretbox_NONCEBYTES;
+        const size_t ciphertext_len = ciphertext_with_nonce.size() - crypto_secretbox_NONCEBYTES;
+
+        std::vector<uint8_t> decrypted(ciphertext_len - crypto_secretbox_MACBYTES);
+
+        if (crypto_secretbox_open_easy(decrypted.data(), ciphertext, ciphertext_len, nonce, key.data()) != 0)
+            return {};
+
+        return decrypted;
+    }
+
+    double Seconds(std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    }
+
+    // Seal on one side, copy into a receive buffer (as ikcp_recv does), open on the other.
+    bool RunSessionCipher(size_t size, size_t messages, double& seconds)
+    {
+        const std::vector<uint8_t> a(SESSION_KEY_BYTES, 1), b(SESSION_KEY_BYTES, 2);
+
+        SessionCipher sender, receiver;
+        sender.Init(a, b);
+        receiver.Init(b, a);
+
+        const std::vector<uint8_t> plaintext(size, 0x5a);
+        std::vector<uint8_t> sealed(size + SESSION_OVERHEAD), received(sealed.size());
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < messages; ++i)
+        {
+            size_t plaintext_size = 0;
+
+            if (!sender.Seal(plaintext.data(), plaintext.size(), sealed.data()))
+                return false;
+
+            std::memcpy(received.data(), sealed.data(), sealed.size());
+
+            if (!receiver.Open(received.data(), received.size(), plaintext_size) || plaintext_size != size)
+                return false;
+        }
+
+        seconds = Seconds(start);
+        return true;
+    }
+
+    bool RunLegacy(size_t size, size_t messages, double& seconds)
+    {
+        const std::vector<uint8_t> key(crypto_secretbox_KEYBYTES, 1);
+        const std::vector<uint8_t> plaintext(size, 0x5a);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < messages; ++i)
+        {
+            const std::vector<uint8_t> sealed = LegacyEncryptPacket(plaintext, key);
+            if (LegacyDecryptPacket(sealed, key).size() != size)
+                return false;
+        }
+
+        seconds = Seconds(start);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const size_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 300000;
+
+    if (messages == 0 || sodium_init() < 0)
+    {
+        std::fprintf(stderr, "Usage: cef-sessionbench [messages per size, default 300000]\n");
+        return 2;
+    }
+
+    std::printf("seal + open, one core, %zu messages per size\n", messages);
+    std::printf("  %6s   %-26s   %-26s\n", "size", "SessionCipher", "EncryptPacket/DecryptPacket");
+
+    for (const size_t size : { 64, 512, 1352 })
+    {
+        double session_seconds = 0, legacy_seconds = 0;
+
+        if (!RunSessionCipher(size, messages, session_seconds) || !RunLegacy(size, messages, legacy_seconds))
+        {
+            std::fprintf(stderr, "A message of %zu bytes did not round-trip.\n", size);
+            return 1;
+        }
+
+        std::printf("  %4zu B   %6.3f M msg/s %5.0f MB/s   %6.3f M msg/s %5.0f MB/s\n", size,
+            messages / session_seconds / 1e6, messages * size / session_seconds / 1e6,
+            messages / legacy_seconds / 1e6, messages * size / legacy_seconds / 1e6);
+    }
+
+    return 0;
+}
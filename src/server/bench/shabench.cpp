@@ -0,0 +1,148 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <sodium.h>
+#include <shared/sha256.hpp>
+
+#ifdef CEF_HAVE_PICOSHA2
+#include <picosha2.h>
+#endif
+
+// cef-shabench: SHA-256 throughput in GB/s on one core for the sizes that get hashed (pak
+// entries, whole paks), Sha256 with the backend it selects against the portable block
+// function, libsodium and picosha2 (the hasher it replaced, when its header is found).
+
+namespace
+{
+    using HashFunction = void (*)(const uint8_t* data, size_t size, uint8_t digest[SHA256_DIGEST_BYTES]);
+
+    void HashSelected(const uint8_t* data, size_t size, uint8_t digest[SHA256_DIGEST_BYTES])
+    {
+        Sha256::Hash(data, size, digest);
+    }
+
+    // Sha256's padding around the portable block function, whatever the CPU has.
+    void HashPortable(const uint8_t* data, size_t size, uint8_t digest[SHA256_DIGEST_BYTES])
+    {
+        uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+        const size_t blocks = size / SHA256_BLOCK_BYTES;
+        sha256_detail::BlocksPortable(state, data, blocks);
+
+        uint8_t tail[SHA256_BLOCK_BYTES * 2]{};
+        const size_t rest = size - blocks * SHA256_BLOCK_BYTES;
+        std::memcpy(tail, data + blocks * SHA256_BLOCK_BYTES, rest);
+        tail[rest] = 0x80;
+
+        const size_t tail_size = rest + 1 + 8 <= SHA256_BLOCK_BYTES ? SHA256_BLOCK_BYTES : SHA256_BLOCK_BYTES * 2;
+        const uint64_t bits = static_cast<uint64_t>(size) * 8;
+        for (int i = 0; i < 8; ++i)
+            tail[tail_size - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+
+        sha256_detail::BlocksPortable(state, tail, tail_size / SHA256_BLOCK_BYTES);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+            digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+            digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+            digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+        }
+    }
+
+    void HashSodium(const uint8_t* data, size_t size, uint8_t digest[SHA256_DIGEST_BYTES])
+    {
+        crypto_hash_sha256(digest, data, size);
+    }
+
+#ifdef CEF_HAVE_PICOSHA2
+    void HashPicosha2(const uint8_t* data, size_t size, uint8_t digest[SHA256_DIGEST_BYTES])
+    {
+        picosha2::hash256(data, data + size, digest, digest + SHA256_DIGEST_BYTES);
+    }
+#endif
+
+    struct Hasher
+    {
+        const char* name;
+        HashFunction hash;
+    };
+
+    // Hashes `data` until `min_seconds` have passed. Returns GB/s.
+    double Run(HashFunction hash, const std::vector<uint8_t>& data, double min_seconds, uint8_t digest[SHA256_DIGEST_BYTES])
+    {
+        size_t rounds = 0;
+        double seconds = 0;
+        const auto start = std::chrono::steady_clock::now();
+
+        do
+        {
+            hash(data.data(), data.size(), digest);
+            ++rounds;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while (seconds < min_seconds);
+
+        return static_cast<double>(rounds) * data.size() / seconds / 1e9;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const double min_seconds = argc > 1 ? std::strtod(argv[1], nullptr) : 0.5;
+
+    if (min_seconds <= 0 || sodium_init() < 0)
+    {
+        std::fprintf(stderr, "Usage: cef-shabench [seconds per measurement, default 0.5]\n");
+        return 2;
+    }
+
+    const Hasher hashers[] = {
+        { Sha256::Backend(), &HashSelected },
+        { "portable", &HashPortable },
+        { "libsodium", &HashSodium },
+#ifdef CEF_HAVE_PICOSHA2
+        { "picosha2", &HashPicosha2 },
+#endif
+    };
+
+    std::printf("SHA-256, one core, GB/s\n  %8s", "size");
+    for (const Hasher& hasher : hashers)
+        std::printf(" %10s", hasher.name);
+    std::printf("\n");
+
+    std::mt19937 rng(1);
+
+    for (const size_t size : { 4096, 65536, 1024 * 1024, 64 * 1024 * 1024 })
+    {
+        std::vector<uint8_t> data(size);
+        for (auto& byte : data)
+            byte = static_cast<uint8_t>(rng());
+
+        uint8_t expected[SHA256_DIGEST_BYTES];
+        HashSodium(data.data(), data.size(), expected);
+
+        std::printf("  %5zu KB", size / 1024);
+
+        for (const Hasher& hasher : hashers)
+        {
+            uint8_t digest[SHA256_DIGEST_BYTES];
+            const double rate = Run(hasher.hash, data, min_seconds, digest);
+
+            if (std::memcmp(digest, expected, sizeof(digest)) != 0)
+            {
+                std::printf("\n%s: wrong digest for %zu bytes\n", hasher.name, size);
+                return 1;
+            }
+
+            std::printf(" %10.2f", rate);
+        }
+
+        std::printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sodium.h>
+
+#include "common/bridge.hpp"
+#include "common/logger.hpp"
+#include "common/resource_manager.hpp"
+
+// cef-startupbench: server startup cost of one large resource. Generates a synthetic tree
+// (10000 files by default: scripts, stylesheets, JSON and images, 1-64 KB) and times
+// AddResource cold (no pak), warm (nothing changed), after editing one file, and warm
+// again, each with a fresh ResourceManager like a server restart.
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    class ConsoleBridge final : public IPlatformBridge
+    {
+    public:
+        void LogInfo(const std::string&) override {}
+        void LogWarn(const std::string& message) override { std::fprintf(stderr, "[WARN] %s\n", message.c_str()); }
+        void LogError(const std::string& message) override { std::fprintf(stderr, "[ERROR] %s\n", message.c_str()); }
+        void LogDebug(const std::string&) override {}
+
+        void CallPawnPublic(const std::string&, const std::vector<Argument>&) override {}
+        void CallOnBrowserCreated(int, int, bool, int, const std::string&) override {}
+
+        std::string GetPlayerAddressIp(int) override { return {}; }
+        void KickPlayer(int) override {}
+    };
+
+    struct Options
+    {
+        size_t files = 10000;
+        size_t jobs = 0;
+        std::string directory;
+        bool keep = false;
+    };
+
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage: cef-startupbench [options]\n"
+            "\n"
+            "Options:\n"
+            "  -n, --files <n>        Files in the generated resource (default: 10000)\n"
+            "  -j, --jobs <n>         Packing threads (default: one per hardware thread)\n"
+            "  -d, --dir <path>       Where to generate it (default: a temporary directory)\n"
+            "      --keep             Keep the generated tree and pak\n"
+            "  -h, --help             Show this help\n");
+    }
+
+    // Text compresses like real scripts and stylesheets, images do not compress at all.
+    void WriteFile(const fs::path& path, size_t size, bool text, std::mt19937& rng)
+    {
+        static const char WORDS[] = "function return const let var if else for while document window style class ";
+
+        std::string content(size, ' ');
+
+        for (auto& c : content)
+            c = text ? WORDS[rng() % (sizeof(WORDS) - 1)] : static_cast<char>(rng());
+
+        std::ofstream(path, std::ios::binary).write(content.data(), content.size());
+    }
+
+    uint64_t Generate(const fs::path& resource, size_t files)
+    {
+        static const char* const EXTENSIONS[] = { ".js", ".css", ".json", ".html", ".png" };
+
+        std::mt19937 rng(1);
+        uint64_t bytes = 0;
+
+        for (size_t i = 0; i < files; ++i)
+        {
+            // 100 files per directory, a few levels deep like bundled front-ends.
+            const fs::path directory = resource / ("module" + std::to_string(i / 1000)) / ("part" + std::to_string(i / 100 % 10));
+            if (i % 100 == 0)
+                fs::create_directories(directory);
+
+            const char* extension = EXTENSIONS[i % 5];
+            const size_t size = 1024 + rng() % (63 * 1024);
+
+            WriteFile(directory / ("file" + std::to_string(i) + extension), size, i % 5 != 4, rng);
+            bytes += size;
+        }
+
+        return bytes;
+    }
+
+    bool Run(const char* name, const Options& options, const fs::path& root, const std::vector<uint8_t>& key)
+    {
+        ResourceManager manager(options.jobs);
+        manager.SetIndexedPak(true);
+        manager.SetResourceDirectories((root / "source").string(), (root / "out").string());
+
+        PackStats stats;
+        const auto start = std::chrono::steady_clock::now();
+        const bool ok = manager.AddResource("bench", key, &stats);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!ok)
+        {
+            std::fprintf(stderr, "%s: AddResource failed\n", name);
+            return false;
+        }
+
+        const auto pak = manager.GetPak("bench");
+
+        std::printf("  %-10s %9.1f ms  pak %.1f MB, ", name, ms, pak ? static_cast<double>(pak->Size()) / 1e6 : 0.0);
+
+        if (stats.up_to_date)
+            std::printf("up to date\n");
+        else
+            std::printf("%zu of %zu files reused from the previous pak\n", stats.reused_files, stats.files.size());
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> const char* {
+            if (i + 1 >= argc)
+            {
+                std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-n" || arg == "--files")
+            options.files = std::strtoull(value(), nullptr, 10);
+        else if (arg == "-j" || arg == "--jobs")
+            options.jobs = std::strtoull(value(), nullptr, 10);
+        else if (arg == "-d" || arg == "--dir")
+            options.directory = value();
+        else if (arg == "--keep")
+            options.keep = true;
+        else if (arg == "-h" || arg == "--help")
+        {
+            PrintUsage();
+            return 0;
+        }
+        else
+        {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    if (options.files == 0 || sodium_init() < 0)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    ConsoleBridge bridge;
+    Logger logger(CefLogLevel::Warn);
+    logger.SetBridge(&bridge);
+    logging::SetLogger(&logger);
+
+    const fs::path root = options.directory.empty()
+        ? fs::temp_directory_path() / ("cef-startupbench-" + std::to_string(std::random_device{}()))
+        : fs::path(options.directory);
+
+    const fs::path resource = root / "source" / "bench";
+    fs::create_directories(resource);
+    fs::create_directories(root / "out");
+
+    const uint64_t bytes = Generate(resource, options.files);
+    std::printf("%zu files, %.1f MB in %s\n", options.files, static_cast<double>(bytes) / 1e6, resource.string().c_str());
+
+    std::vector<uint8_t> key(32);
+    randombytes_buf(key.data(), key.size());
+
+    bool ok = Run("cold", options, root, key) && Run("warm", options, root, key);
+
+    if (ok)
+    {
+        // One edit, as in development: new content and a new mtime.
+        std::mt19937 rng(2);
+        const fs::path edited = resource / "module0" / "part0" / "file0.js";
+        WriteFile(edited, static_cast<size_t>(fs::file_size(edited)) + 100, true, rng);
+        fs::last_write_time(edited, fs::last_write_time(edited) + std::chrono::seconds(2));
+
+        ok = Run("one edit", options, root, key) && Run("warm", options, root, key);
+    }
+
+    if (!options.keep)
+    {
+        std::error_code ec;
+        fs::remove_all(options.directory.empty() ? root : resource, ec);
+        fs::remove_all(root / "out", ec);
+    }
+
+    logging::SetLogger(nullptr);
+    return ok ? 0 : 1;
+}
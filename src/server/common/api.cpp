@@ -22,10 +22,12 @@ bool CefApi::PlayerHasPlugin(int playerid)
 
 void CefApi::AddResource(const std::string& resourceName)
 {
-    plugin_.GetResourceManager().AddResource(
-        resourceName,
-        plugin_.GetMasterKey()
-    );
+    plugin_.AddResource(resourceName);
+}
+
+bool CefApi::IsResourceReady(const std::string& resourceName)
+{
+    return plugin_.IsResourceReady(resourceName);
 }
 
 // native CEF_CreateBrowser(playerid, browserid, const url[], bool:focused, bool:controls_chat = true, Float:width = 0.0, Float:height = 0.0);
@@ -33,7 +35,7 @@ void CefApi::CreateBrowser(int playerid, int browserid, const std::string& url,
 {
     EmitEventPacket event;
 
-    event.name = CefEvent::Server::CreateBrowser;
+    event.eventId = CefEvent::Server::CreateBrowser.id;
     event.args.emplace_back(browserid);
     event.args.emplace_back(url);
     event.args.emplace_back(focused);
@@ -47,7 +49,7 @@ void CefApi::CreateWorldBrowser(int playerid, int browserid, const std::string&
 {
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::CreateWorldBrowser;
+	event.eventId = CefEvent::Server::CreateWorldBrowser.id;
 	event.args.emplace_back(browserid);
 	event.args.emplace_back(std::string(url));
 	event.args.emplace_back(std::string(textureName));
@@ -61,7 +63,7 @@ void CefApi::DestroyBrowser(int playerid, int browserid)
 {
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::DestroyBrowser;
+	event.eventId = CefEvent::Server::DestroyBrowser.id;
 	event.args.emplace_back(browserid);
 
 	plugin_.SendPacketToPlayer(playerid, PacketType::EmitEvent, event);
@@ -79,9 +81,12 @@ void CefApi::EmitEvent(int playerid, int browserid, const std::string& name, con
 	EmitEventPacket event;
 
 	event.browserId = browserid;
-	event.name = std::string(name);
+	event.eventId = plugin_.InternEvent(name);
 	event.args = args;
 
+	if (event.eventId == CefEvent::InvalidId)
+		event.name = name;
+
 	plugin_.SendPacketToPlayer(playerid, PacketType::EmitBrowserEvent, event);
 }
 
@@ -91,7 +96,7 @@ void CefApi::ReloadBrowser(int playerid, int browserid, bool ignoreCache)
 
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::ReloadBrowser;
+	event.eventId = CefEvent::Server::ReloadBrowser.id;
 	event.args.emplace_back(browserid);
 	event.args.emplace_back(ignoreCache);
 
@@ -104,7 +109,7 @@ void CefApi::FocusBrowser(int playerid, int browserid, bool focused)
 
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::FocusBrowser;
+	event.eventId = CefEvent::Server::FocusBrowser.id;
 	event.args.emplace_back(browserid);
 	event.args.emplace_back(focused);
 
@@ -117,7 +122,7 @@ void CefApi::EnableDevTools(int playerid, int browserid, bool enabled)
 
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::EnableDevTools;
+	event.eventId = CefEvent::Server::EnableDevTools.id;
 	event.args.emplace_back(browserid);
 	event.args.emplace_back(enabled);
 
@@ -128,7 +133,7 @@ void CefApi::AttachBrowserToObject(int playerid, int browserid, int objectId)
 {
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::AttachBrowserToObject;
+	event.eventId = CefEvent::Server::AttachBrowserToObject.id;
 	event.args.emplace_back(browserid);
 	event.args.emplace_back(objectId);
 
@@ -139,7 +144,7 @@ void CefApi::DetachBrowserFromObject(int playerid, int browserid, int objectid)
 {
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::DetachBrowserFromObject;
+	event.eventId = CefEvent::Server::DetachBrowserFromObject.id;
 	event.args.emplace_back(browserid);
 	event.args.emplace_back(objectid);
 
@@ -152,7 +157,7 @@ void CefApi::SetBrowserMuted(int playerid, int browserid, bool muted)
 
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::MuteBrowser;
+	event.eventId = CefEvent::Server::MuteBrowser.id;
 	event.args.emplace_back(browserid);
 	event.args.emplace_back(muted);
 
@@ -168,7 +173,7 @@ void CefApi::SetBrowserAudioMode(int playerid, int browserid, int mode)
 
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::SetAudioMode;
+	event.eventId = CefEvent::Server::SetAudioMode.id;
 	event.args.emplace_back(browserid);
 	event.args.emplace_back(mode);
 
@@ -179,7 +184,7 @@ void CefApi::SetBrowserAudioSettings(int playerid, int browserid, float maxDista
 {
 	EmitEventPacket event;
 
-	event.name = CefEvent::Server::SetAudioSettings;
+	event.eventId = CefEvent::Server::SetAudioSettings.id;
 	event.args.emplace_back(browserid);
 	event.args.emplace_back(maxDistance);
 	event.args.emplace_back(referenceDistance);
@@ -192,7 +197,7 @@ void CefApi::ToggleHudComponent(int playerid, int componentid, bool toggle)
 	LOG_DEBUG("ToggleHudComponent: playerid=%d, componentid=%d, toggle=%d", playerid, componentid, toggle);
 
 	EmitEventPacket event;
-	event.name = CefEvent::Server::ToggleHudComponent;
+	event.eventId = CefEvent::Server::ToggleHudComponent.id;
 
 	event.args.emplace_back(componentid);
 	event.args.emplace_back(toggle);
@@ -205,7 +210,7 @@ void CefApi::ToggleSpawnScreen(int playerid, bool toggle)
 	LOG_DEBUG("ToggleSpawnScreen: playerid=%d, toggle=%d", playerid, toggle);
 
 	EmitEventPacket event;
-	event.name = CefEvent::Server::ToggleSpawnScreen;
+	event.eventId = CefEvent::Server::ToggleSpawnScreen.id;
 	event.args.emplace_back(toggle);
 
 	plugin_.SendPacketToPlayer(playerid, PacketType::EmitEvent, event);
@@ -19,6 +19,7 @@ public:
 
     bool PlayerHasPlugin(int playerid);
     void AddResource(const std::string& resourceName);
+    bool IsResourceReady(const std::string& resourceName);
     void CreateBrowser(int playerid, int browserid, const std::string& url, bool focused, bool controls_chat);
     void CreateWorldBrowser(int playerid, int browserid, const std::string& url, const std::string& textureName, float width, float height);
     void DestroyBrowser(int playerid, int browserid);
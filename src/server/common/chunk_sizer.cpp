@@ -0,0 +1,80 @@
+#include "chunk_sizer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+void ChunkSizer::Reset(uint32_t mss, uint32_t message_overhead)
+{
+    mss_ = mss;
+    message_overhead_ = message_overhead;
+    segments_ = MIN_SEGMENTS;
+    loss_permille_ = 0;
+    sampling_ = false;
+}
+
+bool ChunkSizer::Observe(uint32_t segments_sent, uint32_t retransmits, uint64_t local_drops)
+{
+    if (!sampling_) {
+        sample_sent_ = segments_sent;
+        sample_retransmits_ = retransmits;
+        sample_local_drops_ = local_drops;
+        sampling_ = true;
+        return false;
+    }
+
+    // Both counters wrap, only their differences are meaningful.
+    const uint32_t sent = segments_sent - sample_sent_;
+    if (sent < SAMPLE_SEGMENTS)
+        return false;
+
+    // Datagrams dropped before the socket come back as retransmissions.
+    const uint32_t retransmitted = retransmits - sample_retransmits_;
+    const uint64_t dropped = local_drops - sample_local_drops_;
+    const uint32_t resent = retransmitted - static_cast<uint32_t>(std::min<uint64_t>(dropped, retransmitted));
+    loss_permille_ = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(resent) * 1000 / sent, 1000));
+
+    sample_sent_ = segments_sent;
+    sample_retransmits_ = retransmits;
+    sample_local_drops_ = local_drops;
+
+    const uint32_t previous = segments_;
+
+    if (loss_permille_ < GROW_BELOW_PERMILLE)
+        segments_ = std::min(segments_ * 2, MAX_SEGMENTS);
+    else if (loss_permille_ > SHRINK_ABOVE_PERMILLE)
+        segments_ = std::max(segments_ / 2, MIN_SEGMENTS);
+
+    return segments_ != previous;
+}
+
+size_t ChunkSizer::ChunkBytes() const
+{
+    const size_t message = static_cast<size_t>(segments_) * mss_;
+
+    // Never below something useful, even with a tiny mss.
+    return message > message_overhead_ + 256 ? message - message_overhead_ : 256;
+}
+
+uint32_t RetransmitCounter::OnOutput(const char* buf, int len)
+{
+    uint32_t segments = 0;
+
+    // Segment headers are little-endian; cmd at offset 4, sn at 12, payload length at 20.
+    for (int offset = 0; offset + SEGMENT_HEADER_SIZE <= len; ++segments) {
+        uint32_t sn = 0, seg_len = 0;
+        std::memcpy(&sn, buf + offset + 12, sizeof(sn));
+        std::memcpy(&seg_len, buf + offset + 20, sizeof(seg_len));
+
+        if (static_cast<uint8_t>(buf[offset + 4]) == CMD_PUSH) {
+            // Fresh segments go out in sn order, the counter wraps.
+            if (static_cast<int32_t>(sn - next_sn_) < 0)
+                ++retransmits_;
+            else
+                next_sn_ = sn + 1;
+        }
+
+        offset += SEGMENT_HEADER_SIZE + static_cast<int>(seg_len);
+    }
+
+    return segments;
+}
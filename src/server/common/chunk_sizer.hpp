@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Size of the file chunks sent to one session, in whole KCP segments. Starts at one
+// segment, doubles after every sample with almost no retransmissions (larger chunks are
+// fragmented by KCP, fewer messages to seal, frame and decode) and halves once the loss
+// rate climbs, so a chunk waiting on retransmissions holds back less of the stream.
+// Not thread-safe, network thread only.
+class ChunkSizer
+{
+public:
+    static constexpr uint32_t MIN_SEGMENTS = 1;
+    // Well below the client's 128 segment receive window, a message must fit in it.
+    static constexpr uint32_t MAX_SEGMENTS = 32;
+    // Fresh segments sent between two decisions, fewer give a noisy loss rate.
+    static constexpr uint32_t SAMPLE_SEGMENTS = 128;
+    // Retransmissions per thousand fresh segments, see RetransmitCounter. Lost acks and
+    // spurious fast resends count too, so this runs several times above the packet loss
+    // rate: in cef-chunksim 300 is crossed around 2% loss at 40 ms RTT and 10% on a LAN,
+    // below that larger chunks cost no throughput and save most messages.
+    static constexpr uint32_t GROW_BELOW_PERMILLE = 100;
+    static constexpr uint32_t SHRINK_ABOVE_PERMILLE = 300;
+
+    // `mss` is the KCP segment payload, `message_overhead` what a chunk message adds to
+    // the chunk data (encryption, framing and packet header).
+    void Reset(uint32_t mss, uint32_t message_overhead);
+
+    // Takes running counters: KCP's snd_nxt (fresh segments), the session's
+    // RetransmitCounter and the server's count of datagrams it dropped itself (send pool exhausted, refused by
+    // the socket). Those are taken off the sample's retransmissions, they say nothing about
+    // the path. The count covers every session, so one session may be credited another's
+    // drops. Returns true when the chunk size changed.
+    bool Observe(uint32_t segments_sent, uint32_t retransmits, uint64_t local_drops);
+
+    size_t ChunkBytes() const;
+    uint32_t Segments() const { return segments_; }
+    uint32_t LossPermille() const { return loss_permille_; }
+
+private:
+    uint32_t mss_ = 0;
+    uint32_t message_overhead_ = 0;
+    uint32_t segments_ = MIN_SEGMENTS;
+    uint32_t loss_permille_ = 0;
+
+    bool sampling_ = false;
+    uint32_t sample_sent_ = 0;
+    uint32_t sample_retransmits_ = 0;
+    uint64_t sample_local_drops_ = 0;
+};
+
+// Counts the data segments KCP sends again, from the datagrams it outputs. ikcpcb::xmit
+// only counts RTO timeouts, while with fast resend most losses are repaired before one, so
+// it says little about the path. A PUSH segment numbered below the next fresh one is a
+// retransmission. Fed by the output callback, under the session's kcp_mutex.
+class RetransmitCounter
+{
+public:
+    // ikcp.c does not export IKCP_OVERHEAD: conv, cmd, frg, wnd, ts, sn, una, len.
+    static constexpr int SEGMENT_HEADER_SIZE = 24;
+    static constexpr uint8_t CMD_PUSH = 81;
+
+    void Reset() { next_sn_ = 0; retransmits_ = 0; }
+
+    // Returns the number of segments in the datagram.
+    uint32_t OnOutput(const char* buf, int len);
+
+    uint32_t Retransmits() const { return retransmits_; }
+
+private:
+    uint32_t next_sn_ = 0;
+    uint32_t retransmits_ = 0;
+};
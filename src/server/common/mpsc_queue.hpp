@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+// Unbounded multi-producer / single-consumer queue (Vyukov). Push is wait-free and
+// callable from any thread, TryPop must only be called from the one consumer thread.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+    {
+        Node* stub = new Node();
+        head_.store(stub, std::memory_order_relaxed);
+        tail_ = stub;
+    }
+
+    ~MpscQueue()
+    {
+        while (tail_) {
+            Node* next = tail_->next.load(std::memory_order_relaxed);
+            delete tail_;
+            tail_ = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void Push(T value)
+    {
+        Node* node = new Node();
+        node->value.emplace(std::move(value));
+
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // False when empty, or when a producer is between its exchange and its link; the
+    // item then shows up on a later call.
+    bool TryPop(T& out)
+    {
+        Node* next = tail_->next.load(std::memory_order_acquire);
+        if (!next)
+            return false;
+
+        out = std::move(*next->value);
+        next->value.reset();
+
+        delete tail_;
+        tail_ = next;
+
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{ nullptr };
+        std::optional<T> value;
+    };
+
+    std::atomic<Node*> head_;
+    Node* tail_;
+};
@@ -11,6 +11,11 @@ PAWN_NATIVE(Natives, CEF_AddResource, void(const std::string& resourceName))
     CefApi::Instance()->AddResource(resourceName);
 }
 
+PAWN_NATIVE(Natives, CEF_IsResourceReady, bool(const std::string& resourceName))
+{
+    return CefApi::Instance()->IsResourceReady(resourceName);
+}
+
 PAWN_NATIVE(Natives, CEF_CreateBrowser, void(int playerid, int browserid, const std::string& url, bool focused, bool controls_chat))
 {
     CefApi::Instance()->CreateBrowser(playerid, browserid, url, focused, controls_chat);
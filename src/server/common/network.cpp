@@ -3,16 +3,190 @@
 
 #include <shared/utils.hpp>
 
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__)
+#include <array>
+#include <cerrno>
+
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+// recvmmsg/sendmmsg backend. Received datagrams are drained in batches after a single
+// readiness wait, outgoing ones are queued and written by one sendmmsg per io_context
+// turn (so everything a KCP tick produces goes out together). Consecutive equal-sized
+// datagrams to the same peer are sent as one UDP GSO message when the kernel allows it.
+// When the socket buffer is full the unsent tail keeps its buffers and waits for the
+// socket to become writable, so a stalled socket fills the send pool (and backs off bulk
+// senders through IsSendBacklogged) instead of silently dropping datagrams.
+struct NetworkServer::BatchedIo
+{
+    static constexpr size_t BATCH_SIZE = 64;
+    static constexpr size_t MAX_ROUNDS_PER_WAKEUP = 8;
+
+    // KCP datagrams are bounded by its mtu (1400), handshake packets are smaller.
+    // Anything larger is truncated by the kernel and dropped.
+    static constexpr size_t SLOT_SIZE = 2048;
+
+    static constexpr size_t MAX_GSO_SEGMENTS = 64;
+    static constexpr size_t MAX_GSO_BYTES = 65000;
+
+    struct Datagram
+    {
+        sockaddr_storage addr;
+        socklen_t addr_len;
+        uint16_t size;
+        char* buffer; // owned by send_pool_ until the flush releases it
+    };
+
+    std::array<std::array<char, SLOT_SIZE>, BATCH_SIZE> recv_slots;
+    std::array<sockaddr_storage, BATCH_SIZE> recv_addrs;
+    std::array<iovec, BATCH_SIZE> recv_iovs;
+    std::array<mmsghdr, BATCH_SIZE> recv_msgs;
+
+    // pending is filled by SendTo on any thread, swapped into sending on the network thread.
+    // Both only grow to the largest burst seen (bounded by the send pool) and are then reused.
+    // flush_posted stays set while a flush waits on the socket, SendTo then only queues.
+    std::mutex send_mutex;
+    std::vector<Datagram> pending;
+    size_t pending_count = 0;
+    bool flush_posted = false;
+
+    // sending[sending_next, sending_count) is still to be written, network thread only.
+    std::vector<Datagram> sending;
+    size_t sending_next = 0;
+    size_t sending_count = 0;
+    asio::steady_timer retry_timer; // ENOBUFS: the socket is writable but the device queue is full
+    std::vector<mmsghdr> send_msgs;
+    std::vector<iovec> send_iovs;
+    std::vector<std::array<char, CMSG_SPACE(sizeof(uint16_t))>> send_cmsgs;
+
+    std::atomic<bool> send{ true };
+    bool gso = false;
+
+    explicit BatchedIo(asio::io_context& context)
+        : retry_timer(context)
+    {
+    }
+
+    // Returns the buffers of sending[sending_next, end) to the pool.
+    void ReleaseSending(SendBufferPool& pool, size_t end)
+    {
+        for (; sending_next < end; ++sending_next)
+            pool.Release(sending[sending_next].buffer);
+    }
+};
+
+static bool SameDestination(const sockaddr_storage& a, socklen_t a_len, const sockaddr_storage& b, socklen_t b_len)
+{
+    return a_len == b_len && std::memcmp(&a, &b, a_len) == 0;
+}
+#else
+struct NetworkServer::BatchedIo {};
+#endif
+
+SendBufferPool::SendBufferPool(size_t capacity)
+    : storage_(capacity * BUFFER_SIZE)
+{
+    free_.reserve(capacity);
+
+    for (size_t i = capacity; i > 0; --i)
+        free_.push_back(storage_.data() + (i - 1) * BUFFER_SIZE);
+}
+
+char* SendBufferPool::Acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (free_.empty()) {
+        ++exhausted_;
+        return nullptr;
+    }
+
+    char* buffer = free_.back();
+    free_.pop_back();
+
+    high_water_ = std::max(high_water_, storage_.size() / BUFFER_SIZE - free_.size());
+    return buffer;
+}
+
+void SendBufferPool::Release(char* buffer)
+{
+    if (!buffer)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(buffer);
+}
+
+bool SendBufferPool::IsBacklogged() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Keep the last quarter for latency-sensitive traffic.
+    return free_.size() * 4 < storage_.size() / BUFFER_SIZE;
+}
+
+void SendBufferPool::CountOversized()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++oversized_;
+}
+
+void SendBufferPool::CountDropped(size_t datagrams)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    dropped_ += datagrams;
+}
+
+SendPoolStats SendBufferPool::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    SendPoolStats stats;
+    stats.capacity = storage_.size() / BUFFER_SIZE;
+    stats.in_use = stats.capacity - free_.size();
+    stats.high_water = high_water_;
+    stats.exhausted = exhausted_;
+    stats.oversized = oversized_;
+    stats.dropped = dropped_;
+    return stats;
+}
+
 NetworkServer::NetworkServer(unsigned short port,
                              asio::io_context& context,
                              PacketHandler handler,
-                             KcpTickHandler kcp_tick_handler)
-    : handler_(std::move(handler)),
+                             KcpTickHandler kcp_tick_handler,
+                             bool batched_io,
+                             size_t send_buffers)
+    : send_pool_(send_buffers),
+      handler_(std::move(handler)),
       kcp_tick_handler_(std::move(kcp_tick_handler)),
       io_context_(context),
       socket_(io_context_, asio::ip::udp::endpoint(asio::ip::udp::v4(), port)),
       kcp_update_timer_(context)
 {
+#if defined(__linux__)
+    if (batched_io)
+    {
+        batched_io_ = std::make_unique<BatchedIo>(io_context_);
+
+        int gso_size = 0;
+        socklen_t gso_len = sizeof(gso_size);
+        batched_io_->gso = getsockopt(socket_.native_handle(), IPPROTO_UDP, UDP_SEGMENT, &gso_size, &gso_len) == 0;
+
+        LOG_INFO("[Network] Using recvmmsg/sendmmsg backend (UDP GSO %s).", batched_io_->gso ? "enabled" : "unavailable");
+    }
+#else
+    (void)batched_io;
+#endif
 }
 
 NetworkServer::~NetworkServer()
@@ -27,7 +201,11 @@ void NetworkServer::Start()
 
     running_ = true;
 
-    DoReceive();
+    if (batched_io_)
+        DoReceiveBatched();
+    else
+        DoReceive();
+
     DoKcpUpdate();
 }
 
@@ -41,6 +219,11 @@ void NetworkServer::Stop()
 
     kcp_update_timer_.cancel();
 
+#if defined(__linux__)
+    if (batched_io_)
+        batched_io_->retry_timer.cancel();
+#endif
+
     error_code.clear();
     socket_.cancel(error_code);
     socket_.close(error_code);
@@ -51,13 +234,82 @@ void NetworkServer::SendTo(const asio::ip::udp::endpoint& addr, const char* data
     if (!running_)
         return;
 
+    if (length <= 0)
+        return;
+
+    // Handshake replies carrying the manifest can exceed the MTU, they are rare enough
+    // to keep the old heap-allocated path.
+    if (static_cast<size_t>(length) > SendBufferPool::BUFFER_SIZE)
+    {
+        send_pool_.CountOversized();
+        SendUnpooledAsync(addr, data, length);
+        return;
+    }
+
+    char* buffer = send_pool_.Acquire();
+    if (!buffer)
+        return;
+
+    std::memcpy(buffer, data, static_cast<size_t>(length));
+
+#if defined(__linux__)
+    if (batched_io_ && batched_io_->send.load(std::memory_order_relaxed))
+    {
+        auto& io = *batched_io_;
+        bool post_flush = false;
+
+        {
+            std::lock_guard<std::mutex> lock(io.send_mutex);
+
+            if (io.pending_count == io.pending.size())
+                io.pending.emplace_back();
+
+            auto& datagram = io.pending[io.pending_count++];
+            datagram.addr_len = static_cast<socklen_t>(addr.size());
+            std::memcpy(&datagram.addr, addr.data(), addr.size());
+            datagram.size = static_cast<uint16_t>(length);
+            datagram.buffer = buffer;
+
+            post_flush = !io.flush_posted;
+            io.flush_posted = true;
+        }
+
+        if (post_flush)
+            asio::post(io_context_, [this]() { FlushSendBatch(); });
+
+        return;
+    }
+#endif
+
+    SendPooledAsync(addr, buffer, length);
+}
+
+void NetworkServer::SendPooledAsync(const asio::ip::udp::endpoint& addr, char* buffer, int length)
+{
+    socket_.async_send_to(asio::buffer(buffer, static_cast<size_t>(length)),
+        addr,
+        [this, buffer](std::error_code ec, std::size_t)
+        {
+            send_pool_.Release(buffer);
+
+            if (ec && ec != asio::error::operation_aborted)
+            {
+                send_pool_.CountDropped(1);
+                LOG_ERROR("[Network] Async send error: %s", ec.message().c_str());
+            }
+        });
+}
+
+void NetworkServer::SendUnpooledAsync(const asio::ip::udp::endpoint& addr, const char* data, int length)
+{
     auto send_buffer = std::make_shared<std::vector<char>>(data, data + length);
     socket_.async_send_to(asio::buffer(*send_buffer),
         addr,
-        [send_buffer](std::error_code ec, std::size_t)
+        [this, send_buffer](std::error_code ec, std::size_t)
         {
             if (ec && ec != asio::error::operation_aborted)
             {
+                send_pool_.CountDropped(1);
                 LOG_ERROR("[Network] Async send error: %s", ec.message().c_str());
             }
         });
@@ -112,3 +364,310 @@ void NetworkServer::DoKcpUpdate()
             }
         });
 }
+
+#if defined(__linux__)
+void NetworkServer::DoReceiveBatched()
+{
+    socket_.async_wait(asio::ip::udp::socket::wait_read,
+        [this](std::error_code ec)
+        {
+            if (!running_ || ec == asio::error::operation_aborted)
+                return;
+
+            if (!ec && !DrainSocket())
+            {
+                LOG_WARN("[Network] recvmmsg unavailable, falling back to async_receive_from.");
+                DoReceive();
+                return;
+            }
+
+            DoReceiveBatched();
+        });
+}
+
+bool NetworkServer::DrainSocket()
+{
+    auto& io = *batched_io_;
+    const int fd = socket_.native_handle();
+
+    for (size_t round = 0; round < BatchedIo::MAX_ROUNDS_PER_WAKEUP && running_; ++round)
+    {
+        for (size_t i = 0; i < BatchedIo::BATCH_SIZE; ++i)
+        {
+            io.recv_iovs[i].iov_base = io.recv_slots[i].data();
+            io.recv_iovs[i].iov_len = BatchedIo::SLOT_SIZE;
+
+            auto& header = io.recv_msgs[i].msg_hdr;
+            std::memset(&header, 0, sizeof(header));
+            header.msg_name = &io.recv_addrs[i];
+            header.msg_namelen = sizeof(sockaddr_storage);
+            header.msg_iov = &io.recv_iovs[i];
+            header.msg_iovlen = 1;
+        }
+
+        const int received = recvmmsg(fd, io.recv_msgs.data(), BatchedIo::BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (received < 0)
+        {
+            if (errno == ENOSYS)
+                return false;
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                LOG_ERROR("[Network] recvmmsg error: %s", std::strerror(errno));
+
+            return true;
+        }
+
+        for (int i = 0; i < received && running_; ++i)
+        {
+            const auto& header = io.recv_msgs[i].msg_hdr;
+            const unsigned int length = io.recv_msgs[i].msg_len;
+
+            if (length == 0 || (header.msg_flags & MSG_TRUNC))
+                continue;
+
+            asio::ip::udp::endpoint from;
+            std::memcpy(from.data(), &io.recv_addrs[i], header.msg_namelen);
+            from.resize(header.msg_namelen);
+
+            try {
+                handler_(from, io.recv_slots[i].data(), static_cast<int>(length));
+            }
+            catch (const std::exception& e) {
+                LOG_ERROR("[Network] handler exception: %s", e.what());
+            }
+            catch (...) {
+                LOG_ERROR("[Network] handler unknown exception");
+            }
+        }
+
+        if (static_cast<size_t>(received) < BatchedIo::BATCH_SIZE)
+            break;
+    }
+
+    return true;
+}
+
+void NetworkServer::FlushSendBatch()
+{
+    auto& io = *batched_io_;
+
+    // A tail left behind by a full socket goes out before anything queued after it.
+    if (io.sending_next == io.sending_count)
+    {
+        std::lock_guard<std::mutex> lock(io.send_mutex);
+
+        if (io.pending_count == 0)
+        {
+            io.flush_posted = false;
+            return;
+        }
+
+        // Hand the filled buffers to this flush and keep the (reused) old ones for SendTo.
+        if (io.sending.size() < io.pending.size())
+            io.sending.resize(io.pending.size());
+
+        io.pending.swap(io.sending);
+        io.sending_next = 0;
+        io.sending_count = io.pending_count;
+        io.pending_count = 0;
+    }
+
+    if (!running_)
+    {
+        io.ReleaseSending(send_pool_, io.sending_count);
+        return;
+    }
+
+    const int blocked = SendQueued();
+
+    if (blocked == EAGAIN || blocked == EWOULDBLOCK)
+    {
+        socket_.async_wait(asio::ip::udp::socket::wait_write,
+            [this](std::error_code ec)
+            {
+                if (ec && ec != asio::error::operation_aborted)
+                    LOG_ERROR("[Network] Send wait error: %s", ec.message().c_str());
+
+                FlushSendBatch();
+            });
+        return;
+    }
+
+    if (blocked == ENOBUFS)
+    {
+        io.retry_timer.expires_after(std::chrono::milliseconds(1));
+        io.retry_timer.async_wait([this](const std::error_code&) { FlushSendBatch(); });
+        return;
+    }
+
+    // All of it is out, pick up whatever SendTo queued in the meantime on the next turn.
+    bool more = false;
+    {
+        std::lock_guard<std::mutex> lock(io.send_mutex);
+        more = io.pending_count > 0;
+        io.flush_posted = more;
+    }
+
+    if (more)
+        asio::post(io_context_, [this]() { FlushSendBatch(); });
+}
+
+// Writes sending[sending_next, sending_count), releasing buffers as they go out. Returns 0
+// once nothing is left, or the errno (EAGAIN, ENOBUFS) that stopped it with the tail queued.
+int NetworkServer::SendQueued()
+{
+    auto& io = *batched_io_;
+    const size_t count = io.sending_count;
+
+    if (io.send_msgs.size() < count)
+    {
+        io.send_msgs.resize(count);
+        io.send_iovs.resize(count);
+        io.send_cmsgs.resize(count);
+    }
+
+    const int fd = socket_.native_handle();
+
+    while (io.sending_next < count)
+    {
+        const size_t next = io.sending_next;
+
+        if (!io.send.load(std::memory_order_relaxed))
+        {
+            // The asio path owns these buffers now and releases them itself.
+            for (size_t i = next; i < count; ++i)
+            {
+                asio::ip::udp::endpoint to;
+                std::memcpy(to.data(), &io.sending[i].addr, io.sending[i].addr_len);
+                to.resize(io.sending[i].addr_len);
+                SendPooledAsync(to, io.sending[i].buffer, io.sending[i].size);
+            }
+
+            io.sending_next = count;
+            return 0;
+        }
+
+        // Build one mmsghdr per destination run, coalescing equal-sized datagrams into a
+        // GSO message (the last segment of a run may be shorter).
+        size_t messages = 0;
+        size_t first_of_message[BatchedIo::BATCH_SIZE];
+
+        for (size_t index = next; index < count && messages < BatchedIo::BATCH_SIZE; ++messages)
+        {
+            const auto& first = io.sending[index];
+            size_t segments = 1;
+            size_t bytes = first.size;
+
+            if (io.gso)
+            {
+                while (index + segments < count && segments < BatchedIo::MAX_GSO_SEGMENTS)
+                {
+                    const auto& candidate = io.sending[index + segments];
+                    const auto& previous = io.sending[index + segments - 1];
+
+                    if (previous.size != first.size || candidate.size > first.size ||
+                        bytes + candidate.size > BatchedIo::MAX_GSO_BYTES ||
+                        !SameDestination(candidate.addr, candidate.addr_len, first.addr, first.addr_len))
+                        break;
+
+                    bytes += candidate.size;
+                    ++segments;
+                }
+            }
+
+            for (size_t s = 0; s < segments; ++s)
+            {
+                io.send_iovs[index + s].iov_base = io.sending[index + s].buffer;
+                io.send_iovs[index + s].iov_len = io.sending[index + s].size;
+            }
+
+            auto& header = io.send_msgs[messages].msg_hdr;
+            std::memset(&header, 0, sizeof(header));
+            header.msg_name = const_cast<sockaddr_storage*>(&first.addr);
+            header.msg_namelen = first.addr_len;
+            header.msg_iov = &io.send_iovs[index];
+            header.msg_iovlen = segments;
+
+            if (segments > 1)
+            {
+                auto& control = io.send_cmsgs[messages];
+                header.msg_control = control.data();
+                header.msg_controllen = control.size();
+
+                cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+                cmsg->cmsg_level = IPPROTO_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+                const uint16_t segment_size = first.size;
+                std::memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+            }
+
+            first_of_message[messages] = index;
+            index += segments;
+        }
+
+        const int sent = sendmmsg(fd, io.send_msgs.data(), static_cast<unsigned int>(messages), MSG_DONTWAIT);
+        if (sent < 0)
+        {
+            const int error = errno;
+
+            if (error == EINTR)
+                continue;
+
+            if (io.gso && (error == EIO || error == EINVAL) && io.send_msgs[0].msg_hdr.msg_iovlen > 1)
+            {
+                LOG_WARN("[Network] UDP GSO rejected (%s), disabling it.", std::strerror(error));
+                io.gso = false;
+                continue;
+            }
+
+            if (error == ENOSYS)
+            {
+                LOG_WARN("[Network] sendmmsg unavailable, falling back to async_send_to.");
+                io.send.store(false, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (error == EAGAIN || error == EWOULDBLOCK || error == ENOBUFS)
+                return error;
+
+            // Refused outright (unreachable peer, bad address): drop the first message
+            // only, KCP retransmits, and carry on with the rest.
+            LOG_ERROR("[Network] sendmmsg error: %s", std::strerror(error));
+
+            const size_t end = next + io.send_msgs[0].msg_hdr.msg_iovlen;
+            send_pool_.CountDropped(end - next);
+            io.ReleaseSending(send_pool_, end);
+            continue;
+        }
+
+        if (sent == 0)
+            return EAGAIN;
+
+        const size_t last = static_cast<size_t>(sent) - 1;
+        io.ReleaseSending(send_pool_, first_of_message[last] + io.send_msgs[last].msg_hdr.msg_iovlen);
+    }
+
+    return 0;
+}
+#else
+void NetworkServer::DoReceiveBatched()
+{
+    DoReceive();
+}
+
+bool NetworkServer::DrainSocket()
+{
+    return false;
+}
+
+void NetworkServer::FlushSendBatch()
+{
+}
+
+int NetworkServer::SendQueued()
+{
+    return 0;
+}
+#endif
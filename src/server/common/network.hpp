@@ -3,18 +3,66 @@
 #include <asio.hpp>
 #include <asio/steady_timer.hpp>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 using PacketHandler = std::function<void(const asio::ip::udp::endpoint&, const char*, int)>;
 
+struct SendPoolStats
+{
+    size_t capacity = 0;
+    size_t in_use = 0;
+    size_t high_water = 0;  // most buffers in use at once
+    uint64_t exhausted = 0; // datagrams dropped because every buffer was in flight
+    uint64_t oversized = 0; // datagrams too large for a pooled buffer (heap allocated)
+    uint64_t dropped = 0;   // datagrams the kernel refused to send
+};
+
+// Fixed set of MTU-sized buffers for outgoing datagrams, recycled once the send completes.
+// Never grows: when every buffer is in flight, Acquire fails and the datagram is dropped
+// (KCP retransmits it), callers are expected to check IsBacklogged and hold off bulk sends.
+// Buffers stay in flight while the socket is full, so a slow socket shows up here.
+class SendBufferPool
+{
+public:
+    // Largest UDP payload that fits a 1500 byte Ethernet frame; KCP output is bounded by its mtu (1400).
+    static constexpr size_t BUFFER_SIZE = 1472;
+
+    explicit SendBufferPool(size_t capacity);
+
+    char* Acquire();
+    void Release(char* buffer);
+
+    bool IsBacklogged() const;
+    void CountOversized();
+    void CountDropped(size_t datagrams);
+    SendPoolStats GetStats() const;
+
+private:
+    std::vector<char> storage_;
+    std::vector<char*> free_;
+    mutable std::mutex mutex_;
+
+    size_t high_water_ = 0;
+    uint64_t exhausted_ = 0;
+    uint64_t oversized_ = 0;
+    uint64_t dropped_ = 0;
+};
+
 class NetworkServer
 {
 public:
     using KcpTickHandler = std::function<void(uint32_t)>;
 
+    // `batched_io` selects the recvmmsg/sendmmsg backend on Linux; elsewhere, or if the
+    // kernel refuses it, the plain asio path is used.
     NetworkServer(unsigned short port,
                   asio::io_context& context,
                   PacketHandler handler,
-                  KcpTickHandler kcp_tick_handler);
+                  KcpTickHandler kcp_tick_handler,
+                  bool batched_io = true,
+                  size_t send_buffers = 4096);
 
     ~NetworkServer();
 
@@ -22,11 +70,28 @@ public:
     void Stop();
     void SendTo(const asio::ip::udp::endpoint& addr, const char* data, int length);
 
+    bool IsBatchedIo() const { return batched_io_ != nullptr; }
+
+    // True while most send buffers are waiting on the socket; bulk senders should back off.
+    bool IsSendBacklogged() const { return send_pool_.IsBacklogged(); }
+    SendPoolStats GetSendPoolStats() const { return send_pool_.GetStats(); }
+
 private:
     void DoReceive();
     void DoKcpUpdate();
 
+    void SendPooledAsync(const asio::ip::udp::endpoint& addr, char* buffer, int length);
+    void SendUnpooledAsync(const asio::ip::udp::endpoint& addr, const char* data, int length);
+
+    struct BatchedIo;
+    void DoReceiveBatched();
+    bool DrainSocket();
+    void FlushSendBatch();
+    int SendQueued();
+
     std::atomic<bool> running_ = false;
+    SendBufferPool send_pool_;
+    std::unique_ptr<BatchedIo> batched_io_;
 
     PacketHandler handler_;
     KcpTickHandler kcp_tick_handler_;
@@ -1,6 +1,10 @@
 ﻿#include "plugin.hpp"
 
+#include <algorithm>
+#include <chrono>
+
 #include <shared/crypto.hpp>
+#include <shared/pak-format.hpp>
 
 #include "resource_manager.hpp"
 #include "session.hpp"
@@ -24,6 +28,13 @@ void CefPlugin::Initialize(std::unique_ptr<IPlatformBridge> bridge, uint16_t lis
 
 	bridge_ = std::move(bridge);
 	master_resource_key_ = options.master_resource_key;
+	batch_max_delay_ms_ = options.batch_max_delay_ms;
+	batch_max_bytes_ = std::max<size_t>(options.batch_max_bytes, BATCH_HEADER_SIZE + BATCH_ENTRY_OVERHEAD);
+	control_flush_policy_ = options.control_flush_policy;
+	event_flush_policy_ = options.event_flush_policy;
+	transfer_flush_policy_ = options.transfer_flush_policy;
+	pawn_tick_budget_us_ = options.pawn_tick_budget_us;
+	resource_->SetIndexedPak(options.indexed_pak);
 
 	logger_.SetBridge(bridge_.get());
 	logger_.SetLevel(options.log_level);
@@ -31,6 +42,9 @@ void CefPlugin::Initialize(std::unique_ptr<IPlatformBridge> bridge, uint16_t lis
 
 	security_->Initialize(io_context_);
 
+	// After sodium_init, which detects AES-NI.
+	resource_->SetPakCipher(options.pak_aes_gcm ? PakCipher::Aes256Gcm : PakCipher::XChaCha20Poly1305);
+
     const uint16_t port = (listen_port != 0 ? listen_port : static_cast<uint16_t>(7779));
 
 	try
@@ -44,9 +58,11 @@ void CefPlugin::Initialize(std::unique_ptr<IPlatformBridge> bridge, uint16_t lis
 			},
 			[this](uint32_t now_ms)
 			{
-				sessions_->UpdateAllKcpInstances(now_ms);
+				this->UpdateKcpSessions(now_ms);
 				this->ProcessFileTransfers();
-			});
+			},
+			options.batched_udp_io,
+			std::max<size_t>(options.send_buffers, 64));
 
 		sessions_->SetSender(
 			[this](const asio::ip::udp::endpoint& addr, const char* data, int len)
@@ -86,6 +102,29 @@ void CefPlugin::Shutdown()
 
 	running_ = false;
 
+    const CefNetworkStats stats = GetNetworkStats();
+    if (stats.messages > 0) {
+        LOG_INFO("Sent %llu packets in %llu KCP messages (%.2f packets per message), %llu immediate / %llu deferred flushes.",
+            static_cast<unsigned long long>(stats.packets), static_cast<unsigned long long>(stats.messages),
+            static_cast<double>(stats.packets) / static_cast<double>(stats.messages),
+            static_cast<unsigned long long>(stats.immediate_flushes), static_cast<unsigned long long>(stats.deferred_flushes));
+        LOG_INFO("KCP wrote %llu datagrams (%llu bytes), packing saved %llu datagrams (%llu bytes).",
+            static_cast<unsigned long long>(stats.datagrams), static_cast<unsigned long long>(stats.bytes),
+            static_cast<unsigned long long>(stats.datagrams_saved), static_cast<unsigned long long>(stats.bytes_saved));
+        LOG_INFO("Send buffers: %zu, high-water %zu, %llu drops on exhaustion, %llu refused by the socket, %llu oversized datagrams.",
+            stats.send_pool.capacity, stats.send_pool.high_water,
+            static_cast<unsigned long long>(stats.send_pool.exhausted), static_cast<unsigned long long>(stats.send_pool.dropped),
+            static_cast<unsigned long long>(stats.send_pool.oversized));
+    }
+
+    const CefCallbackStats callbacks = GetCallbackStats();
+    if (callbacks.queued > 0) {
+        LOG_INFO("Pawn callbacks: %llu queued, %llu dispatched, max depth %llu, max wait %u ms, %llu ticks over budget.",
+            static_cast<unsigned long long>(callbacks.queued), static_cast<unsigned long long>(callbacks.dispatched),
+            static_cast<unsigned long long>(callbacks.max_depth), callbacks.max_wait_ms,
+            static_cast<unsigned long long>(callbacks.budget_exceeded));
+    }
+
     if (network_server_) {
         network_server_->Stop();
     }
@@ -124,6 +163,11 @@ void CefPlugin::OnPlayerClientInit(int playerid)
 		return;
 	}
 
+	WatchClientInit(playerid);
+}
+
+void CefPlugin::WatchClientInit(int playerid)
+{
 	auto timer = std::make_shared<asio::steady_timer>(io_context_);
     timer->expires_after(std::chrono::seconds(10));
     timer->async_wait([this, playerid, timer](const std::error_code& error_code) {
@@ -134,6 +178,12 @@ void CefPlugin::OnPlayerClientInit(int playerid)
         auto session = sessions_->GetSession(playerid);
         if (!session) return;
 
+        // Not the client's fault, packing large resources can take a while.
+        if (session->join_deferred) {
+            WatchClientInit(playerid);
+            return;
+        }
+
         if (!session->handshake_complete) {
             NotifyCefInitialize(session, false);
         }
@@ -154,6 +204,9 @@ void CefPlugin::OnPacketReceived(const asio::ip::udp::endpoint& from, const char
 			ikcp_input(network_session->kcp_instance, data, len);
 		}
 
+		// Acks go out on the next update.
+		sessions_->ScheduleKcpUpdate(network_session->playerid, iclock());
+
 		HandleKcpInput(network_session);
 		return;
 	}
@@ -183,6 +236,9 @@ void CefPlugin::HandleRequestJoin(const asio::ip::udp::endpoint& from, const Req
 {
     int playerid = join_packet.playerid;
 
+    if (playerid < 0 || playerid >= MAX_SESSIONS)
+        return;
+
     std::string from_ip = from.address().to_string();
     std::string official_ip = bridge_->GetPlayerAddressIp(playerid);
 
@@ -194,6 +250,23 @@ void CefPlugin::HandleRequestJoin(const asio::ip::udp::endpoint& from, const Req
         return;
     }
 
+    if (join_packet.protocol_version != PROTOCOL_VERSION)
+    {
+        LOG_ERROR("[CEF] Player %d kicked: client speaks CEF protocol %u, the server %u. Client and server must be updated together.",
+            playerid, static_cast<unsigned>(join_packet.protocol_version), static_cast<unsigned>(PROTOCOL_VERSION));
+
+        // Lets a versioned client say why, older ones just get kicked.
+        JoinResponsePacket rejection;
+        rejection.accepted = false;
+        rejection.kcp_conv_id = 0;
+        SendRawPacketToEndpoint(from, PacketType::JoinResponse, rejection);
+
+        QueuePawnCallback([playerid](IPlatformBridge& bridge) {
+            bridge.KickPlayer(playerid);
+        });
+        return;
+    }
+
 	auto session = sessions_->GetOrCreateSession(playerid);
 	session->address = from;
 	session->handshake_status = HandshakeStatus::CHALLENGED;
@@ -218,8 +291,30 @@ void CefPlugin::HandleHandshakeFinalize(const asio::ip::udp::endpoint& from,
 	if (!session_keys)
 		return;
 
-	session->rx_key = std::move(session_keys->rx);
-	session->tx_key = std::move(session_keys->tx);
+	{
+		std::lock_guard<std::mutex> lock(session->kcp_mutex);
+		if (!session->cipher.Init(session_keys->tx, session_keys->rx))
+			return;
+	}
+
+	// The manifest would miss resources still being packed, the join is answered once
+	// they are done (CompleteDeferredJoins).
+	if (resource_->HasPendingResources()) {
+		if (!session->join_deferred) {
+			session->join_deferred = true;
+			deferred_joins_.push_back(session);
+		}
+
+		LOG_INFO("Network handshake for player %d is waiting for resources to be packed.", session->playerid);
+		return;
+	}
+
+	CompleteJoin(session);
+}
+
+void CefPlugin::CompleteJoin(const std::shared_ptr<NetworkSession>& session)
+{
+	const asio::ip::udp::endpoint from = session->address;
 
 	JoinResponsePacket join_response;
 	join_response.accepted = true;
@@ -238,6 +333,10 @@ void CefPlugin::HandleHandshakeFinalize(const asio::ip::udp::endpoint& from,
 	ikcp_nodelay(session->kcp_instance, 1, 10, 2, 1);
 	ikcp_wndsize(session->kcp_instance, 256, 256);
 
+	session->chunk_sizer.Reset(session->kcp_instance->mss, FILE_CHUNK_MESSAGE_OVERHEAD);
+	session->retransmits.Reset();
+
+	session->event_table_synced = 0;
 	session->handshake_status = HandshakeStatus::CONNECTED;
 
 	ServerConfigPacket config_packet;
@@ -254,7 +353,10 @@ void CefPlugin::HandleKcpInput(std::shared_ptr<NetworkSession> session)
     if (!session)
         return;
 
-    std::vector<NetworkPacket> pendingPackets;
+    // Messages are received and opened in the session's buffer and decoded into its
+    // packet slots, handlers read them there once kcp_mutex is released.
+    ReceiveContext& receive = session->receive;
+    receive.Reset();
 
     {
         std::lock_guard<std::mutex> lock(session->kcp_mutex);
@@ -262,28 +364,29 @@ void CefPlugin::HandleKcpInput(std::shared_ptr<NetworkSession> session)
         if (!session->kcp_instance)
             return;
 
-        std::vector<char> kcp_buffer(65535);
         int msg_size;
 
-        while ((msg_size = ikcp_recv(session->kcp_instance, kcp_buffer.data(),
-            static_cast<int>(kcp_buffer.size()))) > 0)
+        while ((msg_size = ikcp_peeksize(session->kcp_instance)) > 0)
         {
-            std::vector<uint8_t> decrypted =
-                DecryptPacket({ kcp_buffer.begin(), kcp_buffer.begin() + msg_size }, session->rx_key);
-
-            if (decrypted.empty())
-                continue;
+            char* message = receive.MessageBuffer(static_cast<size_t>(msg_size));
+            if (ikcp_recv(session->kcp_instance, message, msg_size) != msg_size)
+                break;
 
-            NetworkPacket packet;
-            if (!DeserializePacket(reinterpret_cast<const char*>(decrypted.data()), decrypted.size(), packet))
+            size_t plaintext_size = 0;
+            if (!session->cipher.Open(reinterpret_cast<uint8_t*>(message), static_cast<size_t>(msg_size), plaintext_size))
                 continue;
 
-            pendingPackets.emplace_back(std::move(packet));
+            ForEachFramedPacket(message + SESSION_COUNTER_BYTES, plaintext_size,
+                [&receive](const char* data, size_t size) {
+                    receive.Decode(data, size);
+                });
         }
     }
 
-    for (auto& packet : pendingPackets)
+    for (size_t i = 0; i < receive.count; ++i)
     {
+        const NetworkPacket& packet = receive.packets[i];
+
         switch (packet.type)
         {
             case PacketType::RequestFiles:
@@ -312,6 +415,69 @@ void CefPlugin::HandleKcpInput(std::shared_ptr<NetworkSession> session)
     }
 }
 
+void CefPlugin::AddResource(const std::string& resourceName)
+{
+	resource_->AddResourceAsync(resourceName, master_resource_key_,
+		[this](const std::string& name, bool success) {
+			OnResourceReady(name, success);
+		});
+}
+
+bool CefPlugin::IsResourceReady(const std::string& resourceName) const
+{
+	return resource_->IsResourceReady(resourceName);
+}
+
+void CefPlugin::OnResourceReady(const std::string& resourceName, bool success)
+{
+	std::vector<Argument> args;
+	args.emplace_back(resourceName);
+	args.emplace_back(success);
+	QueuePawnCallback([args = std::move(args)](IPlatformBridge& bridge) {
+		bridge.CallPawnPublic("OnCefResourceReady", args);
+	});
+
+	if (!running_)
+		return;
+
+	asio::post(io_context_, [this, resourceName, success] {
+		if (success)
+			SendManifestUpdate(resourceName);
+
+		if (!resource_->HasPendingResources())
+			CompleteDeferredJoins();
+	});
+}
+
+void CefPlugin::SendManifestUpdate(const std::string& resourceName)
+{
+	ManifestUpdatePacket update;
+	update.manifest_json = resource_->GetManifestAsJson(resourceName).dump();
+
+	// Joins completed after the resource was published already have it, clients skip
+	// resources they hold at the same hash.
+	for (const auto& session : sessions_->GetAllSessions()) {
+		if (session->handshake_complete && session->kcp_instance)
+			SendPacketToSession(session, PacketType::ManifestUpdate, update);
+	}
+}
+
+void CefPlugin::CompleteDeferredJoins()
+{
+	auto joins = std::move(deferred_joins_);
+	deferred_joins_.clear();
+
+	for (const auto& session : joins) {
+		session->join_deferred = false;
+
+		// Left while waiting, or got a fresh session since.
+		if (sessions_->GetSession(session->playerid) != session || session->handshake_status != HandshakeStatus::CHALLENGED)
+			continue;
+
+		CompleteJoin(session);
+	}
+}
+
 void CefPlugin::HandleFileRequest(int playerid, const RequestFilesPacket& request)
 {
 	auto session = sessions_->GetSession(playerid);
@@ -321,33 +487,56 @@ void CefPlugin::HandleFileRequest(int playerid, const RequestFilesPacket& reques
 	for (const auto& [resourceName, relativePath] : request.files) {
 		if (resource_->IsFileValid(resourceName, relativePath)) {
 
-			std::vector<uint8_t> content;
-			if (!resource_->GetPakContent(resourceName, content)) {
+			auto pak = resource_->GetPak(resourceName);
+			if (!pak) {
+				continue;
+			}
+
+			if (pak->Size() > UINT32_MAX) {
+				LOG_ERROR("Pak of resource '%s' is too large to transfer (%zu bytes)", resourceName.c_str(), pak->Size());
 				continue;
 			}
 
 			auto transfer = std::make_shared<FileTransfer>();
 			transfer->resourceName = resourceName;
 			transfer->relativePath = relativePath;
-			transfer->fileHash = CalculateSHA256FromData(content);
-			transfer->content = std::move(content);
-			transfer->totalChunks = (transfer->content.size() + FILE_CHUNK_SIZE - 1) / FILE_CHUNK_SIZE;
-			transfer->currentChunkIndex = 0;
+			transfer->fileHash = pak->hash;
+			transfer->size = static_cast<uint32_t>(pak->Size());
+			transfer->pak = std::move(pak);
 
 			session->download_queue.push(transfer);
 		}
 	}
+
+	if (!session->download_queue.empty() &&
+		std::find(transfer_sessions_.begin(), transfer_sessions_.end(), session) == transfer_sessions_.end()) {
+		transfer_sessions_.push_back(session);
+	}
 }
 
 void CefPlugin::ProcessFileTransfers()
 {
-    static constexpr int MAX_CHUNKS_PER_TICK = 64;
+    // In KCP segments, so smaller chunks on a lossy link do not lower the rate.
+    static constexpr int MAX_SEGMENTS_PER_TICK = 256;
     static constexpr int MAX_IN_FLIGHT_SEGMENTS = 220; 
 
-    auto all_sessions = sessions_->GetAllSessions();
-    for (auto& session : all_sessions)
+    // Bulk data waits while the socket is behind, events keep the remaining buffers.
+    if (!network_server_ || network_server_->IsSendBacklogged())
+        return;
+
+    // Datagrams lost before reaching the socket, kept out of the chunk sizers' loss samples.
+    const SendPoolStats send_stats = network_server_->GetSendPoolStats();
+    const uint64_t local_drops = send_stats.exhausted + send_stats.dropped;
+
+    // Sessions leave the list once their queue is drained or they are gone.
+    transfer_sessions_.erase(std::remove_if(transfer_sessions_.begin(), transfer_sessions_.end(),
+        [](const std::shared_ptr<NetworkSession>& session) {
+            return !session->kcp_instance || (!session->current_transfer && session->download_queue.empty());
+        }), transfer_sessions_.end());
+
+    for (auto& session : transfer_sessions_)
     {
-        if (!session || !session->kcp_instance || !session->handshake_complete)
+        if (!session->handshake_complete)
             continue;
 
 		if (session->is_download_paused.load(std::memory_order_relaxed)) {
@@ -366,27 +555,60 @@ void CefPlugin::ProcessFileTransfers()
         if (!transfer) 
             continue;
 
+        // One transfer is sent at a time, ids only have to outlive the client's copy
+        // of the previous ones, which ends with FileTransferEnd.
+        if (!transfer->begun)
+        {
+            transfer->id = session->next_transfer_id;
+            session->next_transfer_id = static_cast<uint8_t>((session->next_transfer_id + 1) % MAX_FILE_TRANSFERS);
+            transfer->begun = true;
+
+            FileTransferBeginPacket begin;
+            begin.id = transfer->id;
+            begin.resourceName = transfer->resourceName;
+            begin.relativePath = transfer->relativePath;
+            begin.fileHash = transfer->fileHash;
+            begin.size = transfer->size;
+
+            SendPacketToPlayer(session->playerid, PacketType::FileTransferBegin, begin);
+        }
+
         int sent_this_tick = 0;
 
-        while (transfer && sent_this_tick < MAX_CHUNKS_PER_TICK)
+        while (transfer && sent_this_tick < MAX_SEGMENTS_PER_TICK)
         {
 			if (session->is_download_paused.load(std::memory_order_relaxed)) {
                 break;
             }
 
-            if (transfer->currentChunkIndex >= transfer->totalChunks)
+            if (transfer->offset >= transfer->size)
             {
                 LOG_DEBUG("Completed transfer for player %d - file '%s'", session->playerid, transfer->relativePath.c_str());
 
+                FileTransferEndPacket end;
+                end.id = transfer->id;
+                SendPacketToPlayer(session->playerid, PacketType::FileTransferEnd, end);
+
                 session->current_transfer = nullptr;
                 break;
             }
 
             int in_flight = 0;
+            uint32_t segments_sent = 0;
+            uint32_t retransmits = 0;
             {
                 std::lock_guard<std::mutex> guard(session->kcp_mutex);
                 if (!session->kcp_instance) break;
                 in_flight = ikcp_waitsnd(session->kcp_instance);
+                segments_sent = session->kcp_instance->snd_nxt;
+                retransmits = session->retransmits.Retransmits();
+            }
+
+            auto& sizer = session->chunk_sizer;
+            if (sizer.Observe(segments_sent, retransmits, local_drops))
+            {
+                LOG_DEBUG("File chunks for player %d now span %u segment(s), %zu bytes (%u.%u%% retransmitted)",
+                    session->playerid, sizer.Segments(), sizer.ChunkBytes(), sizer.LossPermille() / 10, sizer.LossPermille() % 10);
             }
 
             if (in_flight >= MAX_IN_FLIGHT_SEGMENTS)
@@ -394,25 +616,20 @@ void CefPlugin::ProcessFileTransfers()
                 break;
             }
 
-            size_t chunkOffset = transfer->currentChunkIndex * FILE_CHUNK_SIZE;
-            size_t remaining = transfer->content.size() - chunkOffset;
-            size_t chunkSize = std::min(static_cast<size_t>(FILE_CHUNK_SIZE), remaining);
+            size_t chunkSize = std::min(sizer.ChunkBytes(), static_cast<size_t>(transfer->size - transfer->offset));
 
-            FileDataPacket packet;
-            packet.resourceName = transfer->resourceName;
-            packet.relativePath = transfer->relativePath;
-            packet.fileHash = transfer->fileHash;
-            packet.chunkIndex = transfer->currentChunkIndex;
-            packet.totalChunks = transfer->totalChunks;
+            FileChunkPacket packet;
+            packet.id = transfer->id;
+            packet.offset = transfer->offset;
             packet.data.assign(
-                transfer->content.begin() + chunkOffset,
-                transfer->content.begin() + chunkOffset + chunkSize
+                transfer->pak->Data() + transfer->offset,
+                transfer->pak->Data() + transfer->offset + chunkSize
             );
 
-            SendPacketToPlayer(session->playerid, PacketType::FileData, packet);
+            SendPacketToPlayer(session->playerid, PacketType::FileChunk, packet);
 
-            ++transfer->currentChunkIndex;
-            ++sent_this_tick;
+            transfer->offset += static_cast<uint32_t>(chunkSize);
+            sent_this_tick += static_cast<int>(sizer.Segments());
         }
     }
 }
@@ -421,12 +638,12 @@ void CefPlugin::SendRawPacketToEndpoint(const asio::ip::udp::endpoint& endpoint,
 {
 	NetworkPacket packet{ type, payload };
 
-	std::string raw_data;
+	thread_local std::vector<uint8_t> raw_data;
 	if (!SerializePacket(packet, raw_data))
 		return;
 
 	if (network_server_)
-		network_server_->SendTo(endpoint, raw_data.data(), static_cast<int>(raw_data.size()));
+		network_server_->SendTo(endpoint, reinterpret_cast<const char*>(raw_data.data()), static_cast<int>(raw_data.size()));
 }
 
 void CefPlugin::SendPacketToPlayer(int playerid, PacketType type, const PacketPayload& payload)
@@ -435,26 +652,187 @@ void CefPlugin::SendPacketToPlayer(int playerid, PacketType type, const PacketPa
     if (!session)
         return;
 
+    // Event ids must reach the client before anything that references them.
+    if (session->event_table_synced.load(std::memory_order_acquire) < event_table_size_.load(std::memory_order_acquire))
+        SyncEventTable(session);
+
+    SendPacketToSession(session, type, payload);
+}
+
+void CefPlugin::SendPacketToSession(const std::shared_ptr<NetworkSession>& session, PacketType type, const PacketPayload& payload)
+{
     NetworkPacket packet{ type, payload };
 
-    std::string raw_data;
+    thread_local std::vector<uint8_t> raw_data;
     if (!SerializePacket(packet, raw_data)) {
-        LOG_ERROR("Failed to serialize packet (type %d) for player %d", (int)type, playerid);
+        LOG_ERROR("Failed to serialize packet (type %d) for player %d", (int)type, session->playerid);
         return;
     }
 
-    std::vector<uint8_t> encrypted = EncryptPacket({ raw_data.begin(), raw_data.end() }, session->tx_key);
-    if (encrypted.empty())
-        return;
-
     std::lock_guard<std::mutex> lock(session->kcp_mutex);
     if (!session->kcp_instance)
         return;
 
-    ikcp_send(session->kcp_instance, (const char*)encrypted.data(), (int)encrypted.size());
+    auto& batch = session->outbound_batch;
+    const bool flush_immediately = GetFlushPolicy(type) == CefFlushPolicy::Immediate;
+
+    if (batch.packets > 0 && batch.frame.size() + BATCH_ENTRY_OVERHEAD + raw_data.size() > batch_max_bytes_)
+        FlushBatchLocked(*session);
+
+    if (!AppendToBatch(batch.frame, raw_data.data(), raw_data.size())) {
+        // Too large to frame, keep ordering and send it on its own.
+        FlushBatchLocked(*session);
+        SendMessageLocked(*session, raw_data, flush_immediately);
+        batched_packets_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
 
-	// TODO: Not always flush immediately (for file transfer?)
-    ikcp_flush(session->kcp_instance);
+    if (batch.packets++ == 0) {
+        batch.opened_ms = iclock();
+        sessions_->ScheduleKcpUpdate(session->playerid, batch.opened_ms + batch_max_delay_ms_);
+    }
+
+    batch.flush_immediately |= flush_immediately;
+
+    if (batch_max_delay_ms_ == 0 || batch.frame.size() >= batch_max_bytes_)
+        FlushBatchLocked(*session);
+}
+
+CefFlushPolicy CefPlugin::GetFlushPolicy(PacketType type) const
+{
+    switch (type)
+    {
+        case PacketType::FileTransferBegin:
+        case PacketType::FileChunk:
+        case PacketType::FileTransferEnd:
+            return transfer_flush_policy_;
+        case PacketType::EmitEvent:
+        case PacketType::EmitBrowserEvent:
+            return event_flush_policy_;
+        default:
+            return control_flush_policy_;
+    }
+}
+
+void CefPlugin::SendMessageLocked(NetworkSession& session, const std::vector<uint8_t>& message, bool flush)
+{
+    thread_local std::vector<uint8_t> sealed;
+    sealed.resize(message.size() + SESSION_OVERHEAD);
+
+    if (!session.cipher.Seal(message.data(), message.size(), sealed.data()))
+        return;
+
+    ikcp_send(session.kcp_instance, (const char*)sealed.data(), (int)sealed.size());
+    batched_messages_.fetch_add(1, std::memory_order_relaxed);
+
+    if (flush) {
+        ikcp_flush(session.kcp_instance);
+        immediate_flushes_.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        deferred_flushes_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Before the first ikcp_update this is "now", afterwards the next resend or flush.
+    sessions_->ScheduleKcpUpdate(session.playerid, ikcp_check(session.kcp_instance, iclock()));
+}
+
+void CefPlugin::FlushBatchLocked(NetworkSession& session)
+{
+    auto& batch = session.outbound_batch;
+    if (batch.packets == 0)
+        return;
+
+    SendMessageLocked(session, batch.frame, batch.flush_immediately);
+    batched_packets_.fetch_add(batch.packets, std::memory_order_relaxed);
+
+    batch.frame.clear();
+    batch.packets = 0;
+    batch.flush_immediately = false;
+}
+
+CefNetworkStats CefPlugin::GetNetworkStats() const
+{
+    CefNetworkStats stats;
+    stats.packets = batched_packets_.load(std::memory_order_relaxed);
+    stats.messages = batched_messages_.load(std::memory_order_relaxed);
+    stats.immediate_flushes = immediate_flushes_.load(std::memory_order_relaxed);
+    stats.deferred_flushes = deferred_flushes_.load(std::memory_order_relaxed);
+
+    if (sessions_) {
+        const KcpOutputStats& output = sessions_->GetOutputStats();
+        const uint64_t segments = output.segments.load(std::memory_order_relaxed);
+
+        stats.datagrams = output.datagrams.load(std::memory_order_relaxed);
+        stats.bytes = output.bytes.load(std::memory_order_relaxed);
+        stats.datagrams_saved = segments > stats.datagrams ? segments - stats.datagrams : 0;
+        stats.bytes_saved = stats.datagrams_saved * UDP_IP_OVERHEAD;
+    }
+
+    if (network_server_)
+        stats.send_pool = network_server_->GetSendPoolStats();
+
+    return stats;
+}
+
+void CefPlugin::UpdateKcpSessions(uint32_t now_ms)
+{
+    sessions_->CollectDueSessions(now_ms, due_sessions_);
+
+    for (auto& session : due_sessions_)
+    {
+        std::lock_guard<std::mutex> lock(session->kcp_mutex);
+
+        if (!session->kcp_instance)
+            continue;
+
+        auto& batch = session->outbound_batch;
+        if (batch.packets > 0 && now_ms - batch.opened_ms >= batch_max_delay_ms_)
+            FlushBatchLocked(*session);
+
+        ikcp_update(session->kcp_instance, now_ms);
+
+        // Nothing queued and nothing unacknowledged: sleep until input or a send.
+        if (batch.packets == 0 && ikcp_waitsnd(session->kcp_instance) == 0)
+            continue;
+
+        uint32_t next = ikcp_check(session->kcp_instance, now_ms);
+        if (batch.packets > 0 && static_cast<int32_t>(batch.opened_ms + batch_max_delay_ms_ - next) < 0)
+            next = batch.opened_ms + batch_max_delay_ms_;
+
+        sessions_->ScheduleKcpUpdate(session->playerid, next);
+    }
+
+    due_sessions_.clear();
+}
+
+void CefPlugin::SyncEventTable(const std::shared_ptr<NetworkSession>& session)
+{
+	static constexpr size_t MAX_ENTRIES_PER_PACKET = 64;
+
+	// Held while sending so a concurrent sender cannot see the watermark advance
+	// before the table packet is queued ahead of its own.
+	std::lock_guard<std::mutex> lock(events_mutex_);
+
+	size_t synced = session->event_table_synced.load(std::memory_order_acquire);
+
+	while (synced < event_table_.Size())
+	{
+		const size_t end = std::min(event_table_.Size(), synced + MAX_ENTRIES_PER_PACKET);
+
+		EventTablePacket packet;
+		packet.entries.reserve(end - synced);
+
+		for (size_t i = synced; i < end; ++i) {
+			const CefEvent::Id id = CefEvent::EventTable::IndexToId(i);
+			packet.entries.emplace_back(id, *event_table_.Name(id));
+		}
+
+		SendPacketToSession(session, PacketType::EventTable, packet);
+		synced = end;
+	}
+
+	session->event_table_synced.store(synced, std::memory_order_release);
 }
 
 void CefPlugin::NotifyCefInitialize(std::shared_ptr<NetworkSession> session, bool success)
@@ -471,7 +849,9 @@ void CefPlugin::NotifyCefInitialize(std::shared_ptr<NetworkSession> session, boo
     std::vector<Argument> args;
     args.emplace_back(session->playerid);
     args.emplace_back(success);
-    bridge_->CallPawnPublic("OnCefInitialize", args);
+    QueuePawnCallback([args = std::move(args)](IPlatformBridge& bridge) {
+        bridge.CallPawnPublic("OnCefInitialize", args);
+    });
 }
 
 void CefPlugin::NotifyCefReady(std::shared_ptr<NetworkSession> session)
@@ -482,42 +862,63 @@ void CefPlugin::NotifyCefReady(std::shared_ptr<NetworkSession> session)
 	if (!session->cef_init_notified)
 		return;
 
-    if (!session->cef_success)
+    if (!session->cef_success || session->cef_ready_notified)
 		return;
 
+    session->cef_ready_notified = true;
+
     std::vector<Argument> args;
     args.emplace_back(session->playerid);
-    bridge_->CallPawnPublic("OnCefReady", args);
+    QueuePawnCallback([args = std::move(args)](IPlatformBridge& bridge) {
+        bridge.CallPawnPublic("OnCefReady", args);
+    });
 }
 
 void CefPlugin::HandleClientEvent(int playerid, const ClientEmitEventPacket& payload)
 {
-	if (payload.name == CefEvent::Client::BrowserCreateResult)
+	CefEvent::Id id = payload.eventId;
+	if (id == CefEvent::InvalidId)
+		id = CefEvent::FindBuiltin(payload.name);
+
+	if (id == CefEvent::Client::BrowserCreateResult.id)
 	{
 		if (payload.args.size() >= 3)
 		{
 			int browserId = payload.browserId;
 			bool success = payload.args[0].boolValue;
 			int code = payload.args[1].intValue;
-			const std::string& reason = payload.args[2].stringValue;
+			std::string reason = payload.args[2].stringValue;
 
-			bridge_->CallOnBrowserCreated(playerid, browserId, success, code, reason);
+			QueuePawnCallback([=, reason = std::move(reason)](IPlatformBridge& bridge) {
+				bridge.CallOnBrowserCreated(playerid, browserId, success, code, reason);
+			});
 		}
 
 		return;
 	}
 
-    auto it = registered_events_.find(payload.name);
-    if (it == registered_events_.end())
+    std::shared_ptr<const RegisteredEvent> registered;
+    {
+        std::lock_guard<std::mutex> lock(events_mutex_);
+
+        if (id == CefEvent::InvalidId)
+            id = event_table_.Find(payload.name);
+
+        const size_t index = static_cast<size_t>(id) - CefEvent::FirstDynamicId;
+        if (id >= CefEvent::FirstDynamicId && index < registered_events_.size())
+            registered = registered_events_[index];
+    }
+
+    if (!registered)
         return;
 
-    const auto& reg = it->second;
+    const auto& reg = *registered;
     const auto& signature = reg.signature;
 
     if (signature.size() != payload.args.size())
     {
         LOG_WARN("Argument count mismatch for event '%s' (callback '%s'). Expected %zu, got %zu.",
-            payload.name.c_str(), reg.callback.c_str(), signature.size(), payload.args.size());
+            reg.name.c_str(), reg.callback.c_str(), signature.size(), payload.args.size());
         return;
     }
 
@@ -529,7 +930,7 @@ void CefPlugin::HandleClientEvent(int playerid, const ClientEmitEventPacket& pay
         if (arg.type != expected)
         {
             LOG_WARN("Type mismatch for event '%s' (callback '%s') at arg %zu. Expected %d, got %d.",
-                payload.name.c_str(), reg.callback.c_str(), i,
+                reg.name.c_str(), reg.callback.c_str(), i,
                 static_cast<int>(expected), static_cast<int>(arg.type));
             return;
         }
@@ -541,7 +942,58 @@ void CefPlugin::HandleClientEvent(int playerid, const ClientEmitEventPacket& pay
     final_args.emplace_back(payload.browserId);
     final_args.insert(final_args.end(), payload.args.begin(), payload.args.end());
 
-    bridge_->CallPawnPublic(reg.callback, final_args);
+    QueuePawnCallback([callback = reg.callback, final_args = std::move(final_args)](IPlatformBridge& bridge) {
+        bridge.CallPawnPublic(callback, final_args);
+    });
+}
+
+void CefPlugin::QueuePawnCallback(std::function<void(IPlatformBridge&)> callback)
+{
+    pawn_callbacks_.Push(PawnCallback{ std::move(callback), iclock() });
+
+    const uint64_t queued = callbacks_queued_.fetch_add(1, std::memory_order_relaxed) + 1;
+    const uint64_t depth = queued - callbacks_dispatched_.load(std::memory_order_relaxed);
+
+    uint64_t max_depth = callbacks_max_depth_.load(std::memory_order_relaxed);
+    while (depth > max_depth && !callbacks_max_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {}
+}
+
+void CefPlugin::ProcessPawnCallbacks()
+{
+    if (!bridge_)
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto budget = std::chrono::microseconds(pawn_tick_budget_us_);
+
+    PawnCallback callback;
+    while (pawn_callbacks_.TryPop(callback))
+    {
+        const uint32_t waited = iclock() - callback.queued_ms;
+        if (waited > callbacks_max_wait_ms_.load(std::memory_order_relaxed))
+            callbacks_max_wait_ms_.store(waited, std::memory_order_relaxed);
+
+        callback.call(*bridge_);
+        callbacks_dispatched_.fetch_add(1, std::memory_order_relaxed);
+
+        if (std::chrono::steady_clock::now() - start >= budget) {
+            if (callbacks_dispatched_.load(std::memory_order_relaxed) != callbacks_queued_.load(std::memory_order_relaxed))
+                callbacks_budget_exceeded_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+}
+
+CefCallbackStats CefPlugin::GetCallbackStats() const
+{
+    CefCallbackStats stats;
+    stats.queued = callbacks_queued_.load(std::memory_order_relaxed);
+    stats.dispatched = callbacks_dispatched_.load(std::memory_order_relaxed);
+    stats.depth = stats.queued > stats.dispatched ? stats.queued - stats.dispatched : 0;
+    stats.max_depth = callbacks_max_depth_.load(std::memory_order_relaxed);
+    stats.budget_exceeded = callbacks_budget_exceeded_.load(std::memory_order_relaxed);
+    stats.max_wait_ms = callbacks_max_wait_ms_.load(std::memory_order_relaxed);
+    return stats;
 }
 
 void CefPlugin::RegisterEvent(const std::string& name, const std::string& callback, const std::vector<ArgumentType>& signature)
@@ -568,14 +1020,64 @@ void CefPlugin::RegisterEvent(const std::string& name, const std::string& callba
 		}
 	}
 
-	RegisteredEvent event;
-    event.callback = callback.empty() ? name : callback;
-    event.signature = signature;
+	auto event = std::make_shared<RegisteredEvent>();
+    event->name = name;
+    event->callback = callback.empty() ? name : callback;
+    event->signature = signature;
 
-    registered_events_[name] = std::move(event);
+    {
+        std::lock_guard<std::mutex> lock(events_mutex_);
+
+        const CefEvent::Id id = event_table_.Intern(name);
+        if (id == CefEvent::InvalidId) {
+            LOG_ERROR("Event table is full, cannot register event '%s'", name.c_str());
+            return;
+        }
+
+        const size_t index = id - CefEvent::FirstDynamicId;
+        if (index >= registered_events_.size())
+            registered_events_.resize(index + 1);
+
+        registered_events_[index] = std::move(event);
+        event_table_size_.store(event_table_.Size(), std::memory_order_release);
+    }
+
+    // Clients already connected learn the id now, later ones get it after their handshake.
+    if (!sessions_)
+        return;
+
+    for (auto& session : sessions_->GetAllSessions())
+    {
+        if (session && session->kcp_instance && session->handshake_complete)
+            SyncEventTable(session);
+    }
+}
+
+CefEvent::Id CefPlugin::InternEvent(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(events_mutex_);
+
+	CefEvent::Id id = event_table_.Find(name);
+	if (id != CefEvent::InvalidId || emitted_event_names_ >= MAX_EMITTED_EVENT_NAMES)
+		return id;
+
+	id = event_table_.Intern(name);
+	if (id != CefEvent::InvalidId) {
+		++emitted_event_names_;
+		event_table_size_.store(event_table_.Size(), std::memory_order_release);
+
+		if (emitted_event_names_ == MAX_EMITTED_EVENT_NAMES)
+			LOG_WARN("%zu event names emitted without RegisterEvent, further ones are sent by name", MAX_EMITTED_EVENT_NAMES);
+	}
+
+	return id;
 }
 
 CefPlugin::~CefPlugin()
 {
 	Shutdown();
+
+	// Never initialized: still wait for packing in progress, it reports back to members
+	// declared after resource_.
+	resource_.reset();
 }
\ No newline at end of file
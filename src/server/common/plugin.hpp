@@ -1,25 +1,94 @@
 #pragma once
 
 #include <asio.hpp>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared/events.hpp>
 #include <shared/packet.hpp>
 
 #include "api.hpp"
 #include "bridge.hpp"
 #include "logger.hpp"
+#include "mpsc_queue.hpp"
 #include "network.hpp"
 #include "resource_manager.hpp"
 #include "security.hpp"
 #include "session.hpp"
 
+enum class CefFlushPolicy : uint8_t
+{
+	Immediate, // ikcp_flush as soon as the message is handed to KCP
+	Deferred,  // left to the next ikcp_update on the network tick, so segments share datagrams
+};
+
 struct CefPluginOptions
 {
     CefLogLevel log_level = CefLogLevel::Info;
 	std::vector<uint8_t> master_resource_key = {};
+
+	// Packets sent to a player within this window are packed into one encrypted KCP
+	// message, flushed by the network tick. 0 sends every packet on its own.
+	uint32_t batch_max_delay_ms = 10;
+
+	// Upper bound of a batch frame before encryption. The default keeps a frame within
+	// one KCP segment (mss 1376 minus SESSION_OVERHEAD, 24 bytes of counter and MAC).
+	uint32_t batch_max_bytes = 1352;
+
+	// Applied when the batch holding a packet is handed to KCP; a batch is flushed
+	// immediately if any packet in it asks for it.
+	CefFlushPolicy control_flush_policy = CefFlushPolicy::Immediate;  // handshake, config, event table
+	CefFlushPolicy event_flush_policy = CefFlushPolicy::Immediate;    // EmitEvent, EmitBrowserEvent
+	CefFlushPolicy transfer_flush_policy = CefFlushPolicy::Deferred;  // FileTransferBegin, FileChunk, FileTransferEnd
+
+	// recvmmsg/sendmmsg (and UDP GSO) socket backend on Linux, ignored elsewhere.
+	bool batched_udp_io = true;
+
+	// Outgoing datagram buffers (1472 bytes each). File transfers pause while three quarters
+	// are in flight, datagrams are dropped once all are. ~8 per player is plenty.
+	uint32_t send_buffers = 4096;
+
+	// Time the host tick may spend running queued Pawn callbacks before leaving the
+	// rest to the next tick. At least one callback runs per tick.
+	uint32_t pawn_tick_budget_us = 2000;
+
+	// Pack resources into the indexed format (shared/pak-format.hpp), read on demand by
+	// the client. Off builds the older zip paks, both are understood by current clients.
+	bool indexed_pak = true;
+
+	// Seal indexed pak entries with AES-256-GCM instead of XChaCha20-Poly1305. Faster with
+	// AES-NI, but a client without it cannot open the paks at all: only for servers whose
+	// players all have it. Ignored when the server itself lacks AES-NI.
+	bool pak_aes_gcm = false;
+};
+
+struct CefNetworkStats
+{
+	uint64_t packets = 0;           // packets queued to players
+	uint64_t messages = 0;          // encrypted KCP messages they were packed into
+	uint64_t immediate_flushes = 0;
+	uint64_t deferred_flushes = 0;  // messages left to ikcp_update
+	uint64_t datagrams = 0;         // datagrams written by KCP
+	uint64_t bytes = 0;
+	uint64_t datagrams_saved = 0;   // segments that shared a datagram with another one
+	uint64_t bytes_saved = 0;       // UDP/IP headers of those datagrams
+
+	SendPoolStats send_pool;
+};
+
+struct CefCallbackStats
+{
+	uint64_t queued = 0;
+	uint64_t dispatched = 0;
+	uint64_t depth = 0;             // waiting for the next host tick
+	uint64_t max_depth = 0;
+	uint64_t budget_exceeded = 0;   // ticks that left callbacks behind
+	uint32_t max_wait_ms = 0;       // longest time a callback waited for the host tick
 };
 
 struct RegisteredEvent
 {
+    std::string name;
     std::string callback;
     std::vector<ArgumentType> signature;
 };
@@ -41,6 +110,10 @@ public:
 
 	void OnPacketReceived(const asio::ip::udp::endpoint& from, const char* data, int len);
 
+	// Packs the resource on the resource worker pool, see OnResourceReady.
+	void AddResource(const std::string& resourceName);
+	bool IsResourceReady(const std::string& resourceName) const;
+
 	void HandleFileRequest(int playerid, const RequestFilesPacket& request);
 	void ProcessFileTransfers();
 
@@ -51,6 +124,9 @@ public:
 	void NotifyCefReady(std::shared_ptr<NetworkSession> session);
 	void HandleClientEvent(int playerid, const ClientEmitEventPacket& payload);
 	void RegisterEvent(const std::string& name, const std::string& callback, const std::vector<ArgumentType>& signature);
+	// Id for an emitted event name. Names not registered are only interned until
+	// MAX_EMITTED_EVENT_NAMES of them are, later ones return InvalidId and go inline.
+	CefEvent::Id InternEvent(const std::string& name);
 
 	ResourceManager& GetResourceManager()
 	{
@@ -64,11 +140,38 @@ public:
 
 	const std::vector<uint8_t>& GetMasterKey() const { return master_resource_key_; }
 
+	CefNetworkStats GetNetworkStats() const;
+
+	// Host main thread (open.mp onTick, SA-MP ProcessTick). Runs the Pawn callbacks queued
+	// by the network thread, within the configured time budget.
+	void ProcessPawnCallbacks();
+	CefCallbackStats GetCallbackStats() const;
+
 private:
 	void HandleRequestJoin(const asio::ip::udp::endpoint& from, const RequestJoinPacket& packet);
 	void HandleHandshakeFinalize(const asio::ip::udp::endpoint& from, const HandshakeFinalizePacket& finalize_packet, std::shared_ptr<NetworkSession> session);
+	void CompleteJoin(const std::shared_ptr<NetworkSession>& session);
+	void WatchClientInit(int playerid);
+
+	// Resource pool thread. Runs OnCefResourceReady, then on the network thread sends the
+	// new manifest to joined clients and releases joins held while resources were packing.
+	void OnResourceReady(const std::string& resourceName, bool success);
+	void SendManifestUpdate(const std::string& resourceName);
+	void CompleteDeferredJoins();
+
 	void HandleKcpInput(std::shared_ptr<NetworkSession> session);
 
+	void SendPacketToSession(const std::shared_ptr<NetworkSession>& session, PacketType type, const PacketPayload& payload);
+	void SyncEventTable(const std::shared_ptr<NetworkSession>& session);
+
+	CefFlushPolicy GetFlushPolicy(PacketType type) const;
+	void SendMessageLocked(NetworkSession& session, const std::vector<uint8_t>& message, bool flush);
+	void FlushBatchLocked(NetworkSession& session);
+	void UpdateKcpSessions(uint32_t now_ms);
+
+	// The AMX is not thread-safe, everything that ends up in a script goes through here.
+	void QueuePawnCallback(std::function<void(IPlatformBridge&)> callback);
+
 private:
 	std::unique_ptr<IPlatformBridge> bridge_;
 	std::unique_ptr<SecurityManager> security_;
@@ -80,11 +183,50 @@ private:
 
 	std::vector<uint8_t> master_resource_key_;
 
+	uint32_t batch_max_delay_ms_ = 0;
+	size_t batch_max_bytes_ = 0;
+	std::atomic<uint64_t> batched_packets_{ 0 };
+	std::atomic<uint64_t> batched_messages_{ 0 };
+
+	CefFlushPolicy control_flush_policy_ = CefFlushPolicy::Immediate;
+	CefFlushPolicy event_flush_policy_ = CefFlushPolicy::Immediate;
+	CefFlushPolicy transfer_flush_policy_ = CefFlushPolicy::Deferred;
+	std::atomic<uint64_t> immediate_flushes_{ 0 };
+	std::atomic<uint64_t> deferred_flushes_{ 0 };
+
 	asio::io_context io_context_;
 	asio::steady_timer transfer_timer_{ io_context_ };
 	std::unique_ptr<NetworkServer> network_server_;
 	std::thread network_thread_;
 	std::atomic<bool> running_{ false };
 
-	std::unordered_map<std::string, RegisteredEvent> registered_events_;
+	// Network thread only, kept between ticks so updating sessions does not allocate.
+	std::vector<std::shared_ptr<NetworkSession>> due_sessions_;
+	std::vector<std::shared_ptr<NetworkSession>> transfer_sessions_;
+	std::vector<std::shared_ptr<NetworkSession>> deferred_joins_;
+
+	// Script event names share one id space for both directions. registered_events_ is
+	// indexed by (id - CefEvent::FirstDynamicId), null for names that are only emitted.
+	std::mutex events_mutex_;
+	CefEvent::EventTable event_table_;
+	std::atomic<size_t> event_table_size_{ 0 };
+	std::vector<std::shared_ptr<const RegisteredEvent>> registered_events_;
+	// Ids are never freed and every client gets the whole table, so names built at
+	// runtime (per player, per item) must not grow it without bound.
+	static constexpr size_t MAX_EMITTED_EVENT_NAMES = 256;
+	size_t emitted_event_names_ = 0; // guarded by events_mutex_
+
+	struct PawnCallback
+	{
+		std::function<void(IPlatformBridge&)> call;
+		uint32_t queued_ms = 0;
+	};
+
+	MpscQueue<PawnCallback> pawn_callbacks_;
+	uint32_t pawn_tick_budget_us_ = 0;
+	std::atomic<uint64_t> callbacks_queued_{ 0 };
+	std::atomic<uint64_t> callbacks_dispatched_{ 0 };
+	std::atomic<uint64_t> callbacks_max_depth_{ 0 };
+	std::atomic<uint64_t> callbacks_budget_exceeded_{ 0 };
+	std::atomic<uint32_t> callbacks_max_wait_ms_{ 0 };
 };
\ No newline at end of file
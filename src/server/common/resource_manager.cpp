@@ -1,60 +1,200 @@
 #include "resource_manager.hpp"
 #include "logger.hpp"
+#include "thread_pool.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <set>
 #include <shared/crypto.hpp>
+#include <shared/pak-codec.hpp>
+#include <shared/pak-format.hpp>
 #include <shared/utils.hpp>
 #include <thread>
 #include <miniz.h>
 
-void ResourceManager::AddResource(const std::string& resourceName, const std::vector<uint8_t>& master_key)
+// Values of the manifest "$format" key, a cached pak in another layout is rebuilt.
+// 2: zip, files compressed before encryption. 3: indexed pak (shared/pak-format.hpp).
+// 4: indexed pak with large media sealed in segments. 5: same, sealed with AES-256-GCM.
+static constexpr int PAK_LAYOUT_ZIP = 2;
+static constexpr int PAK_LAYOUT_INDEXED = 4;
+static constexpr int PAK_LAYOUT_INDEXED_AES256GCM = 5;
+static constexpr const char* MANIFEST_FORMAT_KEY = "$format";
+// Size, mtime and hash of the pak itself, so an up-to-date pak is not hashed again.
+static constexpr const char* MANIFEST_PAK_KEY = "$pak";
+
+// Already compressed, deflate is not even attempted.
+static bool IsPrecompressed(const std::filesystem::path& path)
+{
+    static const std::set<std::string> PRECOMPRESSED_EXTENSIONS =
+    {
+        ".png",
+        ".jpg",
+        ".jpeg",
+        ".gif",
+        ".mp3",
+        ".ogg",
+        ".woff",
+        ".woff2"
+    };
+
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    return PRECOMPRESSED_EXTENSIONS.count(extension) != 0;
+}
+
+static int64_t ModifiedSeconds(const std::filesystem::file_time_type& time)
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+}
+
+// Manifest keys starting with '$' describe the pak, not a file.
+static size_t CountManifestFiles(const nlohmann::json& manifest)
+{
+    size_t count = 0;
+    for (const auto& item : manifest.items())
+    {
+        if (item.key().empty() || item.key()[0] != '$')
+            ++count;
+    }
+
+    return count;
+}
+
+static bool ReadWholeFile(const std::filesystem::path& path, std::vector<uint8_t>& content)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    content.assign((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
+    return true;
+}
+
+ResourceManager::ResourceManager(size_t threads)
+    : pool_(std::make_unique<ThreadPool>(threads))
+{
+    LOG_DEBUG("[ResourceManager] %zu packing threads, SHA-256 backend: %s.", pool_->Size(), Sha256::Backend());
+}
+
+ResourceManager::~ResourceManager() = default;
+
+void ResourceManager::SetPakCipher(PakCipher cipher)
+{
+    if (!IsPakCipherAvailable(cipher))
+    {
+        LOG_WARN("[ResourceManager] This CPU has no AES-NI, paks are sealed with XChaCha20-Poly1305 instead of AES-256-GCM.");
+        cipher = PakCipher::XChaCha20Poly1305;
+    }
+
+    pak_cipher_ = cipher;
+}
+
+bool ResourceManager::AddResource(const std::string& resourceName, const std::vector<uint8_t>& master_key, PackStats* stats)
 {
     if (master_key.empty())
     {
         LOG_ERROR("[ResourceManager] Cannot add resource '%s' because Master Resource Key is not set.", resourceName.c_str());
-        return;
+        return false;
     }
 
-    this->ProcessResourceDirectory(resourceName, master_key);
+    PackStats local_stats;
+    return this->ProcessResourceDirectory(resourceName, master_key, stats ? *stats : local_stats);
 }
 
-bool ResourceManager::GetPakContent(const std::string& resourceName, std::vector<uint8_t>& outContent) const
+void ResourceManager::AddResourceAsync(const std::string& resourceName, const std::vector<uint8_t>& master_key, ReadyCallback on_ready)
 {
-    std::string pakPath = "scriptfiles/cef/" + resourceName + ".pak";
-    if (!std::filesystem::exists(pakPath))
+    if (master_key.empty())
     {
-        LOG_ERROR("[ResourceManager] GetPakContent failed: File not found at %s.", pakPath.c_str());
-        return false;
+        LOG_ERROR("[ResourceManager] Cannot add resource '%s' because Master Resource Key is not set.", resourceName.c_str());
+
+        if (on_ready)
+            on_ready(resourceName, false);
+
+        return;
     }
 
-    try
     {
-        std::ifstream file(pakPath, std::ios::binary | std::ios::ate);
-        if (!file.is_open())
+        std::lock_guard<std::mutex> lock(resource_mutex_);
+        if (!pending_resources_.insert(resourceName).second)
         {
-            LOG_ERROR("[ResourceManager] GetPakContent failed: Could not open file at %s.", pakPath.c_str());
-            return false;
+            LOG_WARN("[ResourceManager] Resource '%s' is already being packed.", resourceName.c_str());
+            return;
         }
+    }
 
-        std::streamsize size = file.tellg();
-        file.seekg(0, std::ios::beg);
+    pool_->Post([this, resourceName, master_key, on_ready = std::move(on_ready)] {
+        PackStats stats;
+        const bool success = ProcessResourceDirectory(resourceName, master_key, stats);
 
-        outContent.resize(static_cast<size_t>(size));
-        if (file.read(reinterpret_cast<char*>(outContent.data()), size))
         {
-            LOG_DEBUG("[ResourceManager] Successfully read %lld bytes from %s.", static_cast<long long>(size), pakPath.c_str());
-            return true;
+            std::lock_guard<std::mutex> lock(resource_mutex_);
+            pending_resources_.erase(resourceName);
         }
+
+        if (on_ready)
+            on_ready(resourceName, success);
+    });
+}
+
+bool ResourceManager::IsResourceReady(const std::string& resourceName) const
+{
+    std::lock_guard<std::mutex> lock(resource_mutex_);
+    return registered_resources_.count(resourceName) != 0 && pending_resources_.count(resourceName) == 0;
+}
+
+bool ResourceManager::HasPendingResources() const
+{
+    std::lock_guard<std::mutex> lock(resource_mutex_);
+    return !pending_resources_.empty();
+}
+
+std::shared_ptr<const PakFile> ResourceManager::GetPak(const std::string& resourceName) const
+{
+    std::lock_guard<std::mutex> lock(resource_mutex_);
+
+    auto it = registered_resources_.find(resourceName);
+    if (it == registered_resources_.end())
+        return nullptr;
+
+    return it->second.pak;
+}
+
+std::shared_ptr<const PakFile> ResourceManager::PublishPak(const std::string& resourceName, const std::string& pakPath, const std::string& knownHash)
+{
+    auto mapping = MappedFile::Open(pakPath);
+    if (!mapping)
+    {
+        LOG_ERROR("[ResourceManager] Could not map pak file at %s.", pakPath.c_str());
+        return nullptr;
     }
-    catch (const std::exception& e)
+
+    mapping->AdviseSequential();
+
+    auto pak = std::make_shared<PakFile>();
+    pak->resourceName = resourceName;
+    pak->mapping = std::move(mapping);
+    pak->hash = knownHash.empty() ? CalculateSHA256FromData(pak->Data(), pak->Size()) : knownHash;
+
+    FileInfo pakInfo;
+    pakInfo.relativePath = resourceName + ".pak";
+    pakInfo.fileSize = pak->Size();
+    pakInfo.fileHash = pak->hash;
+
+    Resource pakResource;
+    pakResource.name = resourceName;
+    pakResource.files.push_back(pakInfo);
+    pakResource.totalSize = pakInfo.fileSize;
+    pakResource.pak = pak;
+
     {
-        LOG_ERROR("[ResourceManager] GetPakContent exception while reading %s: %s", pakPath.c_str(), e.what());
+        std::lock_guard<std::mutex> lock(resource_mutex_);
+        registered_resources_[resourceName] = std::move(pakResource);
     }
 
-    return false;
+    return pak;
 }
 
 nlohmann::json ResourceManager::ReadManifest(const std::string& manifestPath)
@@ -89,6 +229,25 @@ void ResourceManager::WriteManifest(const std::string& manifestPath, const nlohm
     }
 }
 
+static nlohmann::json ResourceFilesAsJson(const Resource& resource)
+{
+    nlohmann::json filesArray = nlohmann::json::array();
+
+    for (const auto& fileInfo : resource.files)
+    {
+        nlohmann::json fileJson = 
+        {
+            {"path", fileInfo.relativePath}, 
+            {"size", fileInfo.fileSize}, 
+            {"hash", fileInfo.fileHash}
+        };
+
+        filesArray.push_back(fileJson);
+    }
+
+    return filesArray;
+}
+
 nlohmann::json ResourceManager::GetManifestAsJson()
 {
     nlohmann::json rootJson = nlohmann::json::object();
@@ -96,24 +255,20 @@ nlohmann::json ResourceManager::GetManifestAsJson()
 
     for (const auto& resource_pair : registered_resources_)
     {
-        const std::string& resourceName = resource_pair.first;
-        const Resource& resourceData = resource_pair.second;
-        nlohmann::json filesArray = nlohmann::json::array();
+        rootJson[resource_pair.first] = ResourceFilesAsJson(resource_pair.second);
+    }
 
-        for (const auto& fileInfo : resourceData.files)
-        {
-            nlohmann::json fileJson = 
-            {
-                {"path", fileInfo.relativePath}, 
-                {"size", fileInfo.fileSize}, 
-                {"hash", fileInfo.fileHash}
-            };
+    return rootJson;
+}
 
-            filesArray.push_back(fileJson);
-        }
+nlohmann::json ResourceManager::GetManifestAsJson(const std::string& resourceName)
+{
+    nlohmann::json rootJson = nlohmann::json::object();
+    std::lock_guard<std::mutex> lock(resource_mutex_);
 
-        rootJson[resourceName] = filesArray;
-    }
+    auto it = registered_resources_.find(resourceName);
+    if (it != registered_resources_.end())
+        rootJson[resourceName] = ResourceFilesAsJson(it->second);
 
     return rootJson;
 }
@@ -133,7 +288,169 @@ bool ResourceManager::IsFileValid(const std::string& resourceName, const std::st
     return false;
 }
 
-bool ResourceManager::ProcessResourceDirectory(const std::string& resourceName, const std::vector<uint8_t>& encryption_key)
+bool ResourceManager::WriteZipPak(const std::string& pakPath, const std::vector<SourceFile>& files,
+    const std::vector<uint8_t>& encryption_key, PackStats& stats)
+{
+    mz_zip_archive zip_archive = {};
+    if (mz_zip_writer_init_file(&zip_archive, pakPath.c_str(), 0) == MZ_FALSE)
+        return false;
+
+    for (const auto& file : files)
+    {
+        const auto& path = file.path;
+        const auto& internalPath = file.internalPath;
+
+        std::vector<uint8_t> content;
+        if (!ReadWholeFile(path, content))
+            continue;
+
+        stats.raw_bytes += content.size();
+
+        const PakEntryCodec codec = CompressPakEntry(content, !IsPrecompressed(path));
+        const std::string comment = FormatPakEntryComment(codec);
+
+        if (codec.codec == PakCodec::Deflate)
+            ++stats.deflated_files;
+
+        std::array<uint8_t, 16> iv;
+        randombytes_buf(iv.data(), iv.size());
+
+        std::vector<uint8_t> final_data;
+        final_data.reserve(iv.size() + content.size() + AES_BLOCKLEN);
+        final_data.insert(final_data.end(), iv.begin(), iv.end());
+        final_data.insert(final_data.end(), content.begin(), content.end());
+        EncryptFileInPlace(final_data, iv.size(), encryption_key, iv);
+
+        stats.packed_bytes += final_data.size();
+
+        PackedFileStats file_stats;
+        file_stats.path = internalPath;
+        file_stats.size = content.size();
+        file_stats.stored_size = final_data.size();
+        file_stats.deflated = codec.codec == PakCodec::Deflate;
+        stats.files.push_back(std::move(file_stats));
+
+        // Ciphertext is incompressible, the zip only stores it.
+        if (mz_zip_writer_add_mem_ex(&zip_archive, internalPath.c_str(), final_data.data(), final_data.size(),
+                comment.empty() ? nullptr : comment.c_str(), static_cast<mz_uint16>(comment.size()), MZ_NO_COMPRESSION, 0, 0) == MZ_FALSE)
+        {
+            LOG_WARN("[ResourceManager] Failed to add '%s' to pak.", internalPath.c_str());
+        }
+    }
+
+    const bool finalized = mz_zip_writer_finalize_archive(&zip_archive) != MZ_FALSE;
+    mz_zip_writer_end(&zip_archive);
+
+    return finalized;
+}
+
+bool ResourceManager::WriteIndexedPak(const std::string& pakPath, const std::string& previousPakPath, const std::vector<SourceFile>& files,
+    const std::vector<uint8_t>& encryption_key, PackStats& stats)
+{
+    PakWriter writer(encryption_key, pak_cipher_);
+    if (!writer.IsValid())
+    {
+        LOG_ERROR("[ResourceManager] The master resource key cannot seal an indexed pak (%zu bytes, 16 to 64 required).", encryption_key.size());
+        return false;
+    }
+
+    // Entries of the current pak whose file did not change are copied as they are, without
+    // reading, compressing or encrypting the file again. Null if there is none or the key changed.
+    std::shared_ptr<const PakReader> previous;
+    if (!previousPakPath.empty())
+        previous = PakReader::Open(MappedFile::Open(previousPakPath), encryption_key);
+
+    std::vector<PakSealedEntry> sealed(files.size());
+    std::vector<char> added(files.size(), 0);
+
+    pool_->ParallelFor(files.size(), [&](size_t i) {
+        const SourceFile& file = files[i];
+
+        if (previous && !file.hash.empty())
+        {
+            const PakTocEntry* entry = previous->Find(file.internalPath);
+            if (entry && ToHexString(entry->hash, sizeof(entry->hash)) == file.hash)
+            {
+                sealed[i] = PakWriter::Reuse(*previous, *entry);
+                added[i] = 1;
+                return;
+            }
+        }
+
+        std::vector<uint8_t> content;
+        if (!ReadWholeFile(file.path, content))
+            return;
+
+        added[i] = writer.Seal(file.internalPath, std::move(content), !IsPrecompressed(file.path), sealed[i]) ? 1 : 0;
+    });
+
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (!added[i])
+        {
+            LOG_WARN("[ResourceManager] Failed to add '%s' to pak.", files[i].internalPath.c_str());
+            continue;
+        }
+
+        PackedFileStats file_stats;
+        file_stats.path = files[i].internalPath;
+        file_stats.size = sealed[i].entry.size;
+        file_stats.stored_size = sealed[i].entry.stored_size;
+        file_stats.deflated = static_cast<PakCodec>(sealed[i].entry.codec) == PakCodec::Deflate;
+        file_stats.reused = sealed[i].source != nullptr;
+
+        stats.raw_bytes += file_stats.size;
+        stats.reused_files += file_stats.reused ? 1 : 0;
+        stats.deflated_files += file_stats.deflated ? 1 : 0;
+        stats.files.push_back(std::move(file_stats));
+
+        writer.Add(std::move(sealed[i]));
+    }
+
+    stats.packed_bytes = writer.StoredBytes();
+    return writer.Write(pakPath);
+}
+
+bool ResourceManager::PublishCachedPak(const std::string& resourceName, const std::string& pakPath, const std::string& manifestPath,
+    nlohmann::json& manifest, bool manifestChanged)
+{
+    std::string known_pak_hash;
+    const auto& pak_info = manifest.contains(MANIFEST_PAK_KEY) ? manifest[MANIFEST_PAK_KEY] : nlohmann::json();
+
+    std::error_code stat_error;
+    const uint64_t pak_size = std::filesystem::file_size(pakPath, stat_error);
+    const int64_t pak_modified = stat_error ? 0 : ModifiedSeconds(std::filesystem::last_write_time(pakPath, stat_error));
+
+    if (!stat_error && pak_info.is_object() && pak_info.value("size", uint64_t(0)) == pak_size && pak_info.value("modified", int64_t(0)) == pak_modified)
+        known_pak_hash = pak_info.value("hash", std::string());
+
+    auto pak = PublishPak(resourceName, pakPath, known_pak_hash);
+    if (!pak)
+        return false;
+
+    if (known_pak_hash.empty() && !stat_error)
+    {
+        if (pak_info.is_object() && pak_info.contains("hash") && pak_info.value("hash", std::string()) != pak->hash)
+            LOG_WARN("[ResourceManager] Pak '%s' does not match the hash in its manifest.", pakPath.c_str());
+
+        nlohmann::json recorded = {{"hash", pak->hash}, {"size", pak_size}};
+        if (record_modified_times_)
+            recorded["modified"] = pak_modified;
+
+        if (recorded != pak_info)
+        {
+            manifest[MANIFEST_PAK_KEY] = std::move(recorded);
+            manifestChanged = true;
+        }
+    }
+
+    if (manifestChanged)
+        WriteManifest(manifestPath, manifest);
+
+    return true;
+}
+
+bool ResourceManager::ProcessResourceDirectory(const std::string& resourceName, const std::vector<uint8_t>& encryption_key, PackStats& stats)
 {
     try
     {
@@ -143,25 +460,43 @@ bool ResourceManager::ProcessResourceDirectory(const std::string& resourceName,
             return false;
         }
 
-        std::string basePath = "scriptfiles/cef/" + resourceName;
+        std::string basePath = source_root_ + "/" + resourceName;
+        std::string pakPath = output_root_ + "/" + resourceName + ".pak";
+        std::string manifestPath = pakPath + ".manifest";
+        nlohmann::json manifest_data = ReadManifest(manifestPath);
+        const int pak_layout = !indexed_pak_ ? PAK_LAYOUT_ZIP
+            : pak_cipher_ == PakCipher::Aes256Gcm ? PAK_LAYOUT_INDEXED_AES256GCM : PAK_LAYOUT_INDEXED;
+
         if (!std::filesystem::is_directory(basePath))
         {
+            // Built offline by cef-pack, only the pak and its manifest are deployed.
+            if (manifest_data.is_object() && manifest_data.value(MANIFEST_FORMAT_KEY, 0) == pak_layout && std::filesystem::exists(pakPath))
+            {
+                if (!PublishCachedPak(resourceName, pakPath, manifestPath, manifest_data, false))
+                    return false;
+
+                stats.up_to_date = true;
+                LOG_INFO("[ResourceManager] Resource '%s' loaded from prebuilt pak '%s'.", resourceName.c_str(), pakPath.c_str());
+                return true;
+            }
+
             LOG_ERROR("[ResourceManager] Resource directory not found: %s", basePath.c_str());
             return false;
         }
 
         std::string basePath_u8 = std::filesystem::path(basePath).generic_u8string();
 
-        std::string pakPath = "scriptfiles/cef/" + resourceName + ".pak";
-        std::string manifestPath = pakPath + ".manifest";
-        nlohmann::json manifest_data = ReadManifest(manifestPath);
         nlohmann::json new_manifest_data = nlohmann::json::object();
+        new_manifest_data[MANIFEST_FORMAT_KEY] = pak_layout;
 
         bool needs_recompilation = false;
+        bool needs_full_rebuild = false;
 
-        if (manifest_data.is_null() || !std::filesystem::exists(pakPath))
+        if (manifest_data.is_null() || !manifest_data.is_object() || !std::filesystem::exists(pakPath) ||
+            manifest_data.value(MANIFEST_FORMAT_KEY, 0) != pak_layout)
         {
             needs_recompilation = true;
+            needs_full_rebuild = true;
             LOG_DEBUG("[ResourceManager] No valid .pak or manifest found for '%s', forcing recompilation.", resourceName.c_str());
         }
         else
@@ -193,8 +528,7 @@ bool ResourceManager::ProcessResourceDirectory(const std::string& resourceName,
             ".eot"
         };
 
-        std::vector<std::pair<std::filesystem::path, std::string>> files_to_pack;
-        size_t current_file_count = 0;
+        std::vector<SourceFile> files_to_pack;
 
         for (const auto& entry : std::filesystem::recursive_directory_iterator(basePath))
         {
@@ -204,105 +538,109 @@ bool ResourceManager::ProcessResourceDirectory(const std::string& resourceName,
             std::string extension = entry.path().extension().string();
             std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
 
-            if (entry.file_size() > MAX_FILE_SIZE || ALLOWED_EXTENSIONS.find(extension) == ALLOWED_EXTENSIONS.end())
+            const uint64_t file_size = entry.file_size();
+            if (file_size > MAX_FILE_SIZE || ALLOWED_EXTENSIONS.find(extension) == ALLOWED_EXTENSIONS.end())
             {
                 continue;
             }
 
-            current_file_count++;
+            SourceFile file;
+            file.path = entry.path();
+            file.internalPath = entry.path().generic_u8string().substr(basePath_u8.length() + 1);
+            file.size = file_size;
+            file.modified = ModifiedSeconds(entry.last_write_time());
+
+            // Same size and mtime as when the manifest was written: trust its hash
+            // instead of reading the file.
+            if (manifest_data.is_object() && manifest_data.contains(file.internalPath))
+            {
+                const auto& known = manifest_data[file.internalPath];
+                if (known.is_object() && known.value("size", uint64_t(0)) == file.size && known.value("modified", int64_t(0)) == file.modified)
+                    file.hash = known.value("hash", std::string());
+            }
+
+            files_to_pack.push_back(std::move(file));
+        }
 
-            std::string full_path_str = entry.path().generic_u8string();
-            std::string internalPath = full_path_str.substr(basePath_u8.length() + 1);
+        // Only files whose size or mtime moved are hashed, on every worker.
+        std::atomic<size_t> hashed_files{ 0 };
+        pool_->ParallelFor(files_to_pack.size(), [&](size_t i) {
+            if (!files_to_pack[i].hash.empty())
+                return;
 
-            files_to_pack.emplace_back(entry.path(), internalPath);
+            files_to_pack[i].hash = CalculateSHA256(files_to_pack[i].path.string());
+            hashed_files.fetch_add(1, std::memory_order_relaxed);
+        });
 
-            auto last_write_time =
-                std::chrono::duration_cast<std::chrono::seconds>(entry.last_write_time().time_since_epoch()).count();
-            std::string file_hash = CalculateSHA256(entry.path().string());
-            new_manifest_data[internalPath] = {{"hash", file_hash}, {"modified", last_write_time}};
+        for (const auto& file : files_to_pack)
+        {
+            new_manifest_data[file.internalPath] = {{"hash", file.hash}, {"size", file.size}};
+            if (record_modified_times_)
+                new_manifest_data[file.internalPath]["modified"] = file.modified;
 
             if (!needs_recompilation)
             {
-                if (!manifest_data.contains(internalPath) || manifest_data[internalPath]["hash"] != file_hash ||
-                    manifest_data[internalPath]["modified"] != last_write_time)
+                if (!manifest_data.contains(file.internalPath) || manifest_data[file.internalPath].value("hash", std::string()) != file.hash)
                 {
                     needs_recompilation = true;
-                    LOG_DEBUG("[ResourceManager] Change detected in '%s', recompilation needed.", internalPath.c_str());
+                    LOG_DEBUG("[ResourceManager] Change detected in '%s', recompilation needed.", file.internalPath.c_str());
                 }
             }
         }
 
-        if (!needs_recompilation && manifest_data.size() != current_file_count)
+        const size_t previous_file_count = manifest_data.is_object() ? CountManifestFiles(manifest_data) : 0;
+        if (!needs_recompilation && previous_file_count != files_to_pack.size())
         {
             needs_recompilation = true;
-            LOG_DEBUG("[ResourceManager] File count mismatch (old: %zu, new: %zu), recompilation needed.", manifest_data.size(), current_file_count);
+            LOG_DEBUG("[ResourceManager] File count mismatch (old: %zu, new: %zu), recompilation needed.", previous_file_count, files_to_pack.size());
         }
 
         if (!needs_recompilation)
         {
-            FileInfo pakInfo;
-            pakInfo.relativePath = resourceName + ".pak";
-            pakInfo.fileSize = std::filesystem::file_size(pakPath);
-            pakInfo.fileHash = CalculateSHA256(pakPath);
-
-            Resource pakResource;
-            pakResource.name = resourceName;
-            pakResource.files.push_back(pakInfo);
-            pakResource.totalSize = pakInfo.fileSize;
-
+            // Refreshes the mtimes of files touched without being changed.
+            const bool refreshed = hashed_files.load() != 0 && record_modified_times_;
+            if (refreshed)
             {
-                std::lock_guard<std::mutex> lock(resource_mutex_);
-                registered_resources_[resourceName] = pakResource;
+                if (manifest_data.contains(MANIFEST_PAK_KEY))
+                    new_manifest_data[MANIFEST_PAK_KEY] = manifest_data[MANIFEST_PAK_KEY];
+
+                manifest_data = std::move(new_manifest_data);
             }
 
+            if (!PublishCachedPak(resourceName, pakPath, manifestPath, manifest_data, refreshed))
+                return false;
+
+            stats.up_to_date = true;
             LOG_INFO("[ResourceManager] Resource '%s' is up-to-date. Loaded from cache.", resourceName.c_str());
             return true;
         }
 
         LOG_INFO("[ResourceManager] Packing and encrypting resource '%s' with master key...", resourceName.c_str());
 
-        mz_zip_archive zip_archive = {};
-        if (mz_zip_writer_init_file(&zip_archive, pakPath.c_str(), 0) == MZ_FALSE)
-        {
-            LOG_ERROR("[ResourceManager] Could not create pak file at %s.", pakPath.c_str());
-            return false;
-        }
-
-        for (const auto& file_pair : files_to_pack)
-        {
-            const auto& path = file_pair.first;
-            const auto& internalPath = file_pair.second;
-
-            std::ifstream file(path, std::ios::binary);
-            if (!file.is_open())
-                continue;
-
-            std::vector<uint8_t> content((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
-            file.close();
+        const auto pack_start = std::chrono::steady_clock::now();
 
-            std::array<uint8_t, 16> iv;
-            randombytes_buf(iv.data(), iv.size());
+        // Built next to the live pak and renamed over it: transfers in progress keep
+        // reading the old file through their mapping.
+        std::string tempPakPath = pakPath + ".tmp";
 
-            std::vector<uint8_t> encrypted_content = EncryptFile(content, encryption_key, iv);
+        const bool written = indexed_pak_
+            ? WriteIndexedPak(tempPakPath, needs_full_rebuild ? std::string() : pakPath, files_to_pack, encryption_key, stats)
+            : WriteZipPak(tempPakPath, files_to_pack, encryption_key, stats);
 
-            std::vector<uint8_t> final_data;
-            final_data.reserve(iv.size() + encrypted_content.size());
-            final_data.insert(final_data.end(), iv.begin(), iv.end());
-            final_data.insert(final_data.end(), encrypted_content.begin(), encrypted_content.end());
+        if (!written)
+        {
+            LOG_ERROR("[ResourceManager] Could not create pak file at %s.", tempPakPath.c_str());
 
-            if (mz_zip_writer_add_mem(&zip_archive, internalPath.c_str(), reinterpret_cast<const char*>(final_data.data()), final_data.size(), MZ_DEFAULT_COMPRESSION) == MZ_FALSE)
-            {
-                LOG_WARN("[ResourceManager] Failed to add '%s' to pak.", internalPath.c_str());
-            }
+            std::error_code remove_error;
+            std::filesystem::remove(tempPakPath, remove_error);
+            return false;
         }
 
-        mz_zip_writer_finalize_archive(&zip_archive);
-        mz_zip_writer_end(&zip_archive);
-
         if (files_to_pack.empty())
         {
             LOG_WARN("[ResourceManager] No valid files found for resource '%s'. Pak file will be empty.", resourceName.c_str());
 
+            std::filesystem::remove(tempPakPath);
             std::filesystem::remove(pakPath);
             if (std::filesystem::exists(manifestPath))
                 std::filesystem::remove(manifestPath);
@@ -310,25 +648,35 @@ bool ResourceManager::ProcessResourceDirectory(const std::string& resourceName,
             return false;
         }
 
-        WriteManifest(manifestPath, new_manifest_data);
+        std::error_code rename_error;
+        std::filesystem::rename(tempPakPath, pakPath, rename_error);
+        if (rename_error)
+        {
+            LOG_ERROR("[ResourceManager] Could not replace pak file at %s: %s", pakPath.c_str(), rename_error.message().c_str());
+            std::filesystem::remove(tempPakPath, rename_error);
+            return false;
+        }
+
+        auto pak = PublishPak(resourceName, pakPath);
+        if (!pak)
+            return false;
 
-        FileInfo pakInfo;
-        pakInfo.relativePath = resourceName + ".pak";
-        pakInfo.fileSize = std::filesystem::file_size(pakPath);
-        pakInfo.fileHash = CalculateSHA256(pakPath);
+        new_manifest_data[MANIFEST_PAK_KEY] = {{"hash", pak->hash}, {"size", pak->Size()}};
 
-        Resource pakResource;
-        pakResource.name = resourceName;
-        pakResource.files.push_back(pakInfo);
-        pakResource.totalSize = pakInfo.fileSize;
+        std::error_code stat_error;
+        const int64_t pak_modified = ModifiedSeconds(std::filesystem::last_write_time(pakPath, stat_error));
+        if (!stat_error && record_modified_times_)
+            new_manifest_data[MANIFEST_PAK_KEY]["modified"] = pak_modified;
 
-        {
-            std::lock_guard<std::mutex> lock(resource_mutex_);
-            registered_resources_[resourceName] = pakResource;
-        }
+        WriteManifest(manifestPath, new_manifest_data);
+
+        const auto pack_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - pack_start).count();
+        stats.elapsed_ms = static_cast<uint64_t>(pack_ms);
 
-        std::string formattedSize = FormatBytes(pakResource.totalSize);
+        std::string formattedSize = FormatBytes(pak->Size());
         LOG_INFO("[ResourceManager] Resource '%s' successfully packed to '%s' (%zu files, %s).", resourceName.c_str(), pakPath.c_str(), files_to_pack.size(), formattedSize.c_str());
+        LOG_INFO("[ResourceManager] Compressed %zu of %zu files, %s -> %s in %lld ms (%zu unchanged entries reused).", stats.deflated_files, files_to_pack.size(),
+            FormatBytes(stats.raw_bytes).c_str(), FormatBytes(stats.packed_bytes).c_str(), static_cast<long long>(pack_ms), stats.reused_files);
 
         return true;
     }
@@ -1,12 +1,21 @@
 #pragma once
 
 #include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
+#include <set>
 #include <string>
 #include <vector>
 
+#include <shared/mapped-file.hpp>
+
+class ThreadPool;
+enum class PakCipher : uint8_t;
+
 struct FileInfo
 {
     std::string relativePath;
@@ -14,34 +23,135 @@ struct FileInfo
     std::string fileHash;
 };
 
+// A packed resource as sent to clients. Immutable once published: every transfer of the
+// resource holds a reference to the same mapping, and the hash is computed once when the
+// pak is (re)built or loaded.
+struct PakFile
+{
+    std::string resourceName;
+    std::string hash;
+    std::shared_ptr<const MappedFile> mapping;
+
+    const uint8_t* Data() const { return mapping->Data(); }
+    size_t Size() const { return mapping->Size(); }
+};
+
 struct Resource
 {
     std::string name;
     std::vector<FileInfo> files;
     uint64_t totalSize = 0;
+    std::shared_ptr<const PakFile> pak;
+};
+
+struct PackedFileStats
+{
+    std::string path;
+    uint64_t size = 0;
+    uint64_t stored_size = 0; // in the pak, after compression and encryption
+    bool deflated = false;
+    bool reused = false;      // copied from the previous pak
+};
+
+struct PackStats
+{
+    uint64_t raw_bytes = 0;
+    uint64_t packed_bytes = 0;
+    size_t deflated_files = 0;
+    size_t reused_files = 0;
+    uint64_t elapsed_ms = 0;
+    bool up_to_date = false;  // nothing changed, the existing pak was kept
+    std::vector<PackedFileStats> files;
 };
 
 class ResourceManager
 {
 public:
-    ResourceManager() = default;
-    ~ResourceManager() = default;
+    // `threads` sizes the packing pool, 0 uses one per hardware thread.
+    explicit ResourceManager(size_t threads = 0);
+    ~ResourceManager();
 
     ResourceManager(const ResourceManager&) = delete;
     ResourceManager& operator=(const ResourceManager&) = delete;
-    void AddResource(const std::string& resourceName, const std::vector<uint8_t>& master_key);
 
-    bool GetPakContent(const std::string& resourceName, std::vector<uint8_t>& outContent) const;
+    // Called on a pool thread once a resource queued by AddResourceAsync is published
+    // (or failed to pack). The resource is no longer pending by then.
+    using ReadyCallback = std::function<void(const std::string& resourceName, bool success)>;
+
+    // Packs (or validates) and publishes the resource on the calling thread. `stats` is
+    // filled when given, cef-pack reports from it.
+    bool AddResource(const std::string& resourceName, const std::vector<uint8_t>& master_key, PackStats* stats = nullptr);
+
+    // Packs the resource on the worker pool. A resource already being packed is not queued again.
+    void AddResourceAsync(const std::string& resourceName, const std::vector<uint8_t>& master_key, ReadyCallback on_ready);
+
+    bool IsResourceReady(const std::string& resourceName) const;
+    bool HasPendingResources() const;
+
+    // Build indexed paks (shared/pak-format.hpp) instead of zip ones. Set before adding resources.
+    void SetIndexedPak(bool indexed) { indexed_pak_ = indexed; }
+
+    // Cipher for new indexed pak entries, falls back to XChaCha20-Poly1305 without AES-NI.
+    // Changing it rebuilds existing paks. Set before adding resources.
+    void SetPakCipher(PakCipher cipher);
+
+    // Resources are read from `source_root`/<name>, paks and manifests written to
+    // `output_root`. Both default to scriptfiles/cef.
+    void SetResourceDirectories(const std::string& source_root, const std::string& output_root)
+    {
+        source_root_ = source_root;
+        output_root_ = output_root;
+    }
+
+    // Off leaves file and pak mtimes out of the manifest, so it only depends on the content
+    // (reproducible builds). The server then checks hashes once and records them itself.
+    void SetRecordModifiedTimes(bool record) { record_modified_times_ = record; }
+
+    std::shared_ptr<const PakFile> GetPak(const std::string& resourceName) const;
     nlohmann::json GetManifestAsJson();
+    // Same layout as GetManifestAsJson, restricted to one resource (empty if not published).
+    nlohmann::json GetManifestAsJson(const std::string& resourceName);
     bool IsFileValid(const std::string& resourceName, const std::string& relativePath) const;
 
 private:
     nlohmann::json ReadManifest(const std::string& manifestPath);
     void WriteManifest(const std::string& manifestPath, const nlohmann::json& data);
 
-    bool ProcessResourceDirectory(const std::string& resourceName, const std::vector<uint8_t>& encryption_key);
+    bool ProcessResourceDirectory(const std::string& resourceName, const std::vector<uint8_t>& encryption_key, PackStats& stats);
+    // `knownHash` skips hashing the pak when the manifest already recorded it.
+    std::shared_ptr<const PakFile> PublishPak(const std::string& resourceName, const std::string& pakPath, const std::string& knownHash = {});
+    // Publishes an existing pak, trusting the hash in `manifest` while its size and mtime
+    // match. Records them otherwise, `manifest` is written back when anything changed.
+    bool PublishCachedPak(const std::string& resourceName, const std::string& pakPath, const std::string& manifestPath,
+        nlohmann::json& manifest, bool manifestChanged);
+
+    struct SourceFile
+    {
+        std::filesystem::path path;
+        std::string internalPath;
+        uint64_t size = 0;
+        int64_t modified = 0;
+        std::string hash; // empty until hashed, see ProcessResourceDirectory
+    };
+
+    bool WriteZipPak(const std::string& pakPath, const std::vector<SourceFile>& files,
+        const std::vector<uint8_t>& encryption_key, PackStats& stats);
+    // Entries whose file hash matches in `previousPakPath` (empty for none) are copied over.
+    bool WriteIndexedPak(const std::string& pakPath, const std::string& previousPakPath, const std::vector<SourceFile>& files,
+        const std::vector<uint8_t>& encryption_key, PackStats& stats);
 
 private:
     std::map<std::string, Resource> registered_resources_;
+    std::set<std::string> pending_resources_;
     mutable std::mutex resource_mutex_;
+
+    bool indexed_pak_ = true;
+    PakCipher pak_cipher_{}; // XChaCha20Poly1305
+    bool record_modified_times_ = true;
+    std::string source_root_ = "scriptfiles/cef";
+    std::string output_root_ = "scriptfiles/cef";
+
+    // Packs queued resources, and hashes and seals their files in parallel. Declared last:
+    // destroying it waits for packing in progress, which still uses the members above.
+    std::unique_ptr<ThreadPool> pool_;
 };
\ No newline at end of file
@@ -6,10 +6,79 @@ int kcp_output_callback(const char* buf, int len, ikcpcb* /*kcp*/, void* user)
 	if (!session || !session->send_fn)
 		return -1;
 
+	const uint32_t segments = session->retransmits.OnOutput(buf, len);
+
+	if (auto* stats = session->output_stats) {
+		stats->datagrams.fetch_add(1, std::memory_order_relaxed);
+		stats->segments.fetch_add(segments, std::memory_order_relaxed);
+		stats->bytes.fetch_add(static_cast<uint64_t>(len), std::memory_order_relaxed);
+	}
+
 	session->send_fn(session->address, buf, len);
 	return 0;
 }
 
+EndpointKey EndpointKey::From(const asio::ip::udp::endpoint& endpoint)
+{
+	EndpointKey key;
+	key.port = endpoint.port();
+
+	const asio::ip::address address = endpoint.address();
+	if (address.is_v4()) {
+		key.lo = 0x0000ffff00000000ull | address.to_v4().to_uint();
+		return key;
+	}
+
+	const auto bytes = address.to_v6().to_bytes();
+	for (size_t i = 0; i < 8; ++i) {
+		key.hi = (key.hi << 8) | bytes[i];
+		key.lo = (key.lo << 8) | bytes[i + 8];
+	}
+
+	return key;
+}
+
+uint64_t EndpointKey::Hash() const
+{
+	// splitmix64 finaliser over the folded key.
+	uint64_t h = hi ^ (lo * 0x9e3779b97f4a7c15ull) ^ (static_cast<uint64_t>(port) << 32);
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+	return h ^ (h >> 31);
+}
+
+void EndpointTable::Insert(const EndpointKey& key, int playerid)
+{
+	for (size_t i = key.Hash() & (SLOTS - 1);; i = (i + 1) & (SLOTS - 1)) {
+		if (entries[i].playerid == -1 || entries[i].key == key) {
+			entries[i].key = key;
+			entries[i].playerid = static_cast<int16_t>(playerid);
+			return;
+		}
+	}
+}
+
+int EndpointTable::Find(const EndpointKey& key) const
+{
+	for (size_t i = key.Hash() & (SLOTS - 1);; i = (i + 1) & (SLOTS - 1)) {
+		if (entries[i].playerid == -1)
+			return -1;
+
+		if (entries[i].key == key)
+			return entries[i].playerid;
+	}
+}
+
+static bool IsValidPlayer(int playerid)
+{
+	return playerid >= 0 && playerid < MAX_SESSIONS;
+}
+
+NetworkSessionManager::NetworkSessionManager()
+	: endpoints_(std::make_shared<EndpointTable>())
+{
+}
+
 void NetworkSessionManager::SetSender(std::function<void(const asio::ip::udp::endpoint&, const char*, int)> fn)
 {
 	std::lock_guard<std::mutex> lock(mutex_);
@@ -18,136 +87,110 @@ void NetworkSessionManager::SetSender(std::function<void(const asio::ip::udp::en
 
 void NetworkSessionManager::RegisterPlayer(int playerid)
 {
-	std::lock_guard<std::mutex> lock(mutex_);
-	if (player_sessions_.find(playerid) == player_sessions_.end())
-	{
-		auto session = std::make_shared<NetworkSession>();
+	if (!IsValidPlayer(playerid))
+		return;
 
-		session->playerid = playerid;
-		session->send_fn = send_fn_;
-
-		player_sessions_[playerid] = session;
-	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!sessions_[playerid])
+		CreateSessionLocked(playerid);
 }
 
 void NetworkSessionManager::RemovePlayer(int playerid)
 {
+    if (!IsValidPlayer(playerid))
+        return;
+
     std::lock_guard<std::mutex> lock(mutex_);
 
-    auto it = player_sessions_.find(playerid);
-    if (it != player_sessions_.end()) {
-        if (it->second->handshake_status != HandshakeStatus::NONE) {
-            UnmapAddress(it->second->address);
+    auto session = sessions_[playerid];
+    if (session) {
+        if (player_endpoints_[playerid]) {
+            player_endpoints_[playerid].reset();
+            PublishEndpointsLocked();
         }
 
-        if (it->second->kcp_instance) {
-            ikcp_release(it->second->kcp_instance);
-            it->second->kcp_instance = nullptr;
-        }
+        std::atomic_store(&sessions_[playerid], std::shared_ptr<NetworkSession>());
 
-        player_sessions_.erase(it);
+        // Readers may still hold the session, release KCP under its lock.
+        std::lock_guard<std::mutex> kcp_lock(session->kcp_mutex);
+        if (session->kcp_instance) {
+            ikcp_release(session->kcp_instance);
+            session->kcp_instance = nullptr;
+        }
     }
+
+    std::lock_guard<std::mutex> wheel_lock(wheel_mutex_);
+    kcp_wheel_.Cancel(playerid);
 }
 
-/*void NetworkSessionManager::UpdateAllKcpInstances(uint32_t now_ms)
+void NetworkSessionManager::ScheduleKcpUpdate(int playerid, uint32_t due_ms)
 {
-	std::lock_guard<std::mutex> lock(mutex_);
-
-	for (auto& [playerid, session] : player_sessions_) {
-		if (session && session->kcp_instance &&
-			session->handshake_status == HandshakeStatus::CONNECTED) {
-			ikcp_update(session->kcp_instance, now_ms);
-		}
-	}
-}*/
+    std::lock_guard<std::mutex> lock(wheel_mutex_);
+    kcp_wheel_.Schedule(playerid, due_ms);
+}
 
-void NetworkSessionManager::UpdateAllKcpInstances(uint32_t now_ms)
+void NetworkSessionManager::CollectDueSessions(uint32_t now_ms, std::vector<std::shared_ptr<NetworkSession>>& due)
 {
-    std::vector<std::shared_ptr<NetworkSession>> sessions;
+    due.clear();
+    due_ids_.clear();
 
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        sessions.reserve(player_sessions_.size());
-
-        for (auto& [playerid, session] : player_sessions_) {
-            if (session && session->kcp_instance &&
-                session->handshake_status == HandshakeStatus::CONNECTED) {
-                sessions.push_back(session);
-            }
-        }
+        std::lock_guard<std::mutex> lock(wheel_mutex_);
+        kcp_wheel_.Advance(now_ms, due_ids_);
     }
 
-    for (auto& session : sessions) {
-        std::lock_guard<std::mutex> lock(session->kcp_mutex);
-        if (session->kcp_instance &&
+    for (int playerid : due_ids_) {
+        auto session = std::atomic_load(&sessions_[playerid]);
+        if (session && session->kcp_instance &&
             session->handshake_status == HandshakeStatus::CONNECTED) {
-            ikcp_update(session->kcp_instance, now_ms);
+            due.push_back(std::move(session));
         }
     }
 }
 
 std::shared_ptr<NetworkSession> NetworkSessionManager::GetOrCreateSession(int playerid)
 {
-	std::lock_guard<std::mutex> lock(mutex_);
-
-	auto it = player_sessions_.find(playerid);
-	if (it == player_sessions_.end())
-	{
-		auto session = std::make_shared<NetworkSession>();
+	if (!IsValidPlayer(playerid))
+		return nullptr;
 
-		session->playerid = playerid;
-		session->send_fn = send_fn_;
+	if (auto session = std::atomic_load(&sessions_[playerid]))
+		return session;
 
-		player_sessions_[playerid] = session;
+	std::lock_guard<std::mutex> lock(mutex_);
 
-		return session;
-	}
+	if (sessions_[playerid])
+		return sessions_[playerid];
 
-	return it->second;
+	return CreateSessionLocked(playerid);
 }
 
 std::shared_ptr<NetworkSession> NetworkSessionManager::GetSessionFromAddress(const asio::ip::udp::endpoint& addr)
 {
-	std::lock_guard<std::mutex> lock(mutex_);
-
-	auto it_pid = addr_str_to_playerid_.find(EndpointToStr(addr));
-	if (it_pid != addr_str_to_playerid_.end())
-	{
-		int playerid = it_pid->second;
-		auto it_session = player_sessions_.find(playerid);
-		if (it_session != player_sessions_.end())
-		{
-			return it_session->second;
-		}
-	}
+	const int playerid = std::atomic_load(&endpoints_)->Find(EndpointKey::From(addr));
+	if (playerid < 0)
+		return nullptr;
 
-	return nullptr;
+	return std::atomic_load(&sessions_[playerid]);
 }
 
-std::shared_ptr<NetworkSession> NetworkSessionManager::GetSession(int playerid)
+std::shared_ptr<NetworkSession> NetworkSessionManager::GetSession(int playerid) const
 {
-	std::lock_guard<std::mutex> lock(mutex_);
+	if (!IsValidPlayer(playerid))
+		return nullptr;
 
-	auto it = player_sessions_.find(playerid);
-	if (it != player_sessions_.end()) {
-		return it->second;
-	}
-
-	return nullptr;
+	return std::atomic_load(&sessions_[playerid]);
 }
 
 std::vector<std::shared_ptr<NetworkSession>> NetworkSessionManager::GetAllSessions()
 {
-	std::lock_guard<std::mutex> lock(mutex_);
-
 	std::vector<std::shared_ptr<NetworkSession>> result;
-	result.reserve(player_sessions_.size());
 
-	for (const auto& [playerid, session] : player_sessions_)
+	for (const auto& slot : sessions_)
 	{
+		auto session = std::atomic_load(&slot);
 		if (session && session->handshake_complete)
 		{
-			result.push_back(session);
+			result.push_back(std::move(session));
 		}
 	}
 
@@ -156,38 +199,48 @@ std::vector<std::shared_ptr<NetworkSession>> NetworkSessionManager::GetAllSessio
 
 bool NetworkSessionManager::HasPlayerPlugin(int playerid) const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-
-	auto it = player_sessions_.find(playerid);
-    if (it != player_sessions_.end()) {
-		return it->second->handshake_complete;
-    }
-
-    return false;
+	auto session = GetSession(playerid);
+	return session && session->handshake_complete;
 }
 
 void NetworkSessionManager::MapAddressToPlayer(int playerid, const asio::ip::udp::endpoint& addr)
 {
+	if (!IsValidPlayer(playerid))
+		return;
+
 	std::lock_guard<std::mutex> lock(mutex_);
-	addr_str_to_playerid_[EndpointToStr(addr)] = playerid;
+	player_endpoints_[playerid] = EndpointKey::From(addr);
+	PublishEndpointsLocked();
 }
 
 void NetworkSessionManager::SetDownloadPaused(int playerid, bool paused) 
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    auto it = player_sessions_.find(playerid);
-    if (it != player_sessions_.end()) {
-        it->second->is_download_paused = paused;
+    if (auto session = GetSession(playerid)) {
+        session->is_download_paused = paused;
     }
 }
 
-void NetworkSessionManager::UnmapAddress(const asio::ip::udp::endpoint& addr)
+std::shared_ptr<NetworkSession> NetworkSessionManager::CreateSessionLocked(int playerid)
 {
-    addr_str_to_playerid_.erase(EndpointToStr(addr));
+	auto session = std::make_shared<NetworkSession>();
+
+	session->playerid = playerid;
+	session->send_fn = send_fn_;
+	session->output_stats = &output_stats_;
+
+	std::atomic_store(&sessions_[playerid], session);
+
+	return session;
 }
 
-std::string NetworkSessionManager::EndpointToStr(const asio::ip::udp::endpoint& addr) const
+void NetworkSessionManager::PublishEndpointsLocked()
 {
-	return addr.address().to_string() + ":" + std::to_string(addr.port());
+	auto table = std::make_shared<EndpointTable>();
+
+	for (int playerid = 0; playerid < MAX_SESSIONS; ++playerid) {
+		if (player_endpoints_[playerid])
+			table->Insert(*player_endpoints_[playerid], playerid);
+	}
+
+	std::atomic_store(&endpoints_, std::shared_ptr<const EndpointTable>(std::move(table)));
 }
@@ -1,7 +1,8 @@
 #pragma once
 
+#include <array>
+#include <optional>
 #include <string>
-#include <unordered_map>
 #include <mutex>
 #include <queue>
 #include <vector>
@@ -9,8 +10,24 @@
 #include <memory>
 #include <asio.hpp>
 #include <kcp/ikcp.h>
+#include <shared/crypto.hpp>
 
-constexpr size_t FILE_CHUNK_SIZE = 1200;
+#include "chunk_sizer.hpp"
+#include "logger.hpp"
+#include "resource_manager.hpp"
+#include "shared/packet-serializer.hpp"
+#include "timer_wheel.hpp"
+
+// What a file chunk message adds to its data: the FileChunk header (type, transfer id,
+// offset), batch framing and encryption. Chunks are sized by ChunkSizer to fill segments.
+constexpr size_t FILE_CHUNK_MESSAGE_OVERHEAD = sizeof(PacketType) + sizeof(uint8_t) + sizeof(uint32_t)
+	+ BATCH_HEADER_SIZE + BATCH_ENTRY_OVERHEAD + SESSION_OVERHEAD;
+
+// Player ids are below this on both open.mp and SA-MP, sessions are keyed by them.
+constexpr int MAX_SESSIONS = 1000;
+
+// IPv4 + UDP headers, paid once per datagram.
+constexpr size_t UDP_IP_OVERHEAD = 28;
 
 int kcp_output_callback(const char* buf, int len, ikcpcb* kcp, void* user);
 
@@ -21,14 +38,35 @@ enum class HandshakeStatus : uint8_t
 	CONNECTED
 };
 
+// Announced once with FileTransferBegin, then sent as FileChunk packets carrying only `id`.
 struct FileTransfer
 {
 	std::string resourceName;
 	std::string relativePath;
 	std::string fileHash;
-	std::vector<uint8_t> content;
-	uint32_t totalChunks = 0;
-	uint32_t currentChunkIndex = 0;
+	std::shared_ptr<const PakFile> pak; // shared with every other transfer of the resource
+	uint8_t id = 0;
+	bool begun = false;
+	uint32_t size = 0;
+	uint32_t offset = 0; // next byte to send
+};
+
+// Packets queued for the next encrypted KCP message, see CefPlugin::SendPacketToSession.
+struct OutboundBatch
+{
+	std::vector<uint8_t> frame;
+	uint32_t packets = 0;
+	uint32_t opened_ms = 0;
+	bool flush_immediately = false;
+};
+
+// What KCP actually put on the wire. Each datagram can carry several segments,
+// every segment beyond the first is a datagram saved by not flushing per message.
+struct KcpOutputStats
+{
+	std::atomic<uint64_t> datagrams{ 0 };
+	std::atomic<uint64_t> segments{ 0 };
+	std::atomic<uint64_t> bytes{ 0 };
 };
 
 struct NetworkSession
@@ -41,23 +79,68 @@ struct NetworkSession
 	bool handshake_complete = false;
 	bool cef_init_notified = false;
 	bool cef_success = false;
-
-	std::vector<uint8_t> rx_key;
-	std::vector<uint8_t> tx_key;
+	bool cef_ready_notified = false; // later downloads (manifest updates) do not repeat OnCefReady
+	bool join_deferred = false; // network thread, join response held until resources are packed
 
 	std::function<void(const asio::ip::udp::endpoint&, const char*, int)> send_fn;
+	KcpOutputStats* output_stats = nullptr;
 
 	std::queue<std::shared_ptr<FileTransfer>> download_queue;
 	std::shared_ptr<FileTransfer> current_transfer = nullptr;
+	uint8_t next_transfer_id = 0; // network thread, wraps at MAX_FILE_TRANSFERS
+	ChunkSizer chunk_sizer;       // network thread
+	RetransmitCounter retransmits; // guarded by kcp_mutex, fed by kcp_output_callback
 	std::atomic<bool> is_download_paused{false};
 
+	// Number of CefPlugin event table entries already sent to this client.
+	std::atomic<size_t> event_table_synced{0};
+
 	std::mutex kcp_mutex;
+	OutboundBatch outbound_batch; // guarded by kcp_mutex
+	SessionCipher cipher;         // guarded by kcp_mutex
+
+	ReceiveContext receive; // network thread only, see CefPlugin::HandleKcpInput
+};
+
+// IPv4 addresses are stored v4-mapped (::ffff:a.b.c.d) so both families share one key.
+struct EndpointKey
+{
+	uint64_t hi = 0;
+	uint64_t lo = 0;
+	uint32_t port = 0;
+
+	static EndpointKey From(const asio::ip::udp::endpoint& endpoint);
+	uint64_t Hash() const;
+
+	bool operator==(const EndpointKey& other) const
+	{
+		return hi == other.hi && lo == other.lo && port == other.port;
+	}
+};
+
+// Immutable endpoint -> player id map with linear probing. Twice as many slots as
+// players, so probes stay short; rebuilt and swapped on every (rare) change.
+struct EndpointTable
+{
+	static constexpr size_t SLOTS = 2048;
+	static_assert((SLOTS & (SLOTS - 1)) == 0 && SLOTS >= 2 * MAX_SESSIONS, "SLOTS must be a power of two above twice MAX_SESSIONS");
+
+	struct Entry
+	{
+		EndpointKey key;
+		int16_t playerid = -1;
+	};
+
+	std::array<Entry, SLOTS> entries;
+
+	void Insert(const EndpointKey& key, int playerid);
+	int Find(const EndpointKey& key) const;
 };
 
 class NetworkSessionManager
 {
 public:
-	NetworkSessionManager() = default;
+	NetworkSessionManager();
 	~NetworkSessionManager() = default;
 	NetworkSessionManager(const NetworkSessionManager&) = delete;
 	NetworkSessionManager& operator=(const NetworkSessionManager&) = delete;
@@ -66,22 +149,43 @@ public:
 	void RegisterPlayer(int playerid);
 	void RemovePlayer(int playerid);
 
-	void UpdateAllKcpInstances(uint32_t now_ms);
+	// KCP sessions are only updated when due: after input, after a send and then at the
+	// time ikcp_check asks for. An earlier pending wake-up for the player is kept.
+	void ScheduleKcpUpdate(int playerid, uint32_t due_ms);
+	// Network tick only. Replaces `due` with the sessions whose wake-up has passed.
+	void CollectDueSessions(uint32_t now_ms, std::vector<std::shared_ptr<NetworkSession>>& due);
+
+	// Lookups never take mutex_ nor allocate; they are on the receive path. They are not
+	// lock-free: std::atomic_load of a shared_ptr takes a short spinlock from the standard
+	// library's address-hashed pool (libstdc++, MSVC), see cef-lookupbench.
 	std::shared_ptr<NetworkSession> GetOrCreateSession(int playerid);
 	std::shared_ptr<NetworkSession> GetSessionFromAddress(const asio::ip::udp::endpoint& addr);
-	std::shared_ptr<NetworkSession> GetSession(int playerid);
+	std::shared_ptr<NetworkSession> GetSession(int playerid) const;
 	std::vector<std::shared_ptr<NetworkSession>> GetAllSessions();
 	bool HasPlayerPlugin(int playerid) const;
 	void MapAddressToPlayer(int playerid, const asio::ip::udp::endpoint& addr);
 	void SetDownloadPaused(int playerid, bool paused);
 
+	const KcpOutputStats& GetOutputStats() const { return output_stats_; }
+
 private:
-	void UnmapAddress(const asio::ip::udp::endpoint& addr);
-	std::string EndpointToStr(const asio::ip::udp::endpoint& addr) const;
+	std::shared_ptr<NetworkSession> CreateSessionLocked(int playerid);
+	void PublishEndpointsLocked();
 
+	// Serialises writers. Readers load sessions_ and endpoints_ with std::atomic_load,
+	// which only contends with other accesses to the same slot.
 	mutable std::mutex mutex_;
 
 	std::function<void(const asio::ip::udp::endpoint&, const char*, int)> send_fn_;
-	std::unordered_map<int, std::shared_ptr<NetworkSession>> player_sessions_;
-	std::unordered_map<std::string, int> addr_str_to_playerid_;
+	KcpOutputStats output_stats_;
+
+	std::mutex wheel_mutex_; // taken after mutex_ or a session kcp_mutex, never before
+	TimerWheel kcp_wheel_{ MAX_SESSIONS };
+	std::vector<int> due_ids_;
+
+	std::array<std::shared_ptr<NetworkSession>, MAX_SESSIONS> sessions_;
+	std::shared_ptr<const EndpointTable> endpoints_;
+
+	// Source of truth for endpoints_, guarded by mutex_.
+	std::array<std::optional<EndpointKey>, MAX_SESSIONS> player_endpoints_;
 };
\ No newline at end of file
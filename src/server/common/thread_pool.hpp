@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for CPU-bound work off the network thread, such as hashing
+// and sealing resource files. Tasks must not throw.
+class ThreadPool
+{
+public:
+    // 0 uses one thread per hardware thread.
+    explicit ThreadPool(size_t threads = 0)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        workers_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+            workers_.emplace_back([this] { WorkerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+
+        cv_.notify_all();
+
+        for (auto& worker : workers_)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t Size() const { return workers_.size(); }
+
+    void Post(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push(std::move(task));
+        }
+
+        cv_.notify_one();
+    }
+
+    // Runs fn(i) for every i in [0, count) on the pool and the calling thread, and
+    // returns once all of them are done. Safe to call from a pool task: helpers that
+    // have not started by the time the caller ran out of work are skipped, not awaited.
+    template <typename Fn>
+    void ParallelFor(size_t count, Fn&& fn)
+    {
+        if (count == 0)
+            return;
+
+        struct Shared
+        {
+            std::atomic<size_t> next{ 0 };
+            std::mutex mutex;
+            std::condition_variable done;
+            size_t running = 0;
+            bool closed = false;
+        };
+
+        auto shared = std::make_shared<Shared>();
+        auto run = [shared, count, &fn] {
+            for (size_t i = shared->next.fetch_add(1); i < count; i = shared->next.fetch_add(1))
+                fn(i);
+        };
+
+        const size_t helpers = std::min(count - 1, workers_.size());
+        for (size_t i = 0; i < helpers; ++i) {
+            Post([shared, run] {
+                {
+                    std::lock_guard<std::mutex> lock(shared->mutex);
+                    if (shared->closed)
+                        return;
+
+                    ++shared->running;
+                }
+
+                run();
+
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                if (--shared->running == 0)
+                    shared->done.notify_one();
+            });
+        }
+
+        run();
+
+        std::unique_lock<std::mutex> lock(shared->mutex);
+        shared->closed = true;
+        shared->done.wait(lock, [&] { return shared->running == 0; });
+    }
+
+private:
+    void WorkerLoop()
+    {
+        for (;;) {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+
+                if (stopping_ && tasks_.empty())
+                    return;
+
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+
+            task();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::queue<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+    bool stopping_ = false;
+};
@@ -0,0 +1,161 @@
+#include "timer_wheel.hpp"
+
+static bool IsBefore(uint32_t a, uint32_t b)
+{
+    return static_cast<int32_t>(a - b) < 0;
+}
+
+TimerWheel::TimerWheel(int capacity)
+    : nodes_(capacity > 0 ? static_cast<size_t>(capacity) : 0)
+{
+    level0_.fill(-1);
+    level1_.fill(-1);
+}
+
+void TimerWheel::Schedule(int id, uint32_t due_ms)
+{
+    if (id < 0 || static_cast<size_t>(id) >= nodes_.size())
+        return;
+
+    if (!started_) {
+        current_ = due_ms - 1;
+        started_ = true;
+    }
+
+    Node& node = nodes_[id];
+
+    if (node.slot) {
+        if (!IsBefore(due_ms, node.due))
+            return;
+
+        Unlink(id);
+    }
+
+    node.due = due_ms;
+    Insert(id);
+}
+
+void TimerWheel::Cancel(int id)
+{
+    if (id < 0 || static_cast<size_t>(id) >= nodes_.size())
+        return;
+
+    if (nodes_[id].slot)
+        Unlink(id);
+}
+
+bool TimerWheel::IsScheduled(int id) const
+{
+    return id >= 0 && static_cast<size_t>(id) < nodes_.size() && nodes_[id].slot != nullptr;
+}
+
+void TimerWheel::Advance(uint32_t now_ms, std::vector<int>& due)
+{
+    if (!started_) {
+        current_ = now_ms;
+        started_ = true;
+        return;
+    }
+
+    // After a long stall, walking every millisecond is pointless: re-file everything at once.
+    if (static_cast<int32_t>(now_ms - current_) > static_cast<int32_t>(HORIZON)) {
+        current_ = now_ms;
+
+        for (size_t id = 0; id < nodes_.size(); ++id) {
+            if (!nodes_[id].slot)
+                continue;
+
+            Unlink(static_cast<int>(id));
+
+            if (IsBefore(now_ms, nodes_[id].due))
+                Insert(static_cast<int>(id));
+            else
+                due.push_back(static_cast<int>(id));
+        }
+
+        return;
+    }
+
+    while (IsBefore(current_, now_ms)) {
+        const uint32_t tick = current_ + 1;
+
+        if ((tick & (LEVEL0_SLOTS - 1)) == 0) {
+            int32_t& head = level1_[(tick >> LEVEL0_BITS) & (LEVEL1_SLOTS - 1)];
+            int32_t id = head;
+            head = -1;
+
+            while (id != -1) {
+                Node& node = nodes_[id];
+                const int32_t next = node.next;
+
+                node.slot = nullptr;
+                node.prev = node.next = -1;
+                Insert(id);
+
+                id = next;
+            }
+        }
+
+        int32_t& head = level0_[tick & (LEVEL0_SLOTS - 1)];
+        int32_t id = head;
+        head = -1;
+
+        while (id != -1) {
+            Node& node = nodes_[id];
+            const int32_t next = node.next;
+
+            node.slot = nullptr;
+            node.prev = node.next = -1;
+            due.push_back(id);
+
+            id = next;
+        }
+
+        current_ = tick;
+    }
+}
+
+void TimerWheel::Insert(int id)
+{
+    Node& node = nodes_[id];
+
+    // First millisecond Advance has not processed yet.
+    const uint32_t base = current_ + 1;
+    const int32_t delta = static_cast<int32_t>(node.due - base);
+
+    int32_t* slot = nullptr;
+
+    if (delta <= 0)
+        slot = &level0_[base & (LEVEL0_SLOTS - 1)];
+    else if (delta < static_cast<int32_t>(LEVEL0_SLOTS))
+        slot = &level0_[node.due & (LEVEL0_SLOTS - 1)];
+    else if (delta < static_cast<int32_t>(HORIZON))
+        slot = &level1_[(node.due >> LEVEL0_BITS) & (LEVEL1_SLOTS - 1)];
+    else
+        slot = &level1_[((base >> LEVEL0_BITS) + LEVEL1_SLOTS - 1) & (LEVEL1_SLOTS - 1)];
+
+    node.slot = slot;
+    node.prev = -1;
+    node.next = *slot;
+
+    if (*slot != -1)
+        nodes_[*slot].prev = id;
+
+    *slot = id;
+}
+
+void TimerWheel::Unlink(int id)
+{
+    Node& node = nodes_[id];
+
+    if (node.prev != -1)
+        nodes_[node.prev].next = node.next;
+    else
+        *node.slot = node.next;
+
+    if (node.next != -1)
+        nodes_[node.next].prev = node.prev;
+
+    node.slot = nullptr;
+    node.prev = node.next = -1;
+}
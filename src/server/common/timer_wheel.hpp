@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Two-level hashed timer wheel over millisecond timestamps (wrap-safe uint32). Level 0
+// holds the next 256 ms one slot per millisecond, level 1 the following ~16 s in 256 ms
+// slots that cascade into level 0 as time reaches them; later timers are parked in the
+// last level 1 slot and re-filed on cascade. Keys are small dense ids (player ids), each
+// has at most one pending timer and nodes are preallocated, so nothing allocates after
+// construction. Not thread-safe, owners lock around it.
+class TimerWheel
+{
+public:
+    explicit TimerWheel(int capacity);
+
+    // Arms `id` for `due_ms`. An already earlier timer for `id` is kept.
+    void Schedule(int id, uint32_t due_ms);
+    void Cancel(int id);
+    bool IsScheduled(int id) const;
+
+    // Moves the wheel to `now_ms`, appending every id that became due to `due`.
+    void Advance(uint32_t now_ms, std::vector<int>& due);
+
+private:
+    static constexpr uint32_t LEVEL0_BITS = 8;
+    static constexpr uint32_t LEVEL0_SLOTS = 1u << LEVEL0_BITS;
+    static constexpr uint32_t LEVEL1_SLOTS = 64;
+    static constexpr uint32_t HORIZON = LEVEL0_SLOTS * LEVEL1_SLOTS;
+
+    struct Node
+    {
+        uint32_t due = 0;
+        int32_t prev = -1;
+        int32_t next = -1;
+        int32_t* slot = nullptr; // list head this node is linked into, null when idle
+    };
+
+    void Insert(int id);
+    void Unlink(int id);
+
+    std::vector<Node> nodes_;
+    std::array<int32_t, LEVEL0_SLOTS> level0_;
+    std::array<int32_t, LEVEL1_SLOTS> level1_;
+
+    uint32_t current_ = 0;
+    bool started_ = false;
+};
@@ -20,6 +20,7 @@ void CefOmpComponent::onLoad(ICore* core)
 {
     core_ = core;
     core_->getPlayers().getPlayerConnectDispatcher().addEventHandler(this);
+    core_->getEventDispatcher().addEventHandler(this);
     setAmxLookups(core_);
 }
 
@@ -38,6 +39,13 @@ void CefOmpComponent::onInit(IComponentList* components)
     CefPluginOptions options;
     options.log_level = debug_enabled_ ? CefLogLevel::Debug : CefLogLevel::Info;
     options.master_resource_key = master_resource_key_;
+    options.batch_max_delay_ms = static_cast<uint32_t>(batch_max_delay_ms_);
+    options.batch_max_bytes = static_cast<uint32_t>(batch_max_bytes_);
+    options.batched_udp_io = batched_udp_io_;
+    options.send_buffers = static_cast<uint32_t>(send_buffers_);
+    options.pawn_tick_budget_us = static_cast<uint32_t>(pawn_tick_budget_us_);
+    options.indexed_pak = indexed_pak_;
+    options.pak_aes_gcm = pak_aes_gcm_;
 
     auto bridge = CreateOmpPlatformBridge(core_, pawn_);
     plugin_->Initialize(std::move(bridge), cef_network_port_, options);
@@ -66,6 +74,13 @@ void CefOmpComponent::provideConfiguration(ILogger& logger, IEarlyConfig& config
 	if (defaults) {
 		config.setBool("cef.debug", false);
 		config.setString("cef.master_resource_key", "ThisIsA16ByteKey");
+		config.setInt("cef.batch_max_delay_ms", 10);
+		config.setInt("cef.batch_max_bytes", 1352);
+		config.setBool("cef.batched_udp_io", true);
+		config.setInt("cef.send_buffers", 4096);
+		config.setInt("cef.pawn_tick_budget_us", 2000);
+		config.setBool("cef.indexed_pak", true);
+		config.setBool("cef.pak_aes_gcm", false);
 	}
 	else {
 		if (config.getType("cef.debug") == ConfigOptionType_None) {
@@ -75,10 +90,55 @@ void CefOmpComponent::provideConfiguration(ILogger& logger, IEarlyConfig& config
 		if (config.getType("cef.master_resource_key") == ConfigOptionType_None) {
 			config.setString("cef.master_resource_key", "ThisIsA16ByteKey");
 		}
+
+		if (config.getType("cef.batch_max_delay_ms") == ConfigOptionType_None) {
+			config.setInt("cef.batch_max_delay_ms", 10);
+		}
+
+		if (config.getType("cef.batch_max_bytes") == ConfigOptionType_None) {
+			config.setInt("cef.batch_max_bytes", 1352);
+		}
+
+		if (config.getType("cef.batched_udp_io") == ConfigOptionType_None) {
+			config.setBool("cef.batched_udp_io", true);
+		}
+
+		if (config.getType("cef.send_buffers") == ConfigOptionType_None) {
+			config.setInt("cef.send_buffers", 4096);
+		}
+
+		if (config.getType("cef.pawn_tick_budget_us") == ConfigOptionType_None) {
+			config.setInt("cef.pawn_tick_budget_us", 2000);
+		}
+
+		if (config.getType("cef.indexed_pak") == ConfigOptionType_None) {
+			config.setBool("cef.indexed_pak", true);
+		}
+
+		if (config.getType("cef.pak_aes_gcm") == ConfigOptionType_None) {
+			config.setBool("cef.pak_aes_gcm", false);
+		}
 	}
 
 	debug_enabled_ = config.getBool("cef.debug") ? *config.getBool("cef.debug") : false;
 
+	int* batch_delay_ptr = config.getInt("cef.batch_max_delay_ms");
+	batch_max_delay_ms_ = (batch_delay_ptr && *batch_delay_ptr >= 0) ? *batch_delay_ptr : 10;
+
+	int* batch_bytes_ptr = config.getInt("cef.batch_max_bytes");
+	batch_max_bytes_ = (batch_bytes_ptr && *batch_bytes_ptr > 0) ? *batch_bytes_ptr : 1352;
+
+	batched_udp_io_ = config.getBool("cef.batched_udp_io") ? *config.getBool("cef.batched_udp_io") : true;
+
+	int* send_buffers_ptr = config.getInt("cef.send_buffers");
+	send_buffers_ = (send_buffers_ptr && *send_buffers_ptr > 0) ? *send_buffers_ptr : 4096;
+
+	int* pawn_budget_ptr = config.getInt("cef.pawn_tick_budget_us");
+	pawn_tick_budget_us_ = (pawn_budget_ptr && *pawn_budget_ptr >= 0) ? *pawn_budget_ptr : 2000;
+
+	indexed_pak_ = config.getBool("cef.indexed_pak") ? *config.getBool("cef.indexed_pak") : true;
+	pak_aes_gcm_ = config.getBool("cef.pak_aes_gcm") ? *config.getBool("cef.pak_aes_gcm") : false;
+
 	StringView key_sv = config.getString("cef.master_resource_key");
 	size_t key_len = key_sv.length();
 
@@ -127,6 +187,12 @@ void CefOmpComponent::onPlayerDisconnect(IPlayer& player, PeerDisconnectReason r
 	plugin_->OnPlayerDisconnect(player.getID());
 }
 
+void CefOmpComponent::onTick(Microseconds elapsed, TimePoint now)
+{
+    if (plugin_)
+        plugin_->ProcessPawnCallbacks();
+}
+
 CefOmpComponent::~CefOmpComponent()
 {
     if (pawn_)
@@ -137,5 +203,6 @@ CefOmpComponent::~CefOmpComponent()
     if (core_)
     {
         core_->getPlayers().getPlayerConnectDispatcher().removeEventHandler(this);
+        core_->getEventDispatcher().removeEventHandler(this);
     }
 }
\ No newline at end of file
@@ -10,7 +10,8 @@ struct ICefOmpComponent : IComponent
 
 class CefOmpComponent final : public ICefOmpComponent,
                               public PawnEventHandler,
-                              public PlayerConnectEventHandler
+                              public PlayerConnectEventHandler,
+                              public CoreEventHandler
 {
 public:
     StringView componentName() const override;
@@ -33,6 +34,8 @@ public:
     void onPlayerClientInit(IPlayer& player) override;
     void onPlayerDisconnect(IPlayer& player, PeerDisconnectReason reason) override;
 
+    void onTick(Microseconds elapsed, TimePoint now) override;
+
 private:
     static constexpr uint16_t cef_network_port_offset = 2;
 
@@ -45,6 +48,14 @@ private:
     bool debug_enabled_ = false;
     std::vector<uint8_t> master_resource_key_;
 
+    int batch_max_delay_ms_ = 10;
+    int batch_max_bytes_ = 1352;
+    bool batched_udp_io_ = true;
+    int send_buffers_ = 4096;
+    int pawn_tick_budget_us_ = 2000;
+    bool indexed_pak_ = true;
+    bool pak_aes_gcm_ = false;
+
     uint16_t server_port_ = 7777;
     uint16_t cef_network_port_ = 7779;
 };
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <sodium.h>
+#include <shared/pak-format.hpp>
+#include <shared/utils.hpp>
+
+#include "common/bridge.hpp"
+#include "common/logger.hpp"
+#include "common/resource_manager.hpp"
+
+// cef-pack: builds resource paks offline, so servers can deploy the pak and its manifest
+// without the source directory. Output is reproducible: the same files and key always
+// give the same pak, byte for byte.
+
+namespace
+{
+    class ConsoleBridge final : public IPlatformBridge
+    {
+    public:
+        void LogInfo(const std::string& message) override { std::printf("%s\n", message.c_str()); }
+        void LogWarn(const std::string& message) override { std::fprintf(stderr, "[WARN] %s\n", message.c_str()); }
+        void LogError(const std::string& message) override { std::fprintf(stderr, "[ERROR] %s\n", message.c_str()); }
+        void LogDebug(const std::string& message) override { std::printf("[DEBUG] %s\n", message.c_str()); }
+
+        void CallPawnPublic(const std::string&, const std::vector<Argument>&) override {}
+        void CallOnBrowserCreated(int, int, bool, int, const std::string&) override {}
+
+        std::string GetPlayerAddressIp(int) override { return {}; }
+        void KickPlayer(int) override {}
+    };
+
+    struct Options
+    {
+        std::vector<std::string> resources;
+        std::string output;
+        std::string key;
+        size_t jobs = 0;
+        bool aes_gcm = false;
+        bool verbose = false;
+    };
+
+    void PrintUsage()
+    {
+        std::printf(
+            "Usage: cef-pack [options] <resource-dir>...\n"
+            "\n"
+            "Packs each resource directory into <output>/<name>.pak and <name>.pak.manifest.\n"
+            "\n"
+            "Options:\n"
+            "  -o, --output <dir>     Output directory (default: the parent of each resource)\n"
+            "  -k, --key <key>        Master resource key, as set in the server config\n"
+            "      --key-file <path>  Read the master resource key from a file\n"
+            "  -j, --jobs <n>         Packing threads (default: one per hardware thread)\n"
+            "      --aes-gcm          Seal with AES-256-GCM (cef.pak_aes_gcm), clients need AES-NI\n"
+            "  -v, --verbose          Debug output\n"
+            "  -h, --help             Show this help\n"
+            "\n"
+            "The key can also be given in the CEF_MASTER_RESOURCE_KEY environment variable.\n");
+    }
+
+    bool ReadKeyFile(const std::string& path, std::string& key)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        key.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        // Editors tend to leave a trailing newline, never part of a config value.
+        while (!key.empty() && (key.back() == '\n' || key.back() == '\r'))
+            key.pop_back();
+
+        return true;
+    }
+
+    bool ParseArguments(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto next = [&](std::string& value) {
+                if (i + 1 >= argc)
+                {
+                    std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+                    return false;
+                }
+
+                value = argv[++i];
+                return true;
+            };
+
+            std::string value;
+
+            if (arg == "-h" || arg == "--help")
+            {
+                PrintUsage();
+                std::exit(0);
+            }
+            else if (arg == "-o" || arg == "--output")
+            {
+                if (!next(options.output))
+                    return false;
+            }
+            else if (arg == "-k" || arg == "--key")
+            {
+                if (!next(options.key))
+                    return false;
+            }
+            else if (arg == "--key-file")
+            {
+                if (!next(value))
+                    return false;
+
+                if (!ReadKeyFile(value, options.key))
+                {
+                    std::fprintf(stderr, "Could not read key file '%s'\n", value.c_str());
+                    return false;
+                }
+            }
+            else if (arg == "-j" || arg == "--jobs")
+            {
+                if (!next(value))
+                    return false;
+
+                options.jobs = std::strtoul(value.c_str(), nullptr, 10);
+            }
+            else if (arg == "--aes-gcm")
+            {
+                options.aes_gcm = true;
+            }
+            else if (arg == "-v" || arg == "--verbose")
+            {
+                options.verbose = true;
+            }
+            else if (!arg.empty() && arg[0] == '-')
+            {
+                std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+                return false;
+            }
+            else
+            {
+                options.resources.push_back(arg);
+            }
+        }
+
+        if (options.key.empty())
+        {
+            if (const char* env = std::getenv("CEF_MASTER_RESOURCE_KEY"))
+                options.key = env;
+        }
+
+        return true;
+    }
+
+    void PrintStats(const PackStats& stats)
+    {
+        for (const auto& file : stats.files)
+        {
+            double ratio = file.size ? 100.0 * static_cast<double>(file.stored_size) / static_cast<double>(file.size) : 100.0;
+
+            std::printf("  %-48s %12s -> %-12s %6.1f%%%s%s\n", file.path.c_str(),
+                FormatBytes(file.size).c_str(), FormatBytes(file.stored_size).c_str(), ratio,
+                file.deflated ? "  deflate" : "", file.reused ? "  reused" : "");
+        }
+
+        double seconds = static_cast<double>(stats.elapsed_ms) / 1000.0;
+        double throughput = seconds > 0.0 ? static_cast<double>(stats.raw_bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+
+        std::printf("  %zu files, %s -> %s, %zu deflated, %zu reused, %llu ms (%.1f MB/s)\n", stats.files.size(),
+            FormatBytes(stats.raw_bytes).c_str(), FormatBytes(stats.packed_bytes).c_str(), stats.deflated_files,
+            stats.reused_files, static_cast<unsigned long long>(stats.elapsed_ms), throughput);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseArguments(argc, argv, options))
+        return 2;
+
+    if (options.resources.empty())
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    if (options.key.empty())
+    {
+        std::fprintf(stderr, "No master resource key, pass --key, --key-file or set CEF_MASTER_RESOURCE_KEY\n");
+        return 2;
+    }
+
+    if (sodium_init() < 0)
+    {
+        std::fprintf(stderr, "Failed to initialize libsodium\n");
+        return 1;
+    }
+
+    if (options.aes_gcm && !IsPakCipherAvailable(PakCipher::Aes256Gcm))
+    {
+        std::fprintf(stderr, "This CPU has no AES-NI, cannot seal with AES-256-GCM\n");
+        return 1;
+    }
+
+    ConsoleBridge bridge;
+    Logger logger(options.verbose ? CefLogLevel::Debug : CefLogLevel::Info);
+    logger.SetBridge(&bridge);
+    logging::SetLogger(&logger);
+
+    const std::vector<uint8_t> key(options.key.begin(), options.key.end());
+
+    int failed = 0;
+
+    for (const auto& resource : options.resources)
+    {
+        std::filesystem::path source = std::filesystem::path(resource).lexically_normal();
+        if (!source.has_filename())
+            source = source.parent_path();
+
+        const std::string name = source.filename().string();
+        std::filesystem::path parent = source.has_parent_path() ? source.parent_path() : std::filesystem::path(".");
+        std::filesystem::path output = options.output.empty() ? parent : std::filesystem::path(options.output);
+
+        std::error_code ec;
+        std::filesystem::create_directories(output, ec);
+        if (ec)
+        {
+            std::fprintf(stderr, "Could not create output directory '%s': %s\n", output.string().c_str(), ec.message().c_str());
+            ++failed;
+            continue;
+        }
+
+        // Indexed layout only: zip paks are not reproducible. Modified times are left out
+        // of the manifest for the same reason, the server records them on first load.
+        ResourceManager manager(options.jobs);
+        manager.SetIndexedPak(true);
+        manager.SetPakCipher(options.aes_gcm ? PakCipher::Aes256Gcm : PakCipher::XChaCha20Poly1305);
+        manager.SetRecordModifiedTimes(false);
+        manager.SetResourceDirectories(parent.generic_string(), output.generic_string());
+
+        PackStats stats;
+        if (!manager.AddResource(name, key, &stats))
+        {
+            ++failed;
+            continue;
+        }
+
+        if (!stats.up_to_date)
+            PrintStats(stats);
+    }
+
+    logging::SetLogger(nullptr);
+    return failed ? 1 : 0;
+}
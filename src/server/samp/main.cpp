@@ -19,7 +19,7 @@ std::unique_ptr<CefPlugin> plugin_;
 
 PLUGIN_EXPORT unsigned int PLUGIN_CALL Supports()
 {
-    return sampgdk::Supports() | SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES;
+    return sampgdk::Supports() | SUPPORTS_VERSION | SUPPORTS_AMX_NATIVES | SUPPORTS_PROCESS_TICK;
 }
 
 PLUGIN_EXPORT bool PLUGIN_CALL Load(void** ppData)
@@ -51,6 +51,13 @@ PLUGIN_EXPORT bool PLUGIN_CALL Load(void** ppData)
     CefPluginOptions options;
     options.log_level = debug_enabled_ ? CefLogLevel::Debug : CefLogLevel::Info;
     options.master_resource_key = master_key;
+    options.batch_max_delay_ms = static_cast<uint32_t>(std::max(0, config.GetInt("cef_batch_max_delay_ms", 10)));
+    options.batch_max_bytes = static_cast<uint32_t>(std::max(1, config.GetInt("cef_batch_max_bytes", 1352)));
+    options.batched_udp_io = config.GetInt("cef_batched_udp_io", 1) != 0;
+    options.send_buffers = static_cast<uint32_t>(std::max(1, config.GetInt("cef_send_buffers", 4096)));
+    options.pawn_tick_budget_us = static_cast<uint32_t>(std::max(0, config.GetInt("cef_pawn_tick_budget_us", 2000)));
+    options.indexed_pak = config.GetInt("cef_indexed_pak", 1) != 0;
+    options.pak_aes_gcm = config.GetInt("cef_pak_aes_gcm", 0) != 0;
 
     auto bridge = CreateSampPlatformBridge();
     plugin_->Initialize(std::move(bridge), cef_network_port, options);
@@ -66,6 +73,14 @@ PLUGIN_EXPORT void PLUGIN_CALL Unload()
     sampgdk::Unload();
 }
 
+PLUGIN_EXPORT void PLUGIN_CALL ProcessTick()
+{
+    sampgdk::ProcessTick();
+
+    if (plugin_)
+        plugin_->ProcessPawnCallbacks();
+}
+
 PLUGIN_EXPORT int PLUGIN_CALL AmxLoad(AMX* amx)
 {
     g_AmxList.push_back(amx);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+enum class ByteRange
+{
+	None,          // no usable Range header, the whole file is served
+	Satisfiable,
+	Unsatisfiable,
+};
+
+// Single range only ("bytes=a-b", "bytes=a-", "bytes=-n"); a multi-range request is
+// answered with the whole file, which HTTP allows.
+inline ByteRange ParseByteRange(const std::string& header, uint64_t size, uint64_t& begin, uint64_t& length)
+{
+	constexpr std::string_view prefix = "bytes=";
+	std::string_view spec(header);
+
+	if (spec.substr(0, prefix.size()) != prefix || spec.find(',') != std::string_view::npos)
+		return ByteRange::None;
+
+	spec.remove_prefix(prefix.size());
+
+	const size_t dash = spec.find('-');
+	if (dash == std::string_view::npos)
+		return ByteRange::None;
+
+	const std::string_view first_str = spec.substr(0, dash);
+	const std::string_view last_str = spec.substr(dash + 1);
+
+	auto parse = [](std::string_view str, uint64_t& value) {
+		const char* end = str.data() + str.size();
+		auto result = std::from_chars(str.data(), end, value);
+		return !str.empty() && result.ec == std::errc() && result.ptr == end;
+	};
+
+	uint64_t first = 0;
+	uint64_t last = 0;
+
+	if (first_str.empty()) {
+		// Suffix range, the last n bytes.
+		if (!parse(last_str, last))
+			return ByteRange::None;
+
+		if (last == 0 || size == 0)
+			return ByteRange::Unsatisfiable;
+
+		length = std::min(last, size);
+		begin = size - length;
+		return ByteRange::Satisfiable;
+	}
+
+	if (!parse(first_str, first))
+		return ByteRange::None;
+
+	if (last_str.empty())
+		last = size ? size - 1 : 0;
+	else if (!parse(last_str, last) || last < first)
+		return ByteRange::None;
+
+	if (first >= size)
+		return ByteRange::Unsatisfiable;
+
+	begin = first;
+	length = std::min(last, size - 1) - first + 1;
+	return ByteRange::Satisfiable;
+}
@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 #include <array>
+#include <cstdint>
+#include <cstring>
 #include <sodium.h>
 #include <stdexcept>
 #include <aes.hpp>
@@ -13,51 +15,45 @@ constexpr size_t COOKIE_KEY_BYTES = crypto_aead_xchacha20poly1305_ietf_KEYBYTES;
 constexpr size_t COOKIE_NONCE_BYTES = crypto_aead_xchacha20poly1305_ietf_NPUBBYTES;
 constexpr size_t COOKIE_MAC_BYTES = crypto_aead_xchacha20poly1305_ietf_ABYTES;
 
-constexpr size_t PACKET_KEY_BYTES = crypto_secretbox_KEYBYTES;
-constexpr size_t PACKET_NONCE_BYTES = crypto_secretbox_NONCEBYTES;
-constexpr size_t PACKET_MAC_BYTES = crypto_secretbox_MACBYTES;
+constexpr size_t SESSION_KEY_BYTES = crypto_aead_chacha20poly1305_ietf_KEYBYTES;
+constexpr size_t SESSION_COUNTER_BYTES = 8;
+constexpr size_t SESSION_MAC_BYTES = crypto_aead_chacha20poly1305_ietf_ABYTES;
+constexpr size_t SESSION_OVERHEAD = SESSION_COUNTER_BYTES + SESSION_MAC_BYTES;
 
-inline void PadDataTo16(std::vector<uint8_t>& data)
+// Legacy zip paks: AES-CBC with PKCS#7 padding, kept so those paks still load. Both work
+// in place on data[offset..], what comes before (the IV in a zip entry) is left untouched.
+inline void EncryptFileInPlace(std::vector<uint8_t>& data, size_t offset, const std::vector<uint8_t>& key, const std::array<uint8_t, AES_IV_BYTES>& iv)
 {
-	size_t remainder = data.size() % AES_BLOCKLEN;
-	size_t padding_needed = (remainder == 0) ? AES_BLOCKLEN : (AES_BLOCKLEN - remainder);
-	for (size_t i = 0; i < padding_needed; ++i) {
-		data.push_back(static_cast<uint8_t>(padding_needed));
-	}
-}
-
-inline bool UnpadData(std::vector<uint8_t>& data)
-{
-	if (data.empty()) return false;
-	uint8_t padding_value = data.back();
-	if (padding_value == 0 || padding_value > AES_BLOCKLEN || padding_value > data.size()) return false;
+	const size_t padding = AES_BLOCKLEN - (data.size() - offset) % AES_BLOCKLEN;
+	data.resize(data.size() + padding, static_cast<uint8_t>(padding));
 
-	for (size_t i = 0; i < padding_value; ++i) {
-		if (data[data.size() - 1 - i] != padding_value) return false;
-	}
-	data.resize(data.size() - padding_value);
-	return true;
-}
-
-inline std::vector<uint8_t> EncryptFile(const std::vector<uint8_t>& data, const std::vector<uint8_t>& key, const std::array<uint8_t, AES_IV_BYTES>& iv)
-{
 	AES_ctx ctx;
 	AES_init_ctx_iv(&ctx, key.data(), iv.data());
-	std::vector<uint8_t> padded_data = data;
-	PadDataTo16(padded_data);
-	AES_CBC_encrypt_buffer(&ctx, padded_data.data(), padded_data.size());
-	return padded_data;
+	AES_CBC_encrypt_buffer(&ctx, data.data() + offset, data.size() - offset);
 }
 
-inline std::vector<uint8_t> DecryptFile(const std::vector<uint8_t>& encrypted_data, const std::vector<uint8_t>& key, const std::array<uint8_t, AES_IV_BYTES>& iv)
+inline bool DecryptFileInPlace(std::vector<uint8_t>& data, size_t offset, const std::vector<uint8_t>& key, const std::array<uint8_t, AES_IV_BYTES>& iv)
 {
-	if (encrypted_data.size() % AES_BLOCKLEN != 0) return {};
+	if (data.size() <= offset || (data.size() - offset) % AES_BLOCKLEN != 0)
+		return false;
+
+	const size_t size = data.size() - offset;
+
 	AES_ctx ctx;
 	AES_init_ctx_iv(&ctx, key.data(), iv.data());
-	std::vector<uint8_t> data = encrypted_data;
-	AES_CBC_decrypt_buffer(&ctx, data.data(), data.size());
-	if (!UnpadData(data)) return {};
-	return data;
+	AES_CBC_decrypt_buffer(&ctx, data.data() + offset, size);
+
+	const uint8_t padding = data.back();
+	if (padding == 0 || padding > AES_BLOCKLEN)
+		return false;
+
+	for (size_t i = 1; i <= padding; ++i) {
+		if (data[data.size() - i] != padding)
+			return false;
+	}
+
+	data.resize(data.size() - padding);
+	return true;
 }
 
 inline std::vector<uint8_t> EncryptCookie(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key)
@@ -112,40 +108,129 @@ inline std::vector<uint8_t> DecryptCookie(const std::vector<uint8_t>& ciphertext
 	return decrypted;
 }
 
-inline std::vector<uint8_t> EncryptPacket(const std::vector<uint8_t>& plaintext, const std::vector<uint8_t>& key)
+// Encrypts KCP messages in both directions of a session, each with its own key from the
+// key exchange. A message is counter (8 bytes, little-endian) || ChaCha20-Poly1305 || MAC:
+// the nonce is the counter, so it never repeats under a key, and only has to be sent, not
+// random. Received counters go through a sliding window, replays and duplicates are dropped.
+// Seal and Open use separate state and may run concurrently, but neither is reentrant.
+class SessionCipher
 {
-	if (key.size() != PACKET_KEY_BYTES) return {};
+public:
+	static constexpr uint64_t REPLAY_WINDOW = 64;
+
+	bool Init(const std::vector<uint8_t>& tx_key, const std::vector<uint8_t>& rx_key)
+	{
+		if (tx_key.size() != SESSION_KEY_BYTES || rx_key.size() != SESSION_KEY_BYTES)
+			return false;
+
+		std::memcpy(tx_key_.data(), tx_key.data(), SESSION_KEY_BYTES);
+		std::memcpy(rx_key_.data(), rx_key.data(), SESSION_KEY_BYTES);
+		tx_counter_ = 0;
+		rx_highest_ = 0;
+		rx_window_ = 0;
+		ready_ = true;
+		return true;
+	}
 
-	std::vector<uint8_t> nonce(PACKET_NONCE_BYTES);
-	randombytes_buf(nonce.data(), nonce.size());
+	void Clear()
+	{
+		sodium_memzero(tx_key_.data(), tx_key_.size());
+		sodium_memzero(rx_key_.data(), rx_key_.size());
+		ready_ = false;
+	}
 
-	std::vector<uint8_t> ciphertext(plaintext.size() + PACKET_MAC_BYTES);
+	bool IsReady() const { return ready_; }
 
-	crypto_secretbox_easy(ciphertext.data(), plaintext.data(), plaintext.size(), nonce.data(), key.data());
+	// Writes the sealed message, size + SESSION_OVERHEAD bytes, to `out`. `plaintext` may be
+	// out + SESSION_COUNTER_BYTES, for sealing in place.
+	bool Seal(const uint8_t* plaintext, size_t size, uint8_t* out)
+	{
+		if (!ready_ || tx_counter_ == UINT64_MAX)
+			return false;
 
-	std::vector<uint8_t> result;
-	result.reserve(nonce.size() + ciphertext.size());
-	result.insert(result.end(), nonce.begin(), nonce.end());
-	result.insert(result.end(), ciphertext.begin(), ciphertext.end());
+		const uint64_t counter = ++tx_counter_;
+		StoreCounter(out, counter);
 
-	return result;
-}
+		const auto nonce = Nonce(counter);
+		return crypto_aead_chacha20poly1305_ietf_encrypt_detached(out + SESSION_COUNTER_BYTES, out + SESSION_COUNTER_BYTES + size,
+			nullptr, plaintext, size, nullptr, 0, nullptr, nonce.data(), tx_key_.data()) == 0;
+	}
 
-inline std::vector<uint8_t> DecryptPacket(const std::vector<uint8_t>& ciphertext_with_nonce, const std::vector<uint8_t>& key)
-{
-	if (key.size() != PACKET_KEY_BYTES || ciphertext_with_nonce.size() < PACKET_NONCE_BYTES + PACKET_MAC_BYTES) {
-		return {};
+	// Decrypts in place: on success the plaintext is `plaintext_size` bytes at
+	// data + SESSION_COUNTER_BYTES.
+	bool Open(uint8_t* data, size_t size, size_t& plaintext_size)
+	{
+		if (!ready_ || size < SESSION_OVERHEAD)
+			return false;
+
+		const uint64_t counter = LoadCounter(data);
+		if (!IsFresh(counter))
+			return false;
+
+		plaintext_size = size - SESSION_OVERHEAD;
+		uint8_t* ciphertext = data + SESSION_COUNTER_BYTES;
+
+		const auto nonce = Nonce(counter);
+		if (crypto_aead_chacha20poly1305_ietf_decrypt_detached(ciphertext, nullptr, ciphertext, plaintext_size,
+				ciphertext + plaintext_size, nullptr, 0, nonce.data(), rx_key_.data()) != 0)
+			return false;
+
+		// Only authentic messages move the window.
+		Accept(counter);
+		return true;
 	}
 
-	const uint8_t* nonce = ciphertext_with_nonce.data();
-	const uint8_t* ciphertext = ciphertext_with_nonce.data() + PACKET_NONCE_BYTES;
-	size_t ciphertext_len = ciphertext_with_nonce.size() - PACKET_NONCE_BYTES;
+private:
+	static std::array<uint8_t, crypto_aead_chacha20poly1305_ietf_NPUBBYTES> Nonce(uint64_t counter)
+	{
+		std::array<uint8_t, crypto_aead_chacha20poly1305_ietf_NPUBBYTES> nonce{};
+		StoreCounter(nonce.data() + nonce.size() - SESSION_COUNTER_BYTES, counter);
+		return nonce;
+	}
 
-	std::vector<uint8_t> decrypted(ciphertext_len - PACKET_MAC_BYTES);
+	static void StoreCounter(uint8_t* out, uint64_t counter)
+	{
+		for (size_t i = 0; i < SESSION_COUNTER_BYTES; ++i)
+			out[i] = static_cast<uint8_t>(counter >> (i * 8));
+	}
 
-	if (crypto_secretbox_open_easy(decrypted.data(), ciphertext, ciphertext_len, nonce, key.data()) != 0) {
-		return {};
+	static uint64_t LoadCounter(const uint8_t* in)
+	{
+		uint64_t counter = 0;
+		for (size_t i = 0; i < SESSION_COUNTER_BYTES; ++i)
+			counter |= static_cast<uint64_t>(in[i]) << (i * 8);
+		return counter;
 	}
 
-	return decrypted;
-}
\ No newline at end of file
+	// Counters start at 1. Bit n of the window is set when rx_highest_ - n was received.
+	bool IsFresh(uint64_t counter) const
+	{
+		if (counter == 0)
+			return false;
+
+		if (counter > rx_highest_)
+			return true;
+
+		const uint64_t age = rx_highest_ - counter;
+		return age < REPLAY_WINDOW && (rx_window_ & (1ull << age)) == 0;
+	}
+
+	void Accept(uint64_t counter)
+	{
+		if (counter > rx_highest_) {
+			const uint64_t shift = counter - rx_highest_;
+			rx_window_ = shift < REPLAY_WINDOW ? (rx_window_ << shift) | 1 : 1;
+			rx_highest_ = counter;
+		}
+		else {
+			rx_window_ |= 1ull << (rx_highest_ - counter);
+		}
+	}
+
+	std::array<uint8_t, SESSION_KEY_BYTES> tx_key_{};
+	std::array<uint8_t, SESSION_KEY_BYTES> rx_key_{};
+	uint64_t tx_counter_ = 0;
+	uint64_t rx_highest_ = 0;
+	uint64_t rx_window_ = 0;
+	bool ready_ = false;
+};
@@ -1,31 +1,191 @@
 #pragma once
 
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
 namespace CefEvent
 {
+    // Events travel as a u16 id instead of their name. Builtin events below have fixed ids,
+    // names used by scripts (CEF_RegisterEvent, CEF_EmitEvent, cef.emit) are interned at
+    // runtime into an EventTable that the server pushes to each client after the handshake.
+    // Id 0 means "not interned", the packet then carries the name as before.
+    using Id = uint16_t;
+
+    inline constexpr Id InvalidId = 0;
+    inline constexpr Id FirstDynamicId = 0x100;
+
+    // FNV-1a, usable in constant expressions.
+    constexpr uint32_t Hash(std::string_view name)
+    {
+        uint32_t hash = 2166136261u;
+
+        for (char c : name) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    struct Builtin
+    {
+        Id id;
+        std::string_view name;
+        uint32_t hash;
+
+        constexpr Builtin(Id id, std::string_view name) : id(id), name(name), hash(Hash(name)) {}
+    };
+
     namespace Server
     {
-        inline constexpr const char* CreateBrowser = "CreateBrowser";
-        inline constexpr const char* CreateWorldBrowser = "CreateWorldBrowser";
-        inline constexpr const char* DestroyBrowser = "DestroyBrowser";
+        inline constexpr Builtin CreateBrowser{ 1, "CreateBrowser" };
+        inline constexpr Builtin CreateWorldBrowser{ 2, "CreateWorldBrowser" };
+        inline constexpr Builtin DestroyBrowser{ 3, "DestroyBrowser" };
 
-        inline constexpr const char* ReloadBrowser = "ReloadBrowser";
-        inline constexpr const char* FocusBrowser = "FocusBrowser";
+        inline constexpr Builtin ReloadBrowser{ 4, "ReloadBrowser" };
+        inline constexpr Builtin FocusBrowser{ 5, "FocusBrowser" };
 
-        inline constexpr const char* EnableDevTools = "EnableDevTools";
+        inline constexpr Builtin EnableDevTools{ 6, "EnableDevTools" };
 
-        inline constexpr const char* AttachBrowserToObject = "AttachBrowserToObject";
-        inline constexpr const char* DetachBrowserFromObject = "DetachBrowserFromObject";
+        inline constexpr Builtin AttachBrowserToObject{ 7, "AttachBrowserToObject" };
+        inline constexpr Builtin DetachBrowserFromObject{ 8, "DetachBrowserFromObject" };
 
-        inline constexpr const char* MuteBrowser = "MuteBrowser";
-        inline constexpr const char* SetAudioMode = "SetAudioMode";
-        inline constexpr const char* SetAudioSettings = "SetAudioSettings";
+        inline constexpr Builtin MuteBrowser{ 9, "MuteBrowser" };
+        inline constexpr Builtin SetAudioMode{ 10, "SetAudioMode" };
+        inline constexpr Builtin SetAudioSettings{ 11, "SetAudioSettings" };
 
-        inline constexpr const char* ToggleHudComponent = "ToggleHudComponent";
-        inline constexpr const char* ToggleSpawnScreen = "ToggleSpawnScreen";
+        inline constexpr Builtin ToggleHudComponent{ 12, "ToggleHudComponent" };
+        inline constexpr Builtin ToggleSpawnScreen{ 13, "ToggleSpawnScreen" };
     }
 
-    namespace Client 
+    namespace Client
+    {
+        inline constexpr Builtin BrowserCreateResult{ 0x80, "BrowserCreateResult" };
+    }
+
+    inline constexpr Builtin Builtins[] = {
+        Server::CreateBrowser,
+        Server::CreateWorldBrowser,
+        Server::DestroyBrowser,
+        Server::ReloadBrowser,
+        Server::FocusBrowser,
+        Server::EnableDevTools,
+        Server::AttachBrowserToObject,
+        Server::DetachBrowserFromObject,
+        Server::MuteBrowser,
+        Server::SetAudioMode,
+        Server::SetAudioSettings,
+        Server::ToggleHudComponent,
+        Server::ToggleSpawnScreen,
+        Client::BrowserCreateResult,
+    };
+
+    constexpr Id FindBuiltin(std::string_view name)
     {
-        inline constexpr const char* BrowserCreateResult = "BrowserCreateResult";
+        const uint32_t hash = Hash(name);
+
+        for (const auto& builtin : Builtins) {
+            if (builtin.hash == hash && builtin.name == name)
+                return builtin.id;
+        }
+
+        return InvalidId;
     }
-}
\ No newline at end of file
+
+    constexpr bool BuiltinsAreUnique()
+    {
+        for (size_t i = 0; i < std::size(Builtins); ++i) {
+            if (Builtins[i].id == InvalidId || Builtins[i].id >= FirstDynamicId)
+                return false;
+
+            for (size_t j = i + 1; j < std::size(Builtins); ++j) {
+                if (Builtins[i].id == Builtins[j].id || Builtins[i].hash == Builtins[j].hash)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    static_assert(BuiltinsAreUnique(), "Builtin event ids and name hashes must be unique");
+    static_assert(FindBuiltin("CreateBrowser") == Server::CreateBrowser.id);
+
+    // Runtime name <-> id table for script events. Ids are dense from FirstDynamicId so the
+    // id -> name direction is a plain vector index. Not thread-safe, owners lock around it.
+    class EventTable
+    {
+    public:
+        // Returns the id of `name`, assigning the next free one if it is new.
+        Id Intern(const std::string& name)
+        {
+            auto it = ids_.find(name);
+            if (it != ids_.end())
+                return it->second;
+
+            if (names_.size() >= static_cast<size_t>(UINT16_MAX - FirstDynamicId))
+                return InvalidId;
+
+            const Id id = static_cast<Id>(FirstDynamicId + names_.size());
+            names_.push_back(name);
+            ids_.emplace(name, id);
+
+            return id;
+        }
+
+        // Records an id assigned by the peer (client side).
+        void Assign(Id id, const std::string& name)
+        {
+            if (id < FirstDynamicId)
+                return;
+
+            const size_t index = id - FirstDynamicId;
+            if (index >= names_.size())
+                names_.resize(index + 1);
+
+            names_[index] = name;
+            ids_[name] = id;
+        }
+
+        Id Find(const std::string& name) const
+        {
+            auto it = ids_.find(name);
+            return it != ids_.end() ? it->second : InvalidId;
+        }
+
+        const std::string* Name(Id id) const
+        {
+            if (id < FirstDynamicId)
+                return nullptr;
+
+            const size_t index = id - FirstDynamicId;
+            if (index >= names_.size() || names_[index].empty())
+                return nullptr;
+
+            return &names_[index];
+        }
+
+        static Id IndexToId(size_t index)
+        {
+            return static_cast<Id>(FirstDynamicId + index);
+        }
+
+        size_t Size() const
+        {
+            return names_.size();
+        }
+
+        void Clear()
+        {
+            names_.clear();
+            ids_.clear();
+        }
+
+    private:
+        std::vector<std::string> names_;
+        std::unordered_map<std::string, Id> ids_;
+    };
+}
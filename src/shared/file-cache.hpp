@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Decrypted file content. Immutable once published, shared by the cache and every
+// response reading it.
+using Blob = std::vector<uint8_t>;
+
+struct FileCacheStats
+{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	size_t entries = 0;
+	size_t bytes = 0;
+	size_t budget = 0;
+};
+
+// Decrypted files kept after a request, roughly least recently used first out once
+// their total size goes over the budget. A file larger than the whole budget is never kept.
+//
+// Thread-safe. Lookups only take a shared lock so parallel CEF IO requests do not queue
+// behind each other: a hit marks the entry instead of moving it, and eviction gives
+// marked entries a second chance (CLOCK) rather than following exact recency.
+class FileCache
+{
+public:
+	using Content = std::shared_ptr<const Blob>;
+
+	explicit FileCache(size_t budget_bytes) : budget_(budget_bytes) {}
+
+	FileCache(const FileCache&) = delete;
+	FileCache& operator=(const FileCache&) = delete;
+
+	void SetBudget(size_t budget_bytes)
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+		budget_ = budget_bytes;
+		EvictLocked();
+	}
+
+	// Null on a miss. Counts the lookup either way.
+	Content Find(const std::string& key) const
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex_);
+
+		auto it = index_.find(key);
+		if (it == index_.end())
+		{
+			misses_.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		hits_.fetch_add(1, std::memory_order_relaxed);
+		it->second->referenced.store(true, std::memory_order_relaxed);
+		return it->second->content;
+	}
+
+	void Insert(const std::string& key, Content content)
+	{
+		if (!content)
+			return;
+
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+
+		if (content->size() > budget_)
+			return;
+
+		auto it = index_.find(key);
+		if (it != index_.end())
+		{
+			bytes_ -= it->second->content->size();
+			lru_.erase(it->second);
+			index_.erase(it);
+		}
+
+		// Starts marked, or a cache full of hot entries would evict it first.
+		lru_.emplace_front(key, std::move(content));
+		index_.emplace(key, lru_.begin());
+		bytes_ += lru_.front().content->size();
+
+		EvictLocked();
+	}
+
+	// Drops every key starting with `prefix`, e.g. all files of a resource being replaced.
+	void ErasePrefixed(std::string_view prefix)
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+
+		for (auto it = lru_.begin(); it != lru_.end();)
+		{
+			if (std::string_view(it->key).substr(0, prefix.size()) != prefix)
+			{
+				++it;
+				continue;
+			}
+
+			bytes_ -= it->content->size();
+			index_.erase(it->key);
+			it = lru_.erase(it);
+		}
+	}
+
+	void Clear()
+	{
+		std::unique_lock<std::shared_mutex> lock(mutex_);
+
+		lru_.clear();
+		index_.clear();
+		bytes_ = 0;
+	}
+
+	FileCacheStats GetStats() const
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex_);
+
+		FileCacheStats stats;
+		stats.hits = hits_.load(std::memory_order_relaxed);
+		stats.misses = misses_.load(std::memory_order_relaxed);
+		stats.evictions = evictions_;
+		stats.entries = index_.size();
+		stats.bytes = bytes_;
+		stats.budget = budget_;
+		return stats;
+	}
+
+private:
+	struct Entry
+	{
+		Entry(std::string entry_key, Content entry_content) : key(std::move(entry_key)), content(std::move(entry_content)) {}
+
+		std::string key;
+		Content content;
+		mutable std::atomic<bool> referenced{ true };
+	};
+
+	void EvictLocked()
+	{
+		while (bytes_ > budget_ && !lru_.empty())
+		{
+			Entry& victim = lru_.back();
+			if (victim.referenced.exchange(false, std::memory_order_relaxed))
+			{
+				lru_.splice(lru_.begin(), lru_, std::prev(lru_.end()));
+				continue;
+			}
+
+			bytes_ -= victim.content->size();
+			index_.erase(victim.key);
+			lru_.pop_back();
+			++evictions_;
+		}
+	}
+
+	mutable std::shared_mutex mutex_;
+
+	std::list<Entry> lru_; // most recently inserted or given a second chance first
+	std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+	size_t bytes_ = 0;
+	size_t budget_ = 0;
+
+	mutable std::atomic<uint64_t> hits_{ 0 };
+	mutable std::atomic<uint64_t> misses_{ 0 };
+	uint64_t evictions_ = 0;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. The view stays valid for the lifetime of
+// the object even if the file is replaced on disk, so writers must rename a new file
+// over it rather than truncating it in place.
+class MappedFile
+{
+public:
+    static std::shared_ptr<const MappedFile> Open(const std::string& path)
+    {
+        std::shared_ptr<MappedFile> file(new MappedFile());
+
+#ifdef _WIN32
+        HANDLE handle = CreateFileW(std::filesystem::path(path).wstring().c_str(), GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+        LARGE_INTEGER size{};
+        if (!GetFileSizeEx(handle, &size)) {
+            CloseHandle(handle);
+            return nullptr;
+        }
+
+        file->size_ = static_cast<size_t>(size.QuadPart);
+
+        if (file->size_ > 0) {
+            file->mapping_ = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (file->mapping_)
+                file->data_ = static_cast<const uint8_t*>(MapViewOfFile(file->mapping_, FILE_MAP_READ, 0, 0, 0));
+        }
+
+        // The mapping keeps the file referenced.
+        CloseHandle(handle);
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return nullptr;
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        file->size_ = static_cast<size_t>(st.st_size);
+
+        if (file->size_ > 0) {
+            void* view = ::mmap(nullptr, file->size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (view != MAP_FAILED)
+                file->data_ = static_cast<const uint8_t*>(view);
+        }
+
+        ::close(fd);
+#endif
+
+        if (file->size_ > 0 && !file->data_)
+            return nullptr;
+
+        return file;
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data_)
+            UnmapViewOfFile(data_);
+
+        if (mapping_)
+            CloseHandle(mapping_);
+#else
+        if (data_)
+            ::munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* Data() const { return data_; }
+    size_t Size() const { return size_; }
+
+    // Hint that the whole file will be read front to back (file transfers).
+    void AdviseSequential() const
+    {
+#ifndef _WIN32
+        if (data_)
+            ::madvise(const_cast<uint8_t*>(data_), size_, MADV_SEQUENTIAL);
+#endif
+    }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+
+#ifdef _WIN32
+    HANDLE mapping_ = nullptr;
+#endif
+};
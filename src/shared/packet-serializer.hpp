@@ -1,7 +1,21 @@
 ﻿#pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 #include "packet.hpp"
 
+// Define CEF_LEGACY_PACKET_SERIALIZER (CMake option of the same name) to build the
+// original iostream-based codec instead, e.g. for A/B benchmarking. Both produce the
+// same wire format.
+#ifdef CEF_LEGACY_PACKET_SERIALIZER
+
+#include <iterator>
+#include <sstream>
+
 static inline void WriteString(std::ostream& os, const std::string& str)
 {
 	uint16_t length = static_cast<uint16_t>(str.length());
@@ -84,6 +98,7 @@ inline bool SerializePacket(const NetworkPacket& packet, std::string& out)
 
 			if constexpr (std::is_same_v<T, RequestJoinPacket>) {
 				os.write(reinterpret_cast<const char*>(&arg.playerid), sizeof(arg.playerid));
+				os.write(reinterpret_cast<const char*>(&arg.protocol_version), sizeof(arg.protocol_version));
 			}
 			else if constexpr (std::is_same_v<T, HandshakeChallengePacket>) {
 				WriteBytes(os, arg.cookie);
@@ -97,6 +112,7 @@ inline bool SerializePacket(const NetworkPacket& packet, std::string& out)
 				os.put(arg.accepted ? 1 : 0);
 				os.write(reinterpret_cast<const char*>(&arg.kcp_conv_id), sizeof(arg.kcp_conv_id));
 				WriteString(os, arg.manifest_json);
+				os.write(reinterpret_cast<const char*>(&arg.protocol_version), sizeof(arg.protocol_version));
 			}
 			else if constexpr (std::is_same_v<T, ServerConfigPacket>) {
 				WriteBytes(os, arg.master_resource_key);
@@ -125,13 +141,20 @@ inline bool SerializePacket(const NetworkPacket& packet, std::string& out)
 						return;
 				}
 			}
-			else if constexpr (std::is_same_v<T, FileDataPacket>) {
+			else if constexpr (std::is_same_v<T, FileTransferBeginPacket>) {
+				os.write(reinterpret_cast<const char*>(&arg.id), sizeof(arg.id));
 				WriteString(os, arg.resourceName);
 				WriteString(os, arg.relativePath);
 				WriteString(os, arg.fileHash);
-				os.write(reinterpret_cast<const char*>(&arg.chunkIndex), sizeof(arg.chunkIndex));
-				os.write(reinterpret_cast<const char*>(&arg.totalChunks), sizeof(arg.totalChunks));
-				WriteBytes(os, arg.data);
+				os.write(reinterpret_cast<const char*>(&arg.size), sizeof(arg.size));
+			}
+			else if constexpr (std::is_same_v<T, FileChunkPacket>) {
+				os.write(reinterpret_cast<const char*>(&arg.id), sizeof(arg.id));
+				os.write(reinterpret_cast<const char*>(&arg.offset), sizeof(arg.offset));
+				os.write(reinterpret_cast<const char*>(arg.data.data()), arg.data.size());
+			}
+			else if constexpr (std::is_same_v<T, FileTransferEndPacket>) {
+				os.write(reinterpret_cast<const char*>(&arg.id), sizeof(arg.id));
 			}
 			/*else if constexpr (std::is_same_v<T, DownloadStartedPacket>) {
 				uint16_t count = static_cast<uint16_t>(arg.files_to_download.size());
@@ -147,7 +170,10 @@ inline bool SerializePacket(const NetworkPacket& packet, std::string& out)
 			}*/
 			else if constexpr (std::is_same_v<T, EmitEventPacket> || std::is_same_v<T, ClientEmitEventPacket>) {
 				os.write(reinterpret_cast<const char*>(&arg.browserId), sizeof(arg.browserId));
-				WriteString(os, arg.name);
+				os.write(reinterpret_cast<const char*>(&arg.eventId), sizeof(arg.eventId));
+
+				if (arg.eventId == 0)
+					WriteString(os, arg.name);
 
 				uint8_t count = static_cast<uint8_t>(arg.args.size());
 				os.put(count);
@@ -171,6 +197,18 @@ inline bool SerializePacket(const NetworkPacket& packet, std::string& out)
 					}
 				}
 			}
+			else if constexpr (std::is_same_v<T, EventTablePacket>) {
+				uint16_t count = static_cast<uint16_t>(arg.entries.size());
+				os.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+				for (const auto& [id, name] : arg.entries) {
+					os.write(reinterpret_cast<const char*>(&id), sizeof(id));
+					WriteString(os, name);
+				}
+			}
+			else if constexpr (std::is_same_v<T, ManifestUpdatePacket>) {
+				WriteString(os, arg.manifest_json);
+			}
 		}, packet.payload);
 
 		if (!os.good()) {
@@ -210,6 +248,13 @@ inline bool DeserializePacket(const char* data, size_t size, NetworkPacket& out)
 			if (!is.good())
 				return false;
 
+			// Missing from clients older than the field, they are refused by version.
+			is.read(reinterpret_cast<char*>(&packet.protocol_version), sizeof(packet.protocol_version));
+			if (is.gcount() != sizeof(packet.protocol_version)) {
+				packet.protocol_version = 0;
+				is.clear();
+			}
+
 			out.payload = packet;
 			break;
 		}
@@ -255,6 +300,12 @@ inline bool DeserializePacket(const char* data, size_t size, NetworkPacket& out)
 			if (!ReadString(is, packet.manifest_json))
 				return false;
 
+			is.read(reinterpret_cast<char*>(&packet.protocol_version), sizeof(packet.protocol_version));
+			if (is.gcount() != sizeof(packet.protocol_version)) {
+				packet.protocol_version = 0;
+				is.clear();
+			}
+
 			out.payload = packet;
 			break;
 		}
@@ -288,8 +339,12 @@ inline bool DeserializePacket(const char* data, size_t size, NetworkPacket& out)
 			out.payload = packet;
 			break;
 		}
-		case PacketType::FileData: {
-			FileDataPacket packet{};
+		case PacketType::FileTransferBegin: {
+			FileTransferBeginPacket packet{};
+
+			is.read(reinterpret_cast<char*>(&packet.id), sizeof(packet.id));
+			if (is.gcount() != sizeof(packet.id))
+				return false;
 
 			if (!ReadString(is, packet.resourceName))
 				return false;
@@ -300,15 +355,34 @@ inline bool DeserializePacket(const char* data, size_t size, NetworkPacket& out)
 			if (!ReadString(is, packet.fileHash))
 				return false;
 
-			is.read(reinterpret_cast<char*>(&packet.chunkIndex), sizeof(packet.chunkIndex));
-			if (is.gcount() != sizeof(packet.chunkIndex))
+			is.read(reinterpret_cast<char*>(&packet.size), sizeof(packet.size));
+			if (is.gcount() != sizeof(packet.size))
 				return false;
 
-			is.read(reinterpret_cast<char*>(&packet.totalChunks), sizeof(packet.totalChunks));
-			if (is.gcount() != sizeof(packet.totalChunks))
+			out.payload = packet;
+			break;
+		}
+		case PacketType::FileChunk: {
+			FileChunkPacket packet{};
+
+			is.read(reinterpret_cast<char*>(&packet.id), sizeof(packet.id));
+			if (is.gcount() != sizeof(packet.id))
+				return false;
+
+			is.read(reinterpret_cast<char*>(&packet.offset), sizeof(packet.offset));
+			if (is.gcount() != sizeof(packet.offset))
 				return false;
 
-			if (!ReadBytes(is, packet.data))
+			packet.data.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+
+			out.payload = packet;
+			break;
+		}
+		case PacketType::FileTransferEnd: {
+			FileTransferEndPacket packet{};
+
+			is.read(reinterpret_cast<char*>(&packet.id), sizeof(packet.id));
+			if (is.gcount() != sizeof(packet.id))
 				return false;
 
 			out.payload = packet;
@@ -356,7 +430,11 @@ inline bool DeserializePacket(const char* data, size_t size, NetworkPacket& out)
             EmitEventPacket packet{};
 
             is.read(reinterpret_cast<char*>(&packet.browserId), sizeof(packet.browserId));
-            if (!ReadString(is, packet.name))
+            is.read(reinterpret_cast<char*>(&packet.eventId), sizeof(packet.eventId));
+            if (!is.good())
+                return false;
+
+            if (packet.eventId == 0 && !ReadString(is, packet.name))
                 return false;
 
             uint8_t count{};
@@ -399,6 +477,7 @@ inline bool DeserializePacket(const char* data, size_t size, NetworkPacket& out)
                 ClientEmitEventPacket client_packet;
 
                 client_packet.browserId = packet.browserId;
+                client_packet.eventId = packet.eventId;
                 client_packet.name = packet.name;
                 client_packet.args = packet.args;
 
@@ -410,7 +489,640 @@ inline bool DeserializePacket(const char* data, size_t size, NetworkPacket& out)
 
             break;
         }
+		case PacketType::EventTable: {
+			EventTablePacket packet{};
+
+			uint16_t count{};
+			is.read(reinterpret_cast<char*>(&count), sizeof(count));
+			if (is.gcount() != sizeof(count))
+				return false;
+
+			for (uint16_t i = 0; i < count; ++i) {
+				uint16_t id{};
+				std::string name;
+
+				is.read(reinterpret_cast<char*>(&id), sizeof(id));
+				if (is.gcount() != sizeof(id) || !ReadString(is, name))
+					return false;
+
+				packet.entries.emplace_back(id, name);
+			}
+
+			out.payload = packet;
+			break;
+		}
+		case PacketType::ManifestUpdate: {
+			ManifestUpdatePacket packet{};
+
+			if (!ReadString(is, packet.manifest_json))
+				return false;
+
+			out.payload = packet;
+			break;
+		}
+		default:
+			break;
 	}
 
 	return is.good();
-}
\ No newline at end of file
+}
+
+inline bool SerializePacket(const NetworkPacket& packet, std::vector<uint8_t>& out)
+{
+	std::string raw;
+	if (!SerializePacket(packet, raw))
+		return false;
+
+	out.assign(raw.begin(), raw.end());
+	return true;
+}
+
+#else
+
+constexpr size_t MAX_PACKET_STRING_LENGTH = 4096;
+
+// Appends to a caller-owned buffer. The buffer is cleared but keeps its capacity,
+// so a buffer reused across packets stops allocating once it fits the largest one.
+class ByteWriter
+{
+public:
+	explicit ByteWriter(std::vector<uint8_t>& buffer) : buffer_(buffer)
+	{
+		buffer_.clear();
+	}
+
+	template <typename T>
+	void Write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "ByteWriter::Write requires a trivially copyable type");
+		WriteRaw(&value, sizeof(T));
+	}
+
+	void WriteRaw(const void* data, size_t size)
+	{
+		if (size == 0)
+			return;
+
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		buffer_.insert(buffer_.end(), bytes, bytes + size);
+	}
+
+	void WriteString(const std::string& str)
+	{
+		uint16_t length = static_cast<uint16_t>(std::min(str.length(), static_cast<size_t>(UINT16_MAX)));
+
+		if (length > MAX_PACKET_STRING_LENGTH) {
+			LOG_ERROR("String too long: {} bytes, truncating to 4096", length);
+			length = MAX_PACKET_STRING_LENGTH;
+		}
+
+		Write(length);
+		WriteRaw(str.data(), length);
+	}
+
+	void WriteBytes(const std::vector<uint8_t>& bytes)
+	{
+		const uint32_t length = static_cast<uint32_t>(bytes.size());
+
+		Write(length);
+		WriteRaw(bytes.data(), length);
+	}
+
+	size_t Size() const
+	{
+		return buffer_.size();
+	}
+
+private:
+	std::vector<uint8_t>& buffer_;
+};
+
+// Bounds-checked cursor over a received datagram. Reads never copy more than the
+// requested field and fail (without touching the output) once the data runs out.
+class ByteReader
+{
+public:
+	ByteReader(const char* data, size_t size)
+		: cursor_(reinterpret_cast<const uint8_t*>(data)), end_(cursor_ + size)
+	{
+	}
+
+	template <typename T>
+	bool Read(T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "ByteReader::Read requires a trivially copyable type");
+		return ReadRaw(&value, sizeof(T));
+	}
+
+	bool ReadRaw(void* out, size_t size)
+	{
+		if (Remaining() < size) {
+			cursor_ = end_;
+			ok_ = false;
+			return false;
+		}
+
+		if (size > 0) {
+			std::memcpy(out, cursor_, size);
+			cursor_ += size;
+		}
+
+		return true;
+	}
+
+	bool ReadString(std::string& str)
+	{
+		uint16_t length = 0;
+		if (!Read(length) || Remaining() < length) {
+			ok_ = false;
+			return false;
+		}
+
+		str.assign(reinterpret_cast<const char*>(cursor_), length);
+		cursor_ += length;
+		return true;
+	}
+
+	bool ReadBytes(std::vector<uint8_t>& bytes)
+	{
+		uint32_t length = 0;
+		if (!Read(length) || Remaining() < length) {
+			ok_ = false;
+			return false;
+		}
+
+		bytes.assign(cursor_, cursor_ + length);
+		cursor_ += length;
+		return true;
+	}
+
+	// Everything left, for trailing fields whose length is the packet's.
+	void ReadRemaining(std::vector<uint8_t>& bytes)
+	{
+		bytes.assign(cursor_, end_);
+		cursor_ = end_;
+	}
+
+	size_t Remaining() const
+	{
+		return static_cast<size_t>(end_ - cursor_);
+	}
+
+	bool Ok() const
+	{
+		return ok_;
+	}
+
+private:
+	const uint8_t* cursor_;
+	const uint8_t* end_;
+	bool ok_ = true;
+};
+
+// The `T` held by `payload`, switching alternatives only when it holds another type.
+template <typename T>
+inline T& ReusePayload(PacketPayload& payload)
+{
+	if (auto* packet = std::get_if<T>(&payload))
+		return *packet;
+
+	return payload.emplace<T>();
+}
+
+inline void WriteEventArguments(ByteWriter& writer, const std::vector<Argument>& args)
+{
+	writer.Write(static_cast<uint8_t>(args.size()));
+
+	for (const auto& argument : args) {
+		writer.Write(static_cast<uint8_t>(argument.type));
+
+		switch (argument.type) {
+			case ArgumentType::String:
+				writer.WriteString(argument.stringValue);
+				break;
+			case ArgumentType::Integer:
+				writer.Write(argument.intValue);
+				break;
+			case ArgumentType::Float:
+				writer.Write(argument.floatValue);
+				break;
+			case ArgumentType::Bool:
+				writer.Write(static_cast<uint8_t>(argument.boolValue ? 1 : 0));
+				break;
+		}
+	}
+}
+
+inline bool ReadEventArguments(ByteReader& reader, std::vector<Argument>& args)
+{
+	uint8_t count = 0;
+	if (!reader.Read(count))
+		return false;
+
+	// The smallest argument is a type byte and a bool.
+	if (count > reader.Remaining() / 2)
+		return false;
+
+	// Existing arguments are overwritten rather than rebuilt, string ones keep their buffers.
+	args.resize(count);
+
+	for (uint8_t i = 0; i < count; ++i) {
+		uint8_t type = 0;
+		if (!reader.Read(type))
+			return false;
+
+		Argument& arg = args[i];
+		arg.type = static_cast<ArgumentType>(type);
+
+		switch (arg.type)
+		{
+			case ArgumentType::String:
+				reader.ReadString(arg.stringValue);
+				break;
+			case ArgumentType::Integer:
+				reader.Read(arg.intValue);
+				break;
+			case ArgumentType::Float:
+				reader.Read(arg.floatValue);
+				break;
+			case ArgumentType::Bool: {
+				uint8_t boolean = 0;
+				reader.Read(boolean);
+				arg.boolValue = (boolean != 0);
+				break;
+			}
+		}
+
+		if (!reader.Ok())
+			return false;
+	}
+
+	return true;
+}
+
+// Serializes into `out`, reusing its capacity. Callers on hot paths keep one buffer
+// per thread so steady-state sends do not allocate.
+inline bool SerializePacket(const NetworkPacket& packet, std::vector<uint8_t>& out)
+{
+	ByteWriter writer(out);
+	writer.Write(static_cast<uint8_t>(packet.type));
+
+	std::visit([&writer](auto&& arg) {
+		using T = std::decay_t<decltype(arg)>;
+
+		if constexpr (std::is_same_v<T, RequestJoinPacket>) {
+			writer.Write(arg.playerid);
+			writer.Write(arg.protocol_version);
+		}
+		else if constexpr (std::is_same_v<T, HandshakeChallengePacket>) {
+			writer.WriteBytes(arg.cookie);
+			writer.WriteBytes(arg.server_public_key);
+		}
+		else if constexpr (std::is_same_v<T, HandshakeFinalizePacket>) {
+			writer.WriteBytes(arg.cookie);
+			writer.WriteBytes(arg.client_public_key);
+		}
+		else if constexpr (std::is_same_v<T, JoinResponsePacket>) {
+			writer.Write(static_cast<uint8_t>(arg.accepted ? 1 : 0));
+			writer.Write(arg.kcp_conv_id);
+			writer.WriteString(arg.manifest_json);
+			writer.Write(arg.protocol_version);
+		}
+		else if constexpr (std::is_same_v<T, ServerConfigPacket>) {
+			writer.WriteBytes(arg.master_resource_key);
+		}
+		else if constexpr (std::is_same_v<T, RequestFilesPacket>) {
+			writer.Write(static_cast<uint16_t>(arg.files.size()));
+
+			for (const auto& [resourceName, relativePath] : arg.files) {
+				if (resourceName.empty() || relativePath.empty())
+					continue;
+
+				writer.WriteString(resourceName);
+				writer.WriteString(relativePath);
+			}
+		}
+		else if constexpr (std::is_same_v<T, FileTransferBeginPacket>) {
+			writer.Write(arg.id);
+			writer.WriteString(arg.resourceName);
+			writer.WriteString(arg.relativePath);
+			writer.WriteString(arg.fileHash);
+			writer.Write(arg.size);
+		}
+		else if constexpr (std::is_same_v<T, FileChunkPacket>) {
+			writer.Write(arg.id);
+			writer.Write(arg.offset);
+			writer.WriteRaw(arg.data.data(), arg.data.size());
+		}
+		else if constexpr (std::is_same_v<T, FileTransferEndPacket>) {
+			writer.Write(arg.id);
+		}
+		else if constexpr (std::is_same_v<T, EmitEventPacket> || std::is_same_v<T, ClientEmitEventPacket>) {
+			writer.Write(arg.browserId);
+			writer.Write(arg.eventId);
+
+			if (arg.eventId == 0)
+				writer.WriteString(arg.name);
+
+			WriteEventArguments(writer, arg.args);
+		}
+		else if constexpr (std::is_same_v<T, EventTablePacket>) {
+			writer.Write(static_cast<uint16_t>(arg.entries.size()));
+
+			for (const auto& [id, name] : arg.entries) {
+				writer.Write(id);
+				writer.WriteString(name);
+			}
+		}
+		else if constexpr (std::is_same_v<T, ManifestUpdatePacket>) {
+			writer.WriteString(arg.manifest_json);
+		}
+	}, packet.payload);
+
+	return true;
+}
+
+// Decodes into `out`. When `out` already holds a packet of the same type, its strings
+// and vectors are overwritten in place, so a NetworkPacket reused across calls (see
+// ReceiveContext) stops allocating once it fits the largest packet of each type.
+inline bool DeserializePacket(const char* data, size_t size, NetworkPacket& out)
+{
+	ByteReader reader(data, size);
+
+	uint8_t packet_type_val = 0;
+	if (!reader.Read(packet_type_val))
+		return false;
+
+	out.type = static_cast<PacketType>(packet_type_val);
+
+	switch (out.type)
+	{
+		case PacketType::RequestJoin: {
+			auto& packet = ReusePayload<RequestJoinPacket>(out.payload);
+
+			if (!reader.Read(packet.playerid))
+				return false;
+
+			// Missing from clients older than the field, they are refused by version.
+			packet.protocol_version = 0;
+			if (reader.Remaining() >= sizeof(packet.protocol_version))
+				reader.Read(packet.protocol_version);
+			break;
+		}
+		case PacketType::HandshakeChallenge: {
+			auto& packet = ReusePayload<HandshakeChallengePacket>(out.payload);
+
+			if (!reader.ReadBytes(packet.cookie) || !reader.ReadBytes(packet.server_public_key))
+				return false;
+			break;
+		}
+		case PacketType::HandshakeFinalize: {
+			auto& packet = ReusePayload<HandshakeFinalizePacket>(out.payload);
+
+			if (!reader.ReadBytes(packet.cookie) || !reader.ReadBytes(packet.client_public_key))
+				return false;
+			break;
+		}
+		case PacketType::JoinResponse: {
+			auto& packet = ReusePayload<JoinResponsePacket>(out.payload);
+
+			uint8_t accepted = 0;
+			if (!reader.Read(accepted) || !reader.Read(packet.kcp_conv_id))
+				return false;
+
+			packet.accepted = accepted != 0;
+
+			if (!reader.ReadString(packet.manifest_json))
+				return false;
+
+			packet.protocol_version = 0;
+			if (reader.Remaining() >= sizeof(packet.protocol_version))
+				reader.Read(packet.protocol_version);
+			break;
+		}
+		case PacketType::ServerConfig: {
+			auto& packet = ReusePayload<ServerConfigPacket>(out.payload);
+
+			if (!reader.ReadBytes(packet.master_resource_key))
+				return false;
+			break;
+		}
+		case PacketType::RequestFiles: {
+			auto& packet = ReusePayload<RequestFilesPacket>(out.payload);
+
+			uint16_t count = 0;
+			if (!reader.Read(count))
+				return false;
+
+			// Two strings per file, at least their lengths, before sizing anything by the count.
+			if (count > reader.Remaining() / (2 * sizeof(uint16_t)))
+				return false;
+
+			packet.files.resize(count);
+
+			for (auto& [resourceName, relativePath] : packet.files) {
+				if (!reader.ReadString(resourceName) || !reader.ReadString(relativePath))
+					return false;
+			}
+			break;
+		}
+		case PacketType::FileTransferBegin: {
+			auto& packet = ReusePayload<FileTransferBeginPacket>(out.payload);
+
+			if (!reader.Read(packet.id) ||
+				!reader.ReadString(packet.resourceName) ||
+				!reader.ReadString(packet.relativePath) ||
+				!reader.ReadString(packet.fileHash) ||
+				!reader.Read(packet.size))
+				return false;
+			break;
+		}
+		case PacketType::FileChunk: {
+			auto& packet = ReusePayload<FileChunkPacket>(out.payload);
+
+			if (!reader.Read(packet.id) || !reader.Read(packet.offset))
+				return false;
+
+			reader.ReadRemaining(packet.data);
+			break;
+		}
+		case PacketType::FileTransferEnd: {
+			auto& packet = ReusePayload<FileTransferEndPacket>(out.payload);
+
+			if (!reader.Read(packet.id))
+				return false;
+			break;
+		}
+		case PacketType::EmitEvent:
+		case PacketType::EmitBrowserEvent: {
+			auto& packet = ReusePayload<EmitEventPacket>(out.payload);
+
+			if (!reader.Read(packet.browserId) || !reader.Read(packet.eventId))
+				return false;
+
+			if (packet.eventId != 0)
+				packet.name.clear();
+			else if (!reader.ReadString(packet.name))
+				return false;
+
+			if (!ReadEventArguments(reader, packet.args))
+				return false;
+			break;
+		}
+		case PacketType::ClientEmitEvent: {
+			auto& packet = ReusePayload<ClientEmitEventPacket>(out.payload);
+
+			if (!reader.Read(packet.browserId) || !reader.Read(packet.eventId))
+				return false;
+
+			if (packet.eventId != 0)
+				packet.name.clear();
+			else if (!reader.ReadString(packet.name))
+				return false;
+
+			if (!ReadEventArguments(reader, packet.args))
+				return false;
+			break;
+		}
+		case PacketType::EventTable: {
+			auto& packet = ReusePayload<EventTablePacket>(out.payload);
+
+			uint16_t count = 0;
+			if (!reader.Read(count))
+				return false;
+
+			// An id and a string length per entry.
+			if (count > reader.Remaining() / (2 * sizeof(uint16_t)))
+				return false;
+
+			packet.entries.resize(count);
+
+			for (auto& [id, name] : packet.entries) {
+				if (!reader.Read(id) || !reader.ReadString(name))
+					return false;
+			}
+			break;
+		}
+		case PacketType::ManifestUpdate: {
+			auto& packet = ReusePayload<ManifestUpdatePacket>(out.payload);
+
+			if (!reader.ReadString(packet.manifest_json))
+				return false;
+			break;
+		}
+		default:
+			break;
+	}
+
+	return reader.Ok();
+}
+
+#endif
+
+// Several serialized packets sent as one encrypted KCP message:
+//   [PacketType::Batch] ([u16 length][packet])...
+// Anything that does not start with the Batch type is a single plain packet.
+constexpr size_t BATCH_HEADER_SIZE = 1;
+constexpr size_t BATCH_ENTRY_OVERHEAD = sizeof(uint16_t);
+constexpr size_t MAX_BATCHED_PACKET_SIZE = UINT16_MAX;
+
+inline bool AppendToBatch(std::vector<uint8_t>& frame, const uint8_t* packet, size_t size)
+{
+	if (size == 0 || size > MAX_BATCHED_PACKET_SIZE)
+		return false;
+
+	if (frame.empty())
+		frame.push_back(static_cast<uint8_t>(PacketType::Batch));
+
+	const uint16_t length = static_cast<uint16_t>(size);
+	const auto* length_bytes = reinterpret_cast<const uint8_t*>(&length);
+
+	frame.insert(frame.end(), length_bytes, length_bytes + sizeof(length));
+	frame.insert(frame.end(), packet, packet + size);
+	return true;
+}
+
+// Calls `fn(data, size)` for every packet in `data`, unpacking Batch frames. Returns false
+// if a frame is truncated; packets before the damaged entry have already been delivered.
+template <typename Fn>
+inline bool ForEachFramedPacket(const char* data, size_t size, Fn&& fn)
+{
+	if (size == 0)
+		return false;
+
+	if (static_cast<uint8_t>(data[0]) != static_cast<uint8_t>(PacketType::Batch)) {
+		fn(data, size);
+		return true;
+	}
+
+	size_t offset = BATCH_HEADER_SIZE;
+
+	while (offset < size) {
+		if (size - offset < BATCH_ENTRY_OVERHEAD)
+			return false;
+
+		uint16_t length = 0;
+		std::memcpy(&length, data + offset, sizeof(length));
+		offset += BATCH_ENTRY_OVERHEAD;
+
+		if (length == 0 || size - offset < length)
+			return false;
+
+		fn(data + offset, static_cast<size_t>(length));
+		offset += length;
+	}
+
+	return true;
+}
+
+// Receive scratch of one connection: the buffer KCP messages are received and opened in,
+// and packet slots decoded into again and again. Once both fit the traffic seen, receiving
+// does not allocate. What a burst grows past the limits below is given back afterwards, so
+// one large message or batch is not held for the connection's lifetime. Owned by the
+// thread that receives.
+struct ReceiveContext
+{
+	// Above the largest file chunk message (32 segments).
+	static constexpr size_t MAX_RETAINED_MESSAGE_SIZE = 64 * 1024;
+	static constexpr size_t MAX_RETAINED_PACKETS = 32;
+
+	std::vector<char> message;
+	std::vector<NetworkPacket> packets;
+	size_t count = 0; // slots decoded since Reset
+
+	// Invalidates the previous message.
+	char* MessageBuffer(size_t size)
+	{
+		if (message.capacity() > MAX_RETAINED_MESSAGE_SIZE && size <= MAX_RETAINED_MESSAGE_SIZE)
+			std::vector<char>(size).swap(message);
+		else if (message.size() < size)
+			message.resize(size);
+
+		return message.data();
+	}
+
+	// Invalidates the decoded packets.
+	void Reset()
+	{
+		count = 0;
+
+		if (packets.size() > MAX_RETAINED_PACKETS) {
+			packets.erase(packets.begin() + MAX_RETAINED_PACKETS, packets.end());
+			packets.shrink_to_fit();
+		}
+	}
+
+	// Decodes into the next slot, which is only kept on success.
+	NetworkPacket* Decode(const char* data, size_t size)
+	{
+		if (count == packets.size())
+			packets.emplace_back();
+
+		NetworkPacket& packet = packets[count];
+		if (!DeserializePacket(data, size, packet))
+			return nullptr;
+
+		++count;
+		return &packet;
+	}
+};
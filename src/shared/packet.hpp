@@ -37,18 +37,31 @@ enum class PacketType : uint8_t
 	ServerConfig,
 
 	RequestFiles,
-	FileData,
+	FileTransferBegin,
+	FileChunk,
+	FileTransferEnd,
 
 	DownloadComplete,
 
 	EmitEvent,
 	EmitBrowserEvent,
 	ClientEmitEvent,
+
+	EventTable,
+
+	Batch,
+
+	ManifestUpdate,
 };
 
+// Bumped whenever the wire format changes. Client and server must match, a join with
+// another version is refused. A peer from before the field existed reads as 0.
+constexpr uint16_t PROTOCOL_VERSION = 1;
+
 struct RequestJoinPacket
 {
 	int playerid;
+	uint16_t protocol_version = PROTOCOL_VERSION;
 };
 
 struct HandshakeChallengePacket
@@ -68,6 +81,7 @@ struct JoinResponsePacket
 	bool accepted = false;
 	uint32_t kcp_conv_id;
 	std::string manifest_json;
+	uint16_t protocol_version = PROTOCOL_VERSION; // the server's
 };
 
 struct ServerConfigPacket
@@ -80,29 +94,62 @@ struct RequestFilesPacket
 	std::vector<std::pair<std::string, std::string>> files;
 };
 
-struct FileDataPacket
+// Transfer ids are reused once a transfer ended, at most this many are open at once.
+constexpr size_t MAX_FILE_TRANSFERS = 16;
+
+// Server -> client, opens transfer `id` for one file. Its chunks only carry the id.
+struct FileTransferBeginPacket
 {
+	uint8_t id = 0;
 	std::string resourceName;
 	std::string relativePath;
 	std::string fileHash;
-	uint32_t chunkIndex;
-	uint32_t totalChunks;
+	uint32_t size = 0;
+};
+
+// `data` is the rest of the packet, it has no length of its own.
+struct FileChunkPacket
+{
+	uint8_t id = 0;
+	uint32_t offset = 0;
 	std::vector<uint8_t> data;
 };
 
+// Sent after the last chunk, the client verifies and stores the file then.
+struct FileTransferEndPacket
+{
+	uint8_t id = 0;
+};
+
+// `eventId` is a CefEvent::Id; `name` is only sent when the id is 0 (not interned).
 struct EmitEventPacket 
 {
     int browserId;
+    uint16_t eventId = 0;
     std::string name;
     std::vector<Argument> args;
 };
 
 struct ClientEmitEventPacket {
     int browserId;
+    uint16_t eventId = 0;
     std::string name;
     std::vector<Argument> args;
 };
 
+// Server -> client, ids interned since the last table sent to this session.
+struct EventTablePacket
+{
+	std::vector<std::pair<uint16_t, std::string>> entries;
+};
+
+// Server -> client, resources published after the client joined. Same layout as
+// JoinResponsePacket::manifest_json, with only the new or rebuilt resources.
+struct ManifestUpdatePacket
+{
+	std::string manifest_json;
+};
+
 using PacketPayload = std::variant<
 	RequestJoinPacket,
 	HandshakeChallengePacket,
@@ -111,10 +158,14 @@ using PacketPayload = std::variant<
 	ServerConfigPacket,
 
 	RequestFilesPacket,
-	FileDataPacket,
+	FileTransferBeginPacket,
+	FileChunkPacket,
+	FileTransferEndPacket,
 
 	EmitEventPacket,
-	ClientEmitEventPacket
+	ClientEmitEventPacket,
+	EventTablePacket,
+	ManifestUpdatePacket
 >;
 
 struct NetworkPacket
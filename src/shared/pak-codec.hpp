@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <miniz.h>
+
+// Files are compressed before they are encrypted into a pak (ciphertext does not
+// compress). The codec and original size travel in the zip entry comment, e.g.
+// "deflate:48213"; entries without a comment predate this and are stored as is.
+enum class PakCodec : uint8_t
+{
+	Store,
+	Deflate,
+};
+
+struct PakEntryCodec
+{
+	PakCodec codec = PakCodec::Store;
+	uint64_t size = 0;
+};
+
+// Deflate is kept only when it saves at least this fraction (1/8) of the file.
+constexpr size_t PAK_MIN_SAVING_DIVISOR = 8;
+
+// Upper bound for the declared size, the server packs nothing above 20 MB.
+constexpr uint64_t PAK_MAX_ENTRY_SIZE = 64ull * 1024 * 1024;
+
+// Compresses `content` in place when worth it and returns the codec that was used.
+inline PakEntryCodec CompressPakEntry(std::vector<uint8_t>& content, bool try_deflate)
+{
+	PakEntryCodec entry{ PakCodec::Store, content.size() };
+
+	if (!try_deflate || content.size() < 64)
+		return entry;
+
+	mz_ulong compressed_size = mz_compressBound(static_cast<mz_ulong>(content.size()));
+	std::vector<uint8_t> compressed(compressed_size);
+
+	if (mz_compress2(compressed.data(), &compressed_size, content.data(), static_cast<mz_ulong>(content.size()), MZ_BEST_COMPRESSION) != MZ_OK)
+		return entry;
+
+	if (compressed_size > content.size() - content.size() / PAK_MIN_SAVING_DIVISOR)
+		return entry;
+
+	compressed.resize(compressed_size);
+	content = std::move(compressed);
+	entry.codec = PakCodec::Deflate;
+
+	return entry;
+}
+
+inline bool DecompressPakEntry(std::vector<uint8_t>& content, const PakEntryCodec& entry)
+{
+	if (entry.codec == PakCodec::Store)
+		return true;
+
+	std::vector<uint8_t> inflated(static_cast<size_t>(entry.size));
+	mz_ulong inflated_size = static_cast<mz_ulong>(inflated.size());
+
+	if (mz_uncompress(inflated.data(), &inflated_size, content.data(), static_cast<mz_ulong>(content.size())) != MZ_OK ||
+		inflated_size != entry.size)
+		return false;
+
+	content = std::move(inflated);
+	return true;
+}
+
+inline std::string FormatPakEntryComment(const PakEntryCodec& entry)
+{
+	if (entry.codec == PakCodec::Store)
+		return {};
+
+	return "deflate:" + std::to_string(entry.size);
+}
+
+inline bool ParsePakEntryComment(std::string_view comment, PakEntryCodec& entry)
+{
+	entry = {};
+
+	if (comment.empty())
+		return true;
+
+	constexpr std::string_view deflate_prefix = "deflate:";
+	if (comment.substr(0, deflate_prefix.size()) != deflate_prefix)
+		return false;
+
+	const std::string size_str(comment.substr(deflate_prefix.size()));
+	char* end = nullptr;
+	const unsigned long long size = std::strtoull(size_str.c_str(), &end, 10);
+
+	if (size_str.empty() || *end != '\0' || size > PAK_MAX_ENTRY_SIZE)
+		return false;
+
+	entry.codec = PakCodec::Deflate;
+	entry.size = size;
+	return true;
+}
@@ -0,0 +1,603 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <sodium.h>
+
+#include "mapped-file.hpp"
+#include "pak-codec.hpp"
+#include "sha256.hpp"
+
+// Indexed pak, replacing the zip of IV || AES-CBC(file) entries:
+//
+//   PakHeader | PakTocEntry[entry_count] sorted by path_hash | path names | entries
+//
+// Each entry starts on a PAK_PAGE_SIZE boundary and is its (optionally deflated) content
+// sealed with XChaCha20-Poly1305 under its own nonce; the associated data binds it to its
+// path hash, size and codec. The nonce is derived from the path, codec and content hash, so
+// the same files always give the same pak, and a nonce only repeats with identical content.
+// The header and TOC are authenticated with a keyed BLAKE2b. All keys are derived from the
+// master resource key. Little-endian, mapped as is.
+//
+// Since v3, stored (not deflated) files above PAK_SEGMENT_SIZE are sealed as a run of
+// segments instead, each followed by its MAC, so a byte range of a large media file can
+// be opened without the rest of it. v2 paks have no segmented entries and are still read.
+//
+// Since v4, an entry flagged PAK_ENTRY_AES256GCM is sealed with AES-256-GCM instead, under
+// its own key and the first 12 bytes of its nonce. Both ciphers have 16-byte MACs, so the
+// layout is the same; the TOC MAC covers the flag.
+
+constexpr char PAK_MAGIC[8] = { 'C', 'E', 'F', 'P', 'A', 'K', '\x1a', '\0' };
+constexpr uint32_t PAK_VERSION = 4;
+constexpr uint32_t PAK_MIN_VERSION = 2;
+constexpr uint32_t PAK_PAGE_SIZE = 4096;
+constexpr uint32_t PAK_SEGMENT_SIZE = 64 * 1024;
+
+// PakTocEntry::flags
+constexpr uint8_t PAK_ENTRY_SEGMENTED = 0x01;
+constexpr uint8_t PAK_ENTRY_AES256GCM = 0x02; // v4
+
+// Cipher new entries are sealed with. AES-256-GCM needs AES-NI (libsodium has no software
+// fallback) on the machine that builds the pak and on every client that opens it.
+enum class PakCipher : uint8_t
+{
+	XChaCha20Poly1305,
+	Aes256Gcm,
+};
+
+inline bool IsPakCipherAvailable(PakCipher cipher)
+{
+	return cipher == PakCipher::XChaCha20Poly1305 || crypto_aead_aes256gcm_is_available() == 1;
+}
+
+constexpr size_t PAK_KEY_BYTES = crypto_aead_xchacha20poly1305_ietf_KEYBYTES;
+constexpr size_t PAK_NONCE_BYTES = crypto_aead_xchacha20poly1305_ietf_NPUBBYTES;
+constexpr size_t PAK_MAC_BYTES = crypto_aead_xchacha20poly1305_ietf_ABYTES;
+constexpr size_t PAK_HASH_BYTES = SHA256_DIGEST_BYTES;
+
+static_assert(crypto_aead_aes256gcm_KEYBYTES == PAK_KEY_BYTES && crypto_aead_aes256gcm_ABYTES == PAK_MAC_BYTES &&
+	crypto_aead_aes256gcm_NPUBBYTES <= PAK_NONCE_BYTES);
+
+struct PakHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_count;
+	uint64_t names_offset;
+	uint32_t names_size;
+	uint32_t page_size;
+	uint8_t toc_mac[32]; // over the header up to here, the TOC and the names
+};
+
+struct PakTocEntry
+{
+	uint64_t path_hash;
+	uint64_t offset;
+	uint64_t stored_size; // sealed bytes, MAC included
+	uint64_t size;        // original file size
+	uint32_t name_offset; // into the names block
+	uint16_t name_size;
+	uint8_t codec;        // PakCodec
+	uint8_t flags;        // PAK_ENTRY_*
+	uint8_t nonce[PAK_NONCE_BYTES];
+	uint8_t hash[PAK_HASH_BYTES]; // SHA-256 of the original file
+};
+
+static_assert(sizeof(PakHeader) == 64 && std::is_trivially_copyable_v<PakHeader>);
+static_assert(sizeof(PakTocEntry) == 96 && std::is_trivially_copyable_v<PakTocEntry>);
+
+constexpr uint64_t PakPathHash(std::string_view path)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	for (char c : path) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+inline bool IsSegmented(const PakTocEntry& entry)
+{
+	return (entry.flags & PAK_ENTRY_SEGMENTED) != 0;
+}
+
+inline uint64_t PakSegmentCount(uint64_t size)
+{
+	return (size + PAK_SEGMENT_SIZE - 1) / PAK_SEGMENT_SIZE;
+}
+
+inline bool IsIndexedPak(const uint8_t* data, size_t size)
+{
+	return size >= sizeof(PakHeader) && std::memcmp(data, PAK_MAGIC, sizeof(PAK_MAGIC)) == 0;
+}
+
+struct PakKeys
+{
+	std::array<uint8_t, PAK_KEY_BYTES> entry{};
+	std::array<uint8_t, PAK_KEY_BYTES> entry_gcm{};
+	std::array<uint8_t, crypto_generichash_KEYBYTES> toc{};
+	std::array<uint8_t, crypto_generichash_KEYBYTES> nonce{};
+
+	bool Derive(const std::vector<uint8_t>& master_key)
+	{
+		static constexpr char ENTRY_CONTEXT[] = "cef-pak-v2-entry";
+		static constexpr char ENTRY_GCM_CONTEXT[] = "cef-pak-v4-entry-aes256gcm";
+		static constexpr char TOC_CONTEXT[] = "cef-pak-v2-toc";
+		static constexpr char NONCE_CONTEXT[] = "cef-pak-v2-nonce";
+
+		if (master_key.size() < crypto_generichash_KEYBYTES_MIN || master_key.size() > crypto_generichash_KEYBYTES_MAX)
+			return false;
+
+		return crypto_generichash(entry.data(), entry.size(), reinterpret_cast<const unsigned char*>(ENTRY_CONTEXT), sizeof(ENTRY_CONTEXT) - 1,
+				master_key.data(), master_key.size()) == 0 &&
+			crypto_generichash(entry_gcm.data(), entry_gcm.size(), reinterpret_cast<const unsigned char*>(ENTRY_GCM_CONTEXT), sizeof(ENTRY_GCM_CONTEXT) - 1,
+				master_key.data(), master_key.size()) == 0 &&
+			crypto_generichash(toc.data(), toc.size(), reinterpret_cast<const unsigned char*>(TOC_CONTEXT), sizeof(TOC_CONTEXT) - 1,
+				master_key.data(), master_key.size()) == 0 &&
+			crypto_generichash(nonce.data(), nonce.size(), reinterpret_cast<const unsigned char*>(NONCE_CONTEXT), sizeof(NONCE_CONTEXT) - 1,
+				master_key.data(), master_key.size()) == 0;
+	}
+
+	// Encrypts `size` bytes in place with the cipher of `entry` and writes the MAC to `mac`.
+	void Seal(const PakTocEntry& entry, uint8_t* data, size_t size, uint8_t* mac,
+		const uint8_t* ad, size_t ad_size, const uint8_t* nonce) const
+	{
+		if (entry.flags & PAK_ENTRY_AES256GCM)
+			crypto_aead_aes256gcm_encrypt_detached(data, mac, nullptr, data, size, ad, ad_size, nullptr, nonce, entry_gcm.data());
+		else
+			crypto_aead_xchacha20poly1305_ietf_encrypt_detached(data, mac, nullptr, data, size, ad, ad_size, nullptr, nonce, this->entry.data());
+	}
+
+	// Opens `size` sealed bytes followed by their MAC into `out`, which may be `sealed`.
+	bool Open(const PakTocEntry& entry, const uint8_t* sealed, size_t size, uint8_t* out,
+		const uint8_t* ad, size_t ad_size, const uint8_t* nonce) const
+	{
+		if (entry.flags & PAK_ENTRY_AES256GCM)
+			return crypto_aead_aes256gcm_decrypt_detached(out, nullptr, sealed, size, sealed + size, ad, ad_size, nonce, entry_gcm.data()) == 0;
+
+		return crypto_aead_xchacha20poly1305_ietf_decrypt_detached(out, nullptr, sealed, size, sealed + size, ad, ad_size, nonce, this->entry.data()) == 0;
+	}
+
+	// Keyed BLAKE2b of path || codec || SHA-256 of the content. Call once path, codec and hash are set.
+	void DeriveEntryNonce(std::string_view path, PakTocEntry& entry) const
+	{
+		crypto_generichash_state state;
+		crypto_generichash_init(&state, this->nonce.data(), this->nonce.size(), sizeof(entry.nonce));
+		crypto_generichash_update(&state, reinterpret_cast<const unsigned char*>(path.data()), path.size());
+		crypto_generichash_update(&state, &entry.codec, 1);
+		crypto_generichash_update(&state, entry.hash, sizeof(entry.hash));
+		crypto_generichash_final(&state, entry.nonce, sizeof(entry.nonce));
+	}
+
+	void ComputeTocMac(const PakHeader& header, const PakTocEntry* toc, const char* names, uint8_t* mac) const
+	{
+		crypto_generichash_state state;
+		crypto_generichash_init(&state, this->toc.data(), this->toc.size(), sizeof(header.toc_mac));
+		crypto_generichash_update(&state, reinterpret_cast<const unsigned char*>(&header), offsetof(PakHeader, toc_mac));
+		crypto_generichash_update(&state, reinterpret_cast<const unsigned char*>(toc), sizeof(PakTocEntry) * header.entry_count);
+		crypto_generichash_update(&state, reinterpret_cast<const unsigned char*>(names), header.names_size);
+		crypto_generichash_final(&state, mac, sizeof(header.toc_mac));
+	}
+
+	static std::array<uint8_t, 17> EntryAssociatedData(const PakTocEntry& entry)
+	{
+		std::array<uint8_t, 17> ad{};
+		std::memcpy(ad.data(), &entry.path_hash, 8);
+		std::memcpy(ad.data() + 8, &entry.size, 8);
+		ad[16] = entry.codec;
+		return ad;
+	}
+
+	// A segment is bound to its index, so segments cannot be swapped or dropped.
+	static std::array<uint8_t, 25> SegmentAssociatedData(const PakTocEntry& entry, uint64_t index)
+	{
+		std::array<uint8_t, 25> ad{};
+		const auto entry_ad = EntryAssociatedData(entry);
+		std::memcpy(ad.data(), entry_ad.data(), entry_ad.size());
+		std::memcpy(ad.data() + entry_ad.size(), &index, 8);
+		return ad;
+	}
+
+	// Segment nonces count up from the entry nonce.
+	static std::array<uint8_t, PAK_NONCE_BYTES> SegmentNonce(const PakTocEntry& entry, uint64_t index)
+	{
+		std::array<uint8_t, PAK_NONCE_BYTES> nonce;
+		std::memcpy(nonce.data(), entry.nonce, nonce.size());
+
+		uint64_t counter = 0;
+		std::memcpy(&counter, nonce.data(), 8);
+		counter += index;
+		std::memcpy(nonce.data(), &counter, 8);
+
+		return nonce;
+	}
+};
+
+// Read side over a mapped pak. Open validates the whole layout and the TOC MAC once,
+// lookups are a binary search on the path hash and Read opens a single entry.
+class PakReader
+{
+public:
+	static std::shared_ptr<const PakReader> Open(std::shared_ptr<const MappedFile> file, const std::vector<uint8_t>& master_key)
+	{
+		if (!file || !IsIndexedPak(file->Data(), file->Size()))
+			return nullptr;
+
+		std::shared_ptr<PakReader> reader(new PakReader());
+		if (!reader->keys_.Derive(master_key))
+			return nullptr;
+
+		const uint8_t* data = file->Data();
+		const uint64_t size = file->Size();
+
+		PakHeader header;
+		std::memcpy(&header, data, sizeof(header));
+
+		if (header.version < PAK_MIN_VERSION || header.version > PAK_VERSION || header.page_size != PAK_PAGE_SIZE)
+			return nullptr;
+
+		const uint64_t toc_end = sizeof(PakHeader) + sizeof(PakTocEntry) * static_cast<uint64_t>(header.entry_count);
+		if (toc_end > size || header.names_offset != toc_end || header.names_offset + header.names_size > size)
+			return nullptr;
+
+		reader->toc_.resize(header.entry_count);
+		std::memcpy(reader->toc_.data(), data + sizeof(PakHeader), sizeof(PakTocEntry) * header.entry_count);
+		reader->names_ = reinterpret_cast<const char*>(data + header.names_offset);
+		reader->names_size_ = header.names_size;
+
+		uint8_t mac[sizeof(header.toc_mac)];
+		reader->keys_.ComputeTocMac(header, reader->toc_.data(), reader->names_, mac);
+		if (sodium_memcmp(mac, header.toc_mac, sizeof(mac)) != 0)
+			return nullptr;
+
+		const uint8_t known_flags = header.version >= 4 ? PAK_ENTRY_SEGMENTED | PAK_ENTRY_AES256GCM : PAK_ENTRY_SEGMENTED;
+
+		for (size_t i = 0; i < reader->toc_.size(); ++i) {
+			const PakTocEntry& entry = reader->toc_[i];
+
+			if (i > 0 && entry.path_hash < reader->toc_[i - 1].path_hash)
+				return nullptr;
+
+			if (static_cast<uint64_t>(entry.name_offset) + entry.name_size > header.names_size ||
+				entry.stored_size < PAK_MAC_BYTES || entry.offset > size || entry.stored_size > size - entry.offset ||
+				entry.codec > static_cast<uint8_t>(PakCodec::Deflate) || entry.size > PAK_MAX_ENTRY_SIZE)
+				return nullptr;
+
+			if ((entry.flags & ~known_flags) != 0)
+				return nullptr;
+
+			if ((entry.flags & PAK_ENTRY_AES256GCM) && !IsPakCipherAvailable(PakCipher::Aes256Gcm))
+				return nullptr;
+
+			if (IsSegmented(entry) && (entry.codec != static_cast<uint8_t>(PakCodec::Store) ||
+					entry.stored_size != entry.size + PakSegmentCount(entry.size) * PAK_MAC_BYTES))
+				return nullptr;
+		}
+
+		reader->file_ = std::move(file);
+		return reader;
+	}
+
+	const PakTocEntry* Find(std::string_view path) const
+	{
+		const uint64_t hash = PakPathHash(path);
+
+		auto it = std::lower_bound(toc_.begin(), toc_.end(), hash,
+			[](const PakTocEntry& entry, uint64_t value) { return entry.path_hash < value; });
+
+		for (; it != toc_.end() && it->path_hash == hash; ++it) {
+			if (Name(*it) == path)
+				return &*it;
+		}
+
+		return nullptr;
+	}
+
+	std::string_view Name(const PakTocEntry& entry) const
+	{
+		return std::string_view(names_ + entry.name_offset, entry.name_size);
+	}
+
+	// Opens the entry straight from the mapping into `out`, inflating it if needed.
+	bool Read(const PakTocEntry& entry, std::vector<uint8_t>& out) const
+	{
+		if (IsSegmented(entry))
+			return ReadRange(entry, 0, entry.size, out);
+
+		if (!ReadStored(entry, out))
+			return false;
+
+		const PakEntryCodec codec{ static_cast<PakCodec>(entry.codec), entry.size };
+		if (!DecompressPakEntry(out, codec))
+			return false;
+
+		return out.size() == entry.size;
+	}
+
+	// Opens the entry as stored, still deflated (a zlib stream) for PakCodec::Deflate.
+	bool ReadStored(const PakTocEntry& entry, std::vector<uint8_t>& out) const
+	{
+		if (IsSegmented(entry))
+			return ReadRange(entry, 0, entry.size, out);
+
+		const auto ad = PakKeys::EntryAssociatedData(entry);
+
+		out.resize(static_cast<size_t>(entry.stored_size - PAK_MAC_BYTES));
+
+		return keys_.Open(entry, file_->Data() + entry.offset, out.size(), out.data(), ad.data(), ad.size(), entry.nonce);
+	}
+
+	// Opens only the segments covering [offset, offset + length) of a segmented entry.
+	// Other entries are opened whole and the range copied out of them.
+	bool ReadRange(const PakTocEntry& entry, uint64_t offset, uint64_t length, std::vector<uint8_t>& out) const
+	{
+		if (offset > entry.size || length > entry.size - offset)
+			return false;
+
+		if (!IsSegmented(entry)) {
+			std::vector<uint8_t> whole;
+			if (!Read(entry, whole))
+				return false;
+
+			out.assign(whole.begin() + offset, whole.begin() + offset + length);
+			return true;
+		}
+
+		out.resize(static_cast<size_t>(length));
+		if (length == 0)
+			return true;
+
+		const uint64_t first = offset / PAK_SEGMENT_SIZE;
+		const uint64_t last = (offset + length - 1) / PAK_SEGMENT_SIZE;
+
+		std::vector<uint8_t> segment;
+		uint8_t* dest = out.data();
+
+		for (uint64_t i = first; i <= last; ++i) {
+			const uint64_t plain_begin = i * PAK_SEGMENT_SIZE;
+			const uint64_t plain_size = std::min<uint64_t>(PAK_SEGMENT_SIZE, entry.size - plain_begin);
+			const uint8_t* sealed = file_->Data() + entry.offset + i * (PAK_SEGMENT_SIZE + PAK_MAC_BYTES);
+			const auto ad = PakKeys::SegmentAssociatedData(entry, i);
+			const auto nonce = PakKeys::SegmentNonce(entry, i);
+
+			const uint64_t copy_begin = std::max(offset, plain_begin);
+			const uint64_t copy_end = std::min(offset + length, plain_begin + plain_size);
+
+			// Segments wholly inside the range are opened straight into `out`, only the
+			// partial ones at either end go through a scratch buffer.
+			if (copy_begin == plain_begin && copy_end == plain_begin + plain_size) {
+				if (!keys_.Open(entry, sealed, static_cast<size_t>(plain_size), dest, ad.data(), ad.size(), nonce.data()))
+					return false;
+			}
+			else {
+				segment.resize(PAK_SEGMENT_SIZE);
+				if (!keys_.Open(entry, sealed, static_cast<size_t>(plain_size), segment.data(), ad.data(), ad.size(), nonce.data()))
+					return false;
+
+				std::memcpy(dest, segment.data() + (copy_begin - plain_begin), static_cast<size_t>(copy_end - copy_begin));
+			}
+
+			dest += copy_end - copy_begin;
+		}
+
+		return true;
+	}
+
+	const std::vector<PakTocEntry>& Entries() const { return toc_; }
+	const std::shared_ptr<const MappedFile>& File() const { return file_; }
+
+private:
+	PakReader() = default;
+
+	std::shared_ptr<const MappedFile> file_;
+	PakKeys keys_;
+	std::vector<PakTocEntry> toc_;
+	const char* names_ = nullptr;
+	uint32_t names_size_ = 0;
+};
+
+// One entry ready to be written: either freshly sealed, or taken as is from a previous
+// pak built with the same key, in which case its bytes are copied from `source`.
+struct PakSealedEntry
+{
+	std::string path;
+	PakTocEntry entry{};
+	std::vector<uint8_t> sealed;
+	std::shared_ptr<const MappedFile> source;
+};
+
+// Seal and Reuse only read the keys and can run on several threads at once; Add and
+// Write must not run concurrently.
+class PakWriter
+{
+public:
+	// Invalid if the key cannot be used or `cipher` is not available on this CPU.
+	explicit PakWriter(const std::vector<uint8_t>& master_key, PakCipher cipher = PakCipher::XChaCha20Poly1305)
+		: cipher_(cipher)
+	{
+		valid_ = IsPakCipherAvailable(cipher) && keys_.Derive(master_key);
+	}
+
+	bool IsValid() const { return valid_; }
+	PakCipher Cipher() const { return cipher_; }
+
+	bool Seal(const std::string& path, std::vector<uint8_t> content, bool try_deflate, PakSealedEntry& out) const
+	{
+		if (!valid_ || path.size() > UINT16_MAX)
+			return false;
+
+		out = {};
+		out.path = path;
+
+		PakTocEntry& entry = out.entry;
+		std::memset(&entry, 0, sizeof(entry));
+		entry.path_hash = PakPathHash(path);
+		entry.size = content.size();
+		entry.name_size = static_cast<uint16_t>(path.size());
+		entry.flags = cipher_ == PakCipher::Aes256Gcm ? PAK_ENTRY_AES256GCM : 0;
+		Sha256::Hash(content.data(), content.size(), entry.hash);
+
+		const PakEntryCodec codec = CompressPakEntry(content, try_deflate);
+		entry.codec = static_cast<uint8_t>(codec.codec);
+
+		keys_.DeriveEntryNonce(path, entry);
+
+		if (codec.codec == PakCodec::Store && content.size() > PAK_SEGMENT_SIZE)
+			SealSegmented(entry, content);
+		else
+			SealWhole(entry, content);
+
+		out.sealed = std::move(content);
+
+		entry.stored_size = out.sealed.size();
+		return true;
+	}
+
+	// Keeps an entry of `previous` without opening it. The caller checks it is still
+	// current (same file hash) and sealed with this writer's cipher; `previous` must have
+	// been opened with this writer's key.
+	static PakSealedEntry Reuse(const PakReader& previous, const PakTocEntry& entry)
+	{
+		PakSealedEntry out;
+		out.path = std::string(previous.Name(entry));
+		out.entry = entry;
+		out.source = previous.File();
+		return out;
+	}
+
+	void Add(PakSealedEntry sealed)
+	{
+		stored_bytes_ += sealed.entry.stored_size;
+		entries_.push_back(std::move(sealed));
+	}
+
+	bool Add(const std::string& path, std::vector<uint8_t> content, bool try_deflate, PakCodec* used_codec = nullptr)
+	{
+		PakSealedEntry sealed;
+		if (!Seal(path, std::move(content), try_deflate, sealed))
+			return false;
+
+		if (used_codec)
+			*used_codec = static_cast<PakCodec>(sealed.entry.codec);
+
+		Add(std::move(sealed));
+		return true;
+	}
+
+	size_t Count() const { return entries_.size(); }
+	uint64_t StoredBytes() const { return stored_bytes_; }
+
+	bool Write(const std::string& file_path)
+	{
+		if (!valid_)
+			return false;
+
+		std::sort(entries_.begin(), entries_.end(), [](const PakSealedEntry& a, const PakSealedEntry& b) {
+			return a.entry.path_hash != b.entry.path_hash ? a.entry.path_hash < b.entry.path_hash : a.path < b.path;
+		});
+
+		std::vector<PakTocEntry> toc;
+		std::string names;
+		toc.reserve(entries_.size());
+
+		for (auto& sealed : entries_) {
+			PakTocEntry entry = sealed.entry;
+			entry.name_offset = static_cast<uint32_t>(names.size());
+			names += sealed.path;
+			toc.push_back(entry);
+		}
+
+		PakHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, PAK_MAGIC, sizeof(PAK_MAGIC));
+		header.version = PAK_VERSION;
+		header.entry_count = static_cast<uint32_t>(toc.size());
+		header.names_offset = sizeof(PakHeader) + sizeof(PakTocEntry) * toc.size();
+		header.names_size = static_cast<uint32_t>(names.size());
+		header.page_size = PAK_PAGE_SIZE;
+
+		uint64_t offset = AlignUp(header.names_offset + header.names_size);
+		for (auto& entry : toc) {
+			entry.offset = offset;
+			offset = AlignUp(offset + entry.stored_size);
+		}
+
+		keys_.ComputeTocMac(header, toc.data(), names.data(), header.toc_mac);
+
+		std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(toc.data()), static_cast<std::streamsize>(sizeof(PakTocEntry) * toc.size()));
+		file.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+		uint64_t position = header.names_offset + header.names_size;
+		static const char padding[PAK_PAGE_SIZE] = {};
+
+		for (size_t i = 0; i < toc.size(); ++i) {
+			const PakSealedEntry& sealed = entries_[i];
+			const uint8_t* data = sealed.source ? sealed.source->Data() + sealed.entry.offset : sealed.sealed.data();
+
+			file.write(padding, static_cast<std::streamsize>(toc[i].offset - position));
+			file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(toc[i].stored_size));
+			position = toc[i].offset + toc[i].stored_size;
+		}
+
+		return static_cast<bool>(file);
+	}
+
+private:
+	// Both seal `content` in place: it grows by the MACs and becomes the sealed entry.
+	void SealWhole(const PakTocEntry& entry, std::vector<uint8_t>& content) const
+	{
+		const auto ad = PakKeys::EntryAssociatedData(entry);
+		const size_t size = content.size();
+
+		content.resize(size + PAK_MAC_BYTES);
+		keys_.Seal(entry, content.data(), size, content.data() + size, ad.data(), ad.size(), entry.nonce);
+	}
+
+	// Segments are spread out from the back to make room for the MAC after each of them.
+	void SealSegmented(PakTocEntry& entry, std::vector<uint8_t>& content) const
+	{
+		entry.flags |= PAK_ENTRY_SEGMENTED;
+
+		const size_t size = content.size();
+		const uint64_t segments = PakSegmentCount(size);
+		content.resize(size + segments * PAK_MAC_BYTES);
+
+		for (uint64_t i = segments; i-- > 0;) {
+			const size_t begin = static_cast<size_t>(i * PAK_SEGMENT_SIZE);
+			const size_t length = std::min<size_t>(PAK_SEGMENT_SIZE, size - begin);
+			uint8_t* segment = content.data() + begin + i * PAK_MAC_BYTES;
+			const auto ad = PakKeys::SegmentAssociatedData(entry, i);
+			const auto nonce = PakKeys::SegmentNonce(entry, i);
+
+			std::memmove(segment, content.data() + begin, length);
+			keys_.Seal(entry, segment, length, segment + length, ad.data(), ad.size(), nonce.data());
+		}
+	}
+
+	static uint64_t AlignUp(uint64_t value)
+	{
+		return (value + PAK_PAGE_SIZE - 1) & ~static_cast<uint64_t>(PAK_PAGE_SIZE - 1);
+	}
+
+	PakKeys keys_;
+	PakCipher cipher_;
+	bool valid_ = false;
+	std::vector<PakSealedEntry> entries_;
+	uint64_t stored_bytes_ = 0;
+};
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CEF_SHA256_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// SHA-256 for file, pak and transfer hashes. The block function is picked once at
+// runtime: the SHA extensions (SHA-NI) when the CPU has them, portable code otherwise.
+// There is no AVX2 multi-buffer path: it only pays off when several independent messages
+// are hashed in lockstep, and packing already hashes files in parallel on the resource
+// pool. cef-shabench measures the backends.
+
+constexpr size_t SHA256_DIGEST_BYTES = 32;
+constexpr size_t SHA256_BLOCK_BYTES = 64;
+
+namespace sha256_detail
+{
+	alignas(16) inline constexpr uint32_t K[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+	};
+
+	using BlockFunction = void (*)(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+	inline uint32_t Rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+	inline uint32_t LoadBigEndian(const uint8_t* p)
+	{
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	}
+
+	inline void BlocksPortable(uint32_t state[8], const uint8_t* data, size_t blocks)
+	{
+		uint32_t w[64];
+
+		for (; blocks > 0; --blocks, data += SHA256_BLOCK_BYTES)
+		{
+			for (int i = 0; i < 16; ++i)
+				w[i] = LoadBigEndian(data + i * 4);
+
+			for (int i = 16; i < 64; ++i)
+			{
+				uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+				uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+				w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+			}
+
+			uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+			uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+			for (int i = 0; i < 64; ++i)
+			{
+				uint32_t t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+				uint32_t t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+				h = g;
+				g = f;
+				f = e;
+				e = d + t1;
+				d = c;
+				c = b;
+				b = a;
+				a = t1 + t2;
+			}
+
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+			state[4] += e;
+			state[5] += f;
+			state[6] += g;
+			state[7] += h;
+		}
+	}
+
+#ifdef CEF_SHA256_X86
+#ifdef _MSC_VER
+#define CEF_SHA256_TARGET_SHANI
+#else
+#define CEF_SHA256_TARGET_SHANI __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
+	// Four rounds per step on the ABEF/CDGH state halves. Message words m[i % 4] are
+	// extended with msg1/msg2 while they are consumed, as in Intel's reference code.
+	CEF_SHA256_TARGET_SHANI inline void BlocksShaNi(uint32_t state[8], const uint8_t* data, size_t blocks)
+	{
+		const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+		__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+		__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+		__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+		state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+		for (; blocks > 0; --blocks, data += SHA256_BLOCK_BYTES)
+		{
+			const __m128i abef = state0;
+			const __m128i cdgh = state1;
+
+			__m128i m[4];
+			for (int i = 0; i < 4; ++i)
+				m[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 16)), byte_swap);
+
+			for (int i = 0; i < 16; ++i)
+			{
+				__m128i msg = _mm_add_epi32(m[i & 3], _mm_load_si128(reinterpret_cast<const __m128i*>(&K[i * 4])));
+				state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+
+				if (i >= 3 && i <= 14)
+				{
+					__m128i& next = m[(i + 1) & 3];
+					next = _mm_add_epi32(next, _mm_alignr_epi8(m[i & 3], m[(i - 1) & 3], 4));
+					next = _mm_sha256msg2_epu32(next, m[i & 3]);
+				}
+
+				state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+
+				if (i >= 1 && i <= 12)
+					m[(i - 1) & 3] = _mm_sha256msg1_epu32(m[(i - 1) & 3], m[i & 3]);
+			}
+
+			state0 = _mm_add_epi32(state0, abef);
+			state1 = _mm_add_epi32(state1, cdgh);
+		}
+
+		tmp = _mm_shuffle_epi32(state0, 0x1B);
+		state1 = _mm_shuffle_epi32(state1, 0xB1);
+		state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+		state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+	}
+
+#undef CEF_SHA256_TARGET_SHANI
+
+	inline bool CpuHasShaNi()
+	{
+		unsigned int leaf1[4]{}, leaf7[4]{};
+
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		__cpuid(info, 1);
+		leaf1[2] = static_cast<unsigned int>(info[2]);
+		__cpuidex(info, 7, 0);
+		leaf7[1] = static_cast<unsigned int>(info[1]);
+#else
+		if (!__get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]))
+			return false;
+		if (!__get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]))
+			return false;
+#endif
+
+		const bool ssse3 = (leaf1[2] & (1u << 9)) != 0;
+		const bool sse41 = (leaf1[2] & (1u << 19)) != 0;
+		const bool sha = (leaf7[1] & (1u << 29)) != 0;
+
+		return ssse3 && sse41 && sha;
+	}
+#endif
+
+	struct Backend
+	{
+		BlockFunction blocks;
+		const char* name;
+	};
+
+	inline const Backend& SelectBackend()
+	{
+		static const Backend backend = [] {
+#ifdef CEF_SHA256_X86
+			if (CpuHasShaNi())
+				return Backend{ &BlocksShaNi, "sha-ni" };
+#endif
+			return Backend{ &BlocksPortable, "portable" };
+		}();
+
+		return backend;
+	}
+}
+
+inline std::string ToHexString(const uint8_t* data, size_t size)
+{
+	static constexpr char digits[] = "0123456789abcdef";
+
+	std::string hex(size * 2, '\0');
+	for (size_t i = 0; i < size; ++i)
+	{
+		hex[i * 2] = digits[data[i] >> 4];
+		hex[i * 2 + 1] = digits[data[i] & 0x0f];
+	}
+
+	return hex;
+}
+
+// Incremental hasher: Update with the data as it comes, then Final once.
+class Sha256
+{
+public:
+	Sha256() { Reset(); }
+
+	void Reset()
+	{
+		static constexpr uint32_t initial[8] = {
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+		};
+
+		std::memcpy(state_, initial, sizeof(state_));
+		buffered_ = 0;
+		length_ = 0;
+	}
+
+	void Update(const void* data, size_t size)
+	{
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		length_ += size;
+
+		if (buffered_ > 0)
+		{
+			const size_t take = std::min(size, SHA256_BLOCK_BYTES - buffered_);
+			std::memcpy(buffer_ + buffered_, bytes, take);
+			buffered_ += take;
+			bytes += take;
+			size -= take;
+
+			if (buffered_ < SHA256_BLOCK_BYTES)
+				return;
+
+			Blocks(buffer_, 1);
+			buffered_ = 0;
+		}
+
+		const size_t blocks = size / SHA256_BLOCK_BYTES;
+		if (blocks > 0)
+		{
+			Blocks(bytes, blocks);
+			bytes += blocks * SHA256_BLOCK_BYTES;
+			size -= blocks * SHA256_BLOCK_BYTES;
+		}
+
+		if (size > 0)
+		{
+			std::memcpy(buffer_, bytes, size);
+			buffered_ = size;
+		}
+	}
+
+	void Final(uint8_t digest[SHA256_DIGEST_BYTES])
+	{
+		const uint64_t bits = length_ * 8;
+
+		buffer_[buffered_++] = 0x80;
+		if (buffered_ > SHA256_BLOCK_BYTES - 8)
+		{
+			std::memset(buffer_ + buffered_, 0, SHA256_BLOCK_BYTES - buffered_);
+			Blocks(buffer_, 1);
+			buffered_ = 0;
+		}
+
+		std::memset(buffer_ + buffered_, 0, SHA256_BLOCK_BYTES - 8 - buffered_);
+		for (int i = 0; i < 8; ++i)
+			buffer_[SHA256_BLOCK_BYTES - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+
+		Blocks(buffer_, 1);
+
+		for (int i = 0; i < 8; ++i)
+		{
+			digest[i * 4] = static_cast<uint8_t>(state_[i] >> 24);
+			digest[i * 4 + 1] = static_cast<uint8_t>(state_[i] >> 16);
+			digest[i * 4 + 2] = static_cast<uint8_t>(state_[i] >> 8);
+			digest[i * 4 + 3] = static_cast<uint8_t>(state_[i]);
+		}
+
+		Reset();
+	}
+
+	std::string FinalHex()
+	{
+		uint8_t digest[SHA256_DIGEST_BYTES];
+		Final(digest);
+		return ToHexString(digest, sizeof(digest));
+	}
+
+	static void Hash(const void* data, size_t size, uint8_t digest[SHA256_DIGEST_BYTES])
+	{
+		Sha256 hasher;
+		hasher.Update(data, size);
+		hasher.Final(digest);
+	}
+
+	// "sha-ni" or "portable".
+	static const char* Backend() { return sha256_detail::SelectBackend().name; }
+
+private:
+	void Blocks(const uint8_t* data, size_t blocks) { sha256_detail::SelectBackend().blocks(state_, data, blocks); }
+
+	uint32_t state_[8];
+	uint8_t buffer_[SHA256_BLOCK_BYTES];
+	size_t buffered_ = 0;
+	uint64_t length_ = 0;
+};
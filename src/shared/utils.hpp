@@ -6,24 +6,34 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
-#include "picosha2.h"
+
+#include "mapped-file.hpp"
+#include "sha256.hpp"
 
 inline std::string CalculateSHA256(const std::string& filePath)
 {
+    // Mapped, the file is hashed straight from the page cache without copying.
+    if (auto mapping = MappedFile::Open(filePath)) {
+        Sha256 hasher;
+        hasher.Update(mapping->Data(), mapping->Size());
+        return hasher.FinalHex();
+    }
+
+    // Mapping can fail where reading does not (address space on 32-bit, special files).
     std::ifstream file(filePath, std::ios::binary);
     if (!file.is_open()) {
         return "";
     }
 
-    picosha2::hash256_one_by_one hasher;
-    std::vector<char> buffer(8192);
+    Sha256 hasher;
+    std::vector<char> buffer(64 * 1024);
 
     while (file.good()) {
         file.read(buffer.data(), buffer.size());
 
         std::streamsize bytes_read = file.gcount();
         if (bytes_read > 0) {
-            hasher.process(buffer.begin(), buffer.begin() + bytes_read);
+            hasher.Update(buffer.data(), static_cast<size_t>(bytes_read));
         }
     }
 
@@ -31,13 +41,19 @@ inline std::string CalculateSHA256(const std::string& filePath)
         return "";
     }
 
-    hasher.finish();
-    return picosha2::get_hash_hex_string(hasher);
+    return hasher.FinalHex();
+}
+
+inline std::string CalculateSHA256FromData(const uint8_t* data, size_t size)
+{
+    Sha256 hasher;
+    hasher.Update(data, size);
+    return hasher.FinalHex();
 }
 
 inline std::string CalculateSHA256FromData(const std::vector<uint8_t>& data)
 {
-    return picosha2::hash256_hex_string(data);
+    return CalculateSHA256FromData(data.data(), data.size());
 }
 
 inline std::string FormatBytes(uint64_t bytes)
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <miniz.h>
+
+#include "crypto.hpp"
+#include "mapped-file.hpp"
+#include "pak-codec.hpp"
+
+// Read side of the older zip pak: every entry is IV || AES-CBC(file), with the codec in
+// the entry comment (see pak-codec.hpp). Open only indexes the central directory, an
+// entry is extracted and decrypted when it is read.
+class ZipPakReader
+{
+public:
+	static std::shared_ptr<const ZipPakReader> Open(std::shared_ptr<const MappedFile> file, const std::vector<uint8_t>& master_key)
+	{
+		if (!file)
+			return nullptr;
+
+		std::shared_ptr<ZipPakReader> reader(new ZipPakReader());
+		if (!mz_zip_reader_init_mem(&reader->zip_, file->Data(), file->Size(), 0))
+			return nullptr;
+
+		reader->initialized_ = true;
+
+		const mz_uint num_files = mz_zip_reader_get_num_files(&reader->zip_);
+		for (mz_uint i = 0; i < num_files; ++i) {
+			mz_zip_archive_file_stat file_stat;
+			if (mz_zip_reader_is_file_a_directory(&reader->zip_, i) || !mz_zip_reader_file_stat(&reader->zip_, i, &file_stat))
+				continue;
+
+			Entry entry;
+			entry.index = i;
+
+			if (!ParsePakEntryComment(std::string_view(file_stat.m_comment, file_stat.m_comment_size), entry.codec))
+				continue;
+
+			reader->entries_.emplace(file_stat.m_filename, entry);
+		}
+
+		reader->file_ = std::move(file);
+		reader->key_ = master_key;
+		return reader;
+	}
+
+	~ZipPakReader()
+	{
+		if (initialized_)
+			mz_zip_reader_end(&zip_);
+	}
+
+	ZipPakReader(const ZipPakReader&) = delete;
+	ZipPakReader& operator=(const ZipPakReader&) = delete;
+
+	bool Contains(const std::string& path) const { return entries_.count(path) != 0; }
+	size_t Count() const { return entries_.size(); }
+
+	bool Read(const std::string& path, std::vector<uint8_t>& out) const
+	{
+		auto it = entries_.find(path);
+		if (it == entries_.end())
+			return false;
+
+		std::vector<uint8_t> encrypted_data;
+		{
+			// miniz keeps per-archive state while extracting.
+			std::lock_guard<std::mutex> lock(zip_mutex_);
+
+			size_t extracted_size = 0;
+			void* p = mz_zip_reader_extract_to_heap(&zip_, it->second.index, &extracted_size, 0);
+			if (!p)
+				return false;
+
+			encrypted_data.assign(static_cast<uint8_t*>(p), static_cast<uint8_t*>(p) + extracted_size);
+			mz_free(p);
+		}
+
+		if (encrypted_data.size() < AES_IV_BYTES)
+			return false;
+
+		std::array<uint8_t, AES_IV_BYTES> iv;
+		std::copy_n(encrypted_data.begin(), AES_IV_BYTES, iv.begin());
+
+		if (!DecryptFileInPlace(encrypted_data, AES_IV_BYTES, key_, iv))
+			return false;
+
+		encrypted_data.erase(encrypted_data.begin(), encrypted_data.begin() + AES_IV_BYTES);
+		out = std::move(encrypted_data);
+
+		return DecompressPakEntry(out, it->second.codec);
+	}
+
+private:
+	ZipPakReader() = default;
+
+	struct Entry
+	{
+		mz_uint index = 0;
+		PakEntryCodec codec;
+	};
+
+	std::shared_ptr<const MappedFile> file_;
+	std::vector<uint8_t> key_;
+
+	mutable mz_zip_archive zip_{};
+	mutable std::mutex zip_mutex_;
+	bool initialized_ = false;
+
+	std::map<std::string, Entry, std::less<>> entries_;
+};
@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <string>
+
+#include <shared/byte-range.hpp>
+
+#include "check.hpp"
+
+static ByteRange Parse(const std::string& header, uint64_t size, uint64_t& begin, uint64_t& length)
+{
+	begin = length = UINT64_MAX;
+	return ParseByteRange(header, size, begin, length);
+}
+
+static void TestClosedRange()
+{
+	uint64_t begin, length;
+
+	CHECK(Parse("bytes=0-99", 1000, begin, length) == ByteRange::Satisfiable);
+	CHECK(begin == 0 && length == 100);
+
+	CHECK(Parse("bytes=10-10", 1000, begin, length) == ByteRange::Satisfiable);
+	CHECK(begin == 10 && length == 1);
+
+	// The end is clamped to the file.
+	CHECK(Parse("bytes=900-5000", 1000, begin, length) == ByteRange::Satisfiable);
+	CHECK(begin == 900 && length == 100);
+}
+
+static void TestOpenEndedRange()
+{
+	uint64_t begin, length;
+
+	CHECK(Parse("bytes=0-", 1000, begin, length) == ByteRange::Satisfiable);
+	CHECK(begin == 0 && length == 1000);
+
+	CHECK(Parse("bytes=999-", 1000, begin, length) == ByteRange::Satisfiable);
+	CHECK(begin == 999 && length == 1);
+}
+
+static void TestSuffixRange()
+{
+	uint64_t begin, length;
+
+	CHECK(Parse("bytes=-100", 1000, begin, length) == ByteRange::Satisfiable);
+	CHECK(begin == 900 && length == 100);
+
+	// Longer than the file: the whole file.
+	CHECK(Parse("bytes=-5000", 1000, begin, length) == ByteRange::Satisfiable);
+	CHECK(begin == 0 && length == 1000);
+}
+
+static void TestUnsatisfiable()
+{
+	uint64_t begin, length;
+
+	CHECK(Parse("bytes=1000-", 1000, begin, length) == ByteRange::Unsatisfiable);
+	CHECK(Parse("bytes=1000-1999", 1000, begin, length) == ByteRange::Unsatisfiable);
+	CHECK(Parse("bytes=-0", 1000, begin, length) == ByteRange::Unsatisfiable);
+	CHECK(Parse("bytes=0-", 0, begin, length) == ByteRange::Unsatisfiable);
+	CHECK(Parse("bytes=-10", 0, begin, length) == ByteRange::Unsatisfiable);
+}
+
+static void TestIgnored()
+{
+	uint64_t begin, length;
+
+	CHECK(Parse("", 1000, begin, length) == ByteRange::None);
+	CHECK(Parse("items=0-10", 1000, begin, length) == ByteRange::None);
+	CHECK(Parse("bytes=0-10,20-30", 1000, begin, length) == ByteRange::None);
+	CHECK(Parse("bytes=10", 1000, begin, length) == ByteRange::None);
+	CHECK(Parse("bytes=-", 1000, begin, length) == ByteRange::None);
+	CHECK(Parse("bytes=20-10", 1000, begin, length) == ByteRange::None);
+	CHECK(Parse("bytes=a-10", 1000, begin, length) == ByteRange::None);
+	CHECK(Parse("bytes=0-1x", 1000, begin, length) == ByteRange::None);
+	CHECK(Parse("bytes= 0-10", 1000, begin, length) == ByteRange::None);
+}
+
+int main()
+{
+	TestClosedRange();
+	TestOpenEndedRange();
+	TestSuffixRange();
+	TestUnsatisfiable();
+	TestIgnored();
+
+	return CHECK_RESULT();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the unit tests: a failed CHECK is reported and counted, and the
+// test's main returns CHECK_RESULT() so ctest sees the failure.
+
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition)                                                                   \
+	do                                                                                     \
+	{                                                                                      \
+		if (!(condition))                                                                  \
+		{                                                                                  \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			++CheckFailures();                                                             \
+		}                                                                                  \
+	} while (0)
+
+#define CHECK_RESULT() (CheckFailures() == 0 ? 0 : 1)
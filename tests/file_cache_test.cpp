@@ -0,0 +1,135 @@
+#include <memory>
+#include <string>
+
+#include <shared/file-cache.hpp>
+
+#include "check.hpp"
+
+static FileCache::Content MakeBlob(size_t size, uint8_t fill = 0)
+{
+	return std::make_shared<const Blob>(size, fill);
+}
+
+static void TestBudgetOverflow()
+{
+	FileCache cache(300);
+
+	cache.Insert("a", MakeBlob(100));
+	cache.Insert("b", MakeBlob(100));
+	cache.Insert("c", MakeBlob(100));
+	CHECK(cache.GetStats().bytes == 300);
+	CHECK(cache.GetStats().evictions == 0);
+
+	// Every entry starts with a second chance, the first pass only clears the marks.
+	cache.Insert("d", MakeBlob(100));
+
+	const FileCacheStats stats = cache.GetStats();
+	CHECK(stats.bytes <= stats.budget);
+	CHECK(stats.entries == 3);
+	CHECK(stats.evictions == 1);
+	CHECK(cache.Find("d") != nullptr);
+}
+
+static void TestSecondChance()
+{
+	FileCache cache(300);
+
+	cache.Insert("a", MakeBlob(100));
+	cache.Insert("b", MakeBlob(100));
+	cache.Insert("c", MakeBlob(100));
+	cache.Insert("d", MakeBlob(100)); // clears every mark, evicts "a"
+
+	// "b" is the oldest now, a hit keeps it over the unmarked "c".
+	CHECK(cache.Find("b") != nullptr);
+	cache.Insert("e", MakeBlob(100));
+
+	CHECK(cache.Find("b") != nullptr);
+	CHECK(cache.Find("c") == nullptr);
+	CHECK(cache.Find("e") != nullptr);
+}
+
+static void TestOversizedInsert()
+{
+	FileCache cache(100);
+
+	cache.Insert("small", MakeBlob(50));
+	cache.Insert("huge", MakeBlob(101));
+
+	CHECK(cache.Find("huge") == nullptr);
+	CHECK(cache.Find("small") != nullptr);
+	CHECK(cache.GetStats().bytes == 50);
+	CHECK(cache.GetStats().evictions == 0);
+
+	// Shrinking the budget below an entry evicts it.
+	cache.SetBudget(10);
+	CHECK(cache.Find("small") == nullptr);
+	CHECK(cache.GetStats().bytes == 0);
+}
+
+static void TestErasePrefixed()
+{
+	FileCache cache(1000);
+
+	cache.Insert("ui/index.html", MakeBlob(10));
+	cache.Insert("ui/app.js", MakeBlob(20));
+	cache.Insert("uikit/index.html", MakeBlob(30));
+	cache.Insert("hud/index.html", MakeBlob(40));
+
+	cache.ErasePrefixed("ui/");
+
+	CHECK(cache.Find("ui/index.html") == nullptr);
+	CHECK(cache.Find("ui/app.js") == nullptr);
+	CHECK(cache.Find("uikit/index.html") != nullptr);
+	CHECK(cache.Find("hud/index.html") != nullptr);
+	CHECK(cache.GetStats().entries == 2);
+	CHECK(cache.GetStats().bytes == 70);
+}
+
+static void TestReinsertSameKey()
+{
+	FileCache cache(1000);
+
+	cache.Insert("file", MakeBlob(100, 1));
+	cache.Insert("file", MakeBlob(300, 2));
+
+	const FileCacheStats stats = cache.GetStats();
+	CHECK(stats.entries == 1);
+	CHECK(stats.bytes == 300);
+
+	const FileCache::Content content = cache.Find("file");
+	CHECK(content && content->size() == 300 && (*content)[0] == 2);
+
+	// Replacing with an oversized blob keeps the old content.
+	cache.Insert("file", MakeBlob(1001, 3));
+	CHECK(cache.GetStats().bytes == 300);
+	CHECK(cache.Find("file") == content);
+}
+
+static void TestHitAndMissCounters()
+{
+	FileCache cache(100);
+
+	cache.Insert("a", MakeBlob(10));
+	cache.Find("a");
+	cache.Find("a");
+	cache.Find("b");
+
+	CHECK(cache.GetStats().hits == 2);
+	CHECK(cache.GetStats().misses == 1);
+
+	cache.Clear();
+	CHECK(cache.GetStats().entries == 0);
+	CHECK(cache.GetStats().bytes == 0);
+}
+
+int main()
+{
+	TestBudgetOverflow();
+	TestSecondChance();
+	TestOversizedInsert();
+	TestErasePrefixed();
+	TestReinsertSameKey();
+	TestHitAndMissCounters();
+
+	return CHECK_RESULT();
+}
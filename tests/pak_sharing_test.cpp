@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include <sodium.h>
+#include <shared/utils.hpp>
+
+#include "common/bridge.hpp"
+#include "common/logger.hpp"
+#include "common/resource_manager.hpp"
+#include "common/session.hpp"
+
+#include "check.hpp"
+
+// N concurrent downloads of one resource, the way CefPlugin::HandleFileRequest opens them
+// and ProcessFileTransfers sends them: every transfer must share the resource's PakFile,
+// its mapping and the hash computed when it was published.
+
+namespace fs = std::filesystem;
+
+static constexpr size_t TRANSFERS = 32;
+static constexpr size_t FILES = 4;
+static constexpr size_t FILE_SIZE = 2 * 1024 * 1024;
+static constexpr size_t CHUNK_SIZE = 1200;
+
+// Warnings and errors of the resource manager, so a failed pack says why.
+class StderrBridge final : public IPlatformBridge
+{
+public:
+	void LogInfo(const std::string&) override {}
+	void LogWarn(const std::string& message) override { std::fprintf(stderr, "[WARN] %s\n", message.c_str()); }
+	void LogError(const std::string& message) override { std::fprintf(stderr, "[ERROR] %s\n", message.c_str()); }
+	void LogDebug(const std::string&) override {}
+
+	void CallPawnPublic(const std::string&, const std::vector<Argument>&) override {}
+	void CallOnBrowserCreated(int, int, bool, int, const std::string&) override {}
+
+	std::string GetPlayerAddressIp(int) override { return {}; }
+	void KickPlayer(int) override {}
+};
+
+static fs::path MakeResource(const fs::path& root)
+{
+	const fs::path source = root / "source" / "res";
+	fs::create_directories(source);
+	fs::create_directories(root / "out");
+
+	// Random content, so deflate does not shrink the pak below the files.
+	std::mt19937 rng(7);
+	std::vector<char> content(FILE_SIZE);
+
+	for (size_t i = 0; i < FILES; ++i) {
+		for (auto& byte : content)
+			byte = static_cast<char>(rng());
+
+		std::ofstream(source / ("media" + std::to_string(i) + ".ogg"), std::ios::binary).write(content.data(), content.size());
+	}
+
+	return source;
+}
+
+#ifdef __linux__
+static size_t ResidentBytes()
+{
+	size_t pages = 0, resident = 0;
+
+	if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+		if (std::fscanf(statm, "%zu %zu", &pages, &resident) != 2)
+			resident = 0;
+		std::fclose(statm);
+	}
+
+	return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+#endif
+
+static std::shared_ptr<FileTransfer> OpenTransfer(const ResourceManager& manager)
+{
+	auto pak = manager.GetPak("res");
+	if (!pak)
+		return nullptr;
+
+	auto transfer = std::make_shared<FileTransfer>();
+	transfer->resourceName = "res";
+	transfer->relativePath = "res.pak";
+	transfer->fileHash = pak->hash;
+	transfer->size = static_cast<uint32_t>(pak->Size());
+	transfer->pak = std::move(pak);
+	return transfer;
+}
+
+static void TestTransfersSharePak(const fs::path& root)
+{
+	MakeResource(root);
+
+	ResourceManager manager(2);
+	manager.SetIndexedPak(true);
+	manager.SetResourceDirectories((root / "source").string(), (root / "out").string());
+
+	CHECK(manager.AddResource("res", std::vector<uint8_t>(32, 0x42)));
+
+	const auto published = manager.GetPak("res");
+	CHECK(published != nullptr);
+	if (!published)
+		return;
+
+	CHECK(published->Size() >= FILES * FILE_SIZE);
+
+#ifdef __linux__
+	const size_t resident_before = ResidentBytes();
+#endif
+
+	// The hash published with the pak is the pak's.
+	const auto hash_start = std::chrono::steady_clock::now();
+	CHECK(published->hash == CalculateSHA256FromData(published->Data(), published->Size()));
+	const auto hash_time = std::chrono::steady_clock::now() - hash_start;
+
+	const auto open_start = std::chrono::steady_clock::now();
+
+	std::vector<std::shared_ptr<FileTransfer>> transfers;
+	for (size_t i = 0; i < TRANSFERS; ++i)
+		transfers.push_back(OpenTransfer(manager));
+
+	const auto open_time = std::chrono::steady_clock::now() - open_start;
+
+	// Opening all of them costs less than hashing the pak once, nothing is hashed again.
+	CHECK(open_time < hash_time);
+
+	for (const auto& transfer : transfers) {
+		CHECK(transfer != nullptr);
+		if (!transfer)
+			return;
+
+		CHECK(transfer->pak == published);
+		CHECK(transfer->pak->mapping == published->mapping);
+		CHECK(transfer->fileHash == published->hash);
+	}
+
+	// The registry, `published` and one reference per transfer.
+	CHECK(published.use_count() == static_cast<long>(TRANSFERS) + 2);
+	CHECK(published->mapping.use_count() == 1);
+
+	// Send every transfer to the end, round robin like the network tick.
+	FileChunkPacket packet;
+	bool sending = true;
+	uint64_t sent = 0;
+
+	while (sending) {
+		sending = false;
+
+		for (auto& transfer : transfers) {
+			if (transfer->offset >= transfer->size)
+				continue;
+
+			const size_t size = std::min<size_t>(CHUNK_SIZE, transfer->size - transfer->offset);
+			packet.data.assign(transfer->pak->Data() + transfer->offset, transfer->pak->Data() + transfer->offset + size);
+
+			transfer->offset += static_cast<uint32_t>(size);
+			sent += packet.data.size();
+			sending = true;
+		}
+	}
+
+	CHECK(sent == TRANSFERS * published->Size());
+
+#ifdef __linux__
+	// One mapping is paged in (hashing above touched all of it), not a copy per transfer.
+	const size_t resident_after = ResidentBytes();
+	CHECK(resident_after < resident_before + 2 * published->Size());
+#endif
+
+	// Transfers keep the pak alive, and only them.
+	transfers.clear();
+	CHECK(published.use_count() == 2);
+}
+
+int main()
+{
+	if (sodium_init() < 0)
+		return 1;
+
+	StderrBridge bridge;
+	Logger logger(CefLogLevel::Warn);
+	logger.SetBridge(&bridge);
+	logging::SetLogger(&logger);
+
+	const fs::path root = fs::temp_directory_path() / ("cef-pak-sharing-test-" + std::to_string(std::random_device{}()));
+
+	TestTransfersSharePak(root);
+
+	std::error_code ec;
+	fs::remove_all(root, ec);
+
+	logging::SetLogger(nullptr);
+	return CHECK_RESULT();
+}
@@ -0,0 +1,188 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+// The serializer logs through the including module's logger.
+#define LOG_ERROR(...) ((void)0)
+
+#include <shared/packet-serializer.hpp>
+
+#include "check.hpp"
+
+// Every global allocation is counted, the steady-state receive path must not make any.
+static size_t g_allocations = 0;
+
+void* operator new(size_t size)
+{
+	++g_allocations;
+
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+static std::vector<uint8_t> Serialize(PacketType type, PacketPayload payload)
+{
+	std::vector<uint8_t> out;
+	SerializePacket(NetworkPacket{ type, std::move(payload) }, out);
+	return out;
+}
+
+// A Batch message like the server sends: an event, a file chunk and a transfer end.
+static std::vector<uint8_t> MakeBatch()
+{
+	EmitEventPacket event{};
+	event.browserId = 3;
+	event.name = "inventory:update-slot-contents";
+	event.args = { Argument(std::string("a string argument past the small buffer")), Argument(42), Argument(true) };
+
+	FileChunkPacket chunk{};
+	chunk.id = 1;
+	chunk.offset = 4096;
+	chunk.data.assign(1200, 0x5a);
+
+	FileTransferEndPacket end{};
+	end.id = 1;
+
+	std::vector<uint8_t> frame;
+
+	for (const auto& packet : { Serialize(PacketType::EmitBrowserEvent, event), Serialize(PacketType::FileChunk, chunk), Serialize(PacketType::FileTransferEnd, end) })
+		AppendToBatch(frame, packet.data(), packet.size());
+
+	return frame;
+}
+
+// One HandleKcpInput: the message is copied into the buffer (as ikcp_recv does) and decoded.
+static void Receive(ReceiveContext& receive, const std::vector<uint8_t>& frame)
+{
+	receive.Reset();
+
+	char* message = receive.MessageBuffer(frame.size());
+	std::memcpy(message, frame.data(), frame.size());
+
+	ForEachFramedPacket(message, frame.size(), [&receive](const char* data, size_t size) {
+		receive.Decode(data, size);
+	});
+}
+
+static void TestDecodesBatch()
+{
+	ReceiveContext receive;
+	Receive(receive, MakeBatch());
+
+	CHECK(receive.count == 3);
+	CHECK(receive.packets[0].type == PacketType::EmitBrowserEvent);
+	CHECK(std::get<EmitEventPacket>(receive.packets[0].payload).name == "inventory:update-slot-contents");
+	CHECK(std::get<EmitEventPacket>(receive.packets[0].payload).args.size() == 3);
+	CHECK(receive.packets[1].type == PacketType::FileChunk);
+	CHECK(std::get<FileChunkPacket>(receive.packets[1].payload).offset == 4096);
+	CHECK(std::get<FileChunkPacket>(receive.packets[1].payload).data.size() == 1200);
+	CHECK(receive.packets[2].type == PacketType::FileTransferEnd);
+}
+
+static void TestSteadyStateDoesNotAllocate()
+{
+#ifndef CEF_LEGACY_PACKET_SERIALIZER
+	const std::vector<uint8_t> frame = MakeBatch();
+	ReceiveContext receive;
+
+	// The first message sizes the buffer and the slots.
+	Receive(receive, frame);
+
+	const size_t before = g_allocations;
+
+	for (int i = 0; i < 1000; ++i)
+		Receive(receive, frame);
+
+	CHECK(g_allocations == before);
+	CHECK(receive.count == 3);
+#endif
+}
+
+static void TestGivesBackBurstCapacity()
+{
+	ReceiveContext receive;
+
+	receive.MessageBuffer(ReceiveContext::MAX_RETAINED_MESSAGE_SIZE * 4);
+	CHECK(receive.message.capacity() >= ReceiveContext::MAX_RETAINED_MESSAGE_SIZE * 4);
+
+	receive.MessageBuffer(1400);
+	CHECK(receive.message.capacity() <= ReceiveContext::MAX_RETAINED_MESSAGE_SIZE);
+	CHECK(receive.message.size() >= 1400);
+
+	// A burst of single packets, more than the retained slots.
+	const std::vector<uint8_t> end = Serialize(PacketType::FileTransferEnd, FileTransferEndPacket{});
+	receive.Reset();
+
+	for (size_t i = 0; i < ReceiveContext::MAX_RETAINED_PACKETS * 3; ++i)
+		CHECK(receive.Decode(reinterpret_cast<const char*>(end.data()), end.size()) != nullptr);
+
+	CHECK(receive.count == ReceiveContext::MAX_RETAINED_PACKETS * 3);
+
+	receive.Reset();
+	CHECK(receive.count == 0);
+	CHECK(receive.packets.size() == ReceiveContext::MAX_RETAINED_PACKETS);
+	CHECK(receive.packets.capacity() <= ReceiveContext::MAX_RETAINED_PACKETS);
+
+	// Within the limits nothing is given back.
+	receive.MessageBuffer(1400);
+	const char* buffer = receive.MessageBuffer(1200);
+	CHECK(buffer == receive.MessageBuffer(1400));
+}
+
+// Element counts from the peer are checked against the bytes left before anything is sized by them.
+static void TestRejectsCountsPastTheData()
+{
+	const auto decode = [](std::vector<uint8_t> data, NetworkPacket& out) {
+		return DeserializePacket(reinterpret_cast<const char*>(data.data()), data.size(), out);
+	};
+
+	NetworkPacket files;
+	CHECK(!decode({ static_cast<uint8_t>(PacketType::RequestFiles), 0xff, 0xff }, files));
+	CHECK(!std::holds_alternative<RequestFilesPacket>(files.payload) || std::get<RequestFilesPacket>(files.payload).files.capacity() == 0);
+
+	NetworkPacket table;
+	CHECK(!decode({ static_cast<uint8_t>(PacketType::EventTable), 0xff, 0xff, 1, 0, 0, 0 }, table));
+	CHECK(!std::holds_alternative<EventTablePacket>(table.payload) || std::get<EventTablePacket>(table.payload).entries.capacity() == 0);
+
+	EmitEventPacket event{};
+	event.eventId = 1;
+	std::vector<uint8_t> emit = Serialize(PacketType::EmitEvent, event);
+	emit.back() = 0xff; // the argument count, with no arguments after it
+
+	NetworkPacket args;
+	CHECK(!decode(emit, args));
+	CHECK(!std::holds_alternative<EmitEventPacket>(args.payload) || std::get<EmitEventPacket>(args.payload).args.capacity() == 0);
+
+	// Counts that fit still decode.
+	RequestFilesPacket request{};
+	request.files = { { "res", "index.html" }, { "res", "app.js" } };
+
+	NetworkPacket requested;
+	CHECK(decode(Serialize(PacketType::RequestFiles, request), requested));
+	CHECK(std::get<RequestFilesPacket>(requested.payload).files.size() == 2);
+}
+
+int main()
+{
+	TestDecodesBatch();
+	TestSteadyStateDoesNotAllocate();
+	TestGivesBackBurstCapacity();
+	TestRejectsCountsPastTheData();
+
+	return CHECK_RESULT();
+}
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <shared/sha256.hpp>
+
+#include "check.hpp"
+
+// FIPS 180-2 test vectors.
+struct Vector
+{
+	std::string message;
+	size_t repeat;
+	const char* digest;
+};
+
+static const Vector VECTORS[] = {
+	{ "", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+	{ "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+	{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+	{ "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+		"cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+	{ "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+};
+
+static std::string Expand(const Vector& vector)
+{
+	std::string message;
+	message.reserve(vector.message.size() * vector.repeat);
+
+	for (size_t i = 0; i < vector.repeat; ++i)
+		message += vector.message;
+
+	return message;
+}
+
+static std::string HashWith(sha256_detail::BlockFunction blocks, const std::string& message)
+{
+	uint32_t state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+	// Same padding as Sha256::Final, so the block functions can be checked on their own.
+	std::vector<uint8_t> padded(message.begin(), message.end());
+	padded.push_back(0x80);
+	while (padded.size() % SHA256_BLOCK_BYTES != SHA256_BLOCK_BYTES - 8)
+		padded.push_back(0);
+
+	const uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+	for (int i = 7; i >= 0; --i)
+		padded.push_back(static_cast<uint8_t>(bits >> (i * 8)));
+
+	blocks(state, padded.data(), padded.size() / SHA256_BLOCK_BYTES);
+
+	uint8_t digest[SHA256_DIGEST_BYTES];
+	for (int i = 0; i < 8; ++i)
+	{
+		digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+		digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+		digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+		digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+	}
+
+	return ToHexString(digest, sizeof(digest));
+}
+
+static void TestVectors()
+{
+	for (const Vector& vector : VECTORS)
+	{
+		const std::string message = Expand(vector);
+
+		uint8_t digest[SHA256_DIGEST_BYTES];
+		Sha256::Hash(message.data(), message.size(), digest);
+		CHECK(ToHexString(digest, sizeof(digest)) == vector.digest);
+
+		CHECK(HashWith(&sha256_detail::BlocksPortable, message) == vector.digest);
+		CHECK(HashWith(sha256_detail::SelectBackend().blocks, message) == vector.digest);
+	}
+}
+
+static void TestIncrementalUpdates()
+{
+	const std::string message = Expand(VECTORS[3]) + Expand(VECTORS[2]) + Expand(VECTORS[1]);
+
+	uint8_t expected[SHA256_DIGEST_BYTES];
+	Sha256::Hash(message.data(), message.size(), expected);
+	const std::string expected_hex = ToHexString(expected, sizeof(expected));
+
+	// Every split size, so updates straddle block and padding boundaries.
+	for (size_t step = 1; step <= message.size(); ++step)
+	{
+		Sha256 hasher;
+		for (size_t offset = 0; offset < message.size(); offset += step)
+			hasher.Update(message.data() + offset, std::min(step, message.size() - offset));
+
+		CHECK(hasher.FinalHex() == expected_hex);
+	}
+
+	// Final resets the hasher for the next message.
+	Sha256 hasher;
+	hasher.Update("garbage", 7);
+	hasher.FinalHex();
+	hasher.Update("abc", 3);
+	CHECK(hasher.FinalHex() == VECTORS[1].digest);
+}
+
+int main()
+{
+	std::printf("SHA-256 backend: %s\n", Sha256::Backend());
+
+	TestVectors();
+	TestIncrementalUpdates();
+
+	return CHECK_RESULT();
+}